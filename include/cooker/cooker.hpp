@@ -0,0 +1,34 @@
+#pragma once
+
+#include "assets/format.hpp"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// offline conversion of source meshes and textures into the container
+// assets::AssetFile maps at runtime
+namespace cooker {
+
+struct CookedAsset {
+  std::string name;
+  assets::AssetType type = assets::AssetType::Mesh;
+  // offsets in here are relative to the start of `blob`
+  assets::MeshInfo mesh{};
+  assets::TextureInfo texture{};
+  std::vector<uint8_t> blob;
+};
+
+// Wavefront OBJ. Polygons are fanned into triangles and identical corners
+// share a vertex, smooth normals are generated when the file has none
+CookedAsset cookMesh(const std::filesystem::path &path);
+
+// binary PPM (P6) or PGM (P5) with 8 bit channels, expanded to RGBA8
+// with a full box filtered mip chain
+CookedAsset cookTexture(const std::filesystem::path &path, bool srgb);
+
+// blobs are laid out in the order given, the table of contents goes last
+void writeContainer(const std::filesystem::path &path,
+                    const std::vector<CookedAsset> &cooked);
+
+} // namespace cooker
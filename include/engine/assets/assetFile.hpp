@@ -0,0 +1,84 @@
+#pragma once
+
+#include "assets/format.hpp"
+#include "types.hpp"
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace assets {
+
+// pointers straight into the mapped file, valid while it stays open
+struct MeshView {
+  const Vertex *vertices = nullptr;
+  uint32_t vertexCount = 0;
+  const uint32_t *indices = nullptr;
+  uint32_t indexCount = 0;
+  glm::vec4 bounds{0.0f};
+
+  VkDeviceSize vertexBytes() const { return vertexCount * sizeof(Vertex); }
+  VkDeviceSize indexBytes() const { return indexCount * sizeof(uint32_t); }
+};
+
+struct TextureView {
+  const TextureInfo *info = nullptr;
+  // every mip, in the layout copyRegions() describes
+  const uint8_t *data = nullptr;
+  VkDeviceSize size = 0;
+
+  VkFormat format() const;
+  VkExtent3D extent() const { return {info->width, info->height, 1}; }
+  uint32_t mipCount() const { return info->mipCount; }
+  // one region per mip with offsets relative to `data`, ready for
+  // rendering::Uploader::uploadImage
+  std::vector<VkBufferImageCopy> copyRegions() const;
+};
+
+// a cooked container mapped read-only into memory. Nothing is parsed or
+// copied on open besides the table of contents lookup, asset data is read
+// in place and only paged in once it is touched
+class AssetFile {
+public:
+  AssetFile() = default;
+  ~AssetFile();
+  AssetFile(const AssetFile &) = delete;
+  AssetFile &operator=(const AssetFile &) = delete;
+
+  void open(const std::string &path);
+  void close();
+  bool isOpen() const { return _data != nullptr; }
+
+  // nullptr when there is no asset called `name`
+  const TocEntry *find(std::string_view name) const;
+  const TocEntry *entries() const { return _entries; }
+  uint32_t entryCount() const { return _entryCount; }
+
+  MeshView mesh(const TocEntry &entry) const;
+  TextureView texture(const TocEntry &entry) const;
+
+  // asks the OS to start reading the entry in ahead of its first use
+  void prefetch(const TocEntry &entry) const;
+
+  const std::string &path() const { return _path; }
+
+private:
+  void validate();
+
+  std::string _path;
+  const uint8_t *_data = nullptr;
+  size_t _size = 0;
+#ifdef _WIN32
+  void *_file = nullptr;
+  void *_mapping = nullptr;
+#endif
+
+  const TocEntry *_entries = nullptr;
+  uint32_t _entryCount = 0;
+  std::unordered_map<std::string_view, const TocEntry *> _lookup;
+};
+
+} // namespace assets
@@ -0,0 +1,155 @@
+#pragma once
+
+#include "assets/assetFile.hpp"
+#include "memory/allocator.hpp"
+#include "rendering/bindlessHeap.hpp"
+#include "rendering/uploader.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+
+namespace assets {
+
+struct AssetHandle {
+  uint32_t index = UINT32_MAX;
+
+  bool valid() const { return index != UINT32_MAX; }
+};
+
+enum class Residency : uint8_t {
+  Unloaded,
+  Queued,
+  // read from disk and copied to staging on an I/O thread
+  Loading,
+  // waiting for the transfer queue
+  Uploading,
+  Resident,
+  Failed,
+};
+
+struct GpuMesh {
+  memory::Buffer vertices;
+  memory::Buffer indices;
+  uint32_t indexCount = 0;
+  glm::vec4 bounds{0.0f};
+};
+
+struct GpuTexture {
+  memory::Image image;
+  VkImageView view = VK_NULL_HANDLE;
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  VkExtent3D extent{};
+  uint32_t mipCount = 0;
+  // sampled image handle in the bindless heap, when there is one
+  uint32_t bindlessIndex = UINT32_MAX;
+};
+
+// streams assets out of mounted containers on background I/O threads.
+// Requests are served highest priority first, callers derive it from
+// whatever matters to them (inverse distance, projected size, hints).
+// Once resident an asset stays until the GPU memory it holds pushes the
+// manager over budget, then the least recently used assets that no frame
+// in flight can still reference are evicted
+class AssetManager {
+public:
+  AssetManager() = default;
+  ~AssetManager();
+  AssetManager(const AssetManager &) = delete;
+  AssetManager &operator=(const AssetManager &) = delete;
+
+  // textures are registered with `bindless` when it is given
+  void create(memory::Allocator &allocator, rendering::Uploader &uploader,
+              VkDeviceSize budget, uint32_t ioThreads,
+              uint32_t framesInFlight,
+              rendering::BindlessHeap *bindless = nullptr);
+  // joins the I/O threads, nothing new is queued on the uploader after it
+  void stop();
+  // stops, waits for the uploads already submitted and frees every
+  // resident asset, graphics work must be done with them
+  void destroy();
+
+  // every container has to be mounted before the first request, a later
+  // container's assets shadow earlier ones with the same name
+  void mount(const std::string &path);
+
+  // invalid when no mounted container has the asset. Call it every frame
+  // the asset is wanted, the latest priority wins and an evicted asset is
+  // queued again
+  AssetHandle request(std::string_view name, float priority = 0.0f);
+
+  Residency residency(AssetHandle handle) const;
+  // nullptr until resident, also marks the asset as used this frame. Safe
+  // from any thread between two update() calls
+  const GpuMesh *mesh(AssetHandle handle) const;
+  const GpuTexture *texture(AssetHandle handle) const;
+
+  // main thread, once per frame after the frame's fence wait. Publishes
+  // finished uploads and evicts down to the budget
+  void update(uint64_t frameNumber);
+
+  VkDeviceSize residentBytes() const { return _residentBytes; }
+  VkDeviceSize budget() const { return _budget; }
+
+private:
+  struct Entry {
+    const AssetFile *file = nullptr;
+    const TocEntry *toc = nullptr;
+
+    std::atomic<Residency> state{Residency::Unloaded};
+    // touched by const lookups on recording threads
+    mutable std::atomic<uint64_t> lastUsed{0};
+    // guarded by _mutex
+    float priority = 0.0f;
+    uint64_t ticket = 0;
+    VkDeviceSize bytes = 0;
+
+    GpuMesh mesh;
+    GpuTexture texture;
+  };
+
+  struct QueueItem {
+    float priority;
+    uint32_t index;
+
+    bool operator<(const QueueItem &other) const {
+      return priority < other.priority;
+    }
+  };
+
+  void ioLoop();
+  // fills in the entry's GPU resources and starts their upload
+  void load(Entry &entry);
+  // leaves the entry in `state`, Unloaded lets it be requested again
+  void release(Entry &entry, Residency state = Residency::Unloaded);
+
+  memory::Allocator *_allocator = nullptr;
+  rendering::Uploader *_uploader = nullptr;
+  rendering::BindlessHeap *_bindless = nullptr;
+  VkDeviceSize _budget = 0;
+  uint32_t _framesInFlight = 1;
+
+  std::vector<std::unique_ptr<AssetFile>> _files;
+  std::deque<Entry> _entries;
+  std::unordered_map<std::string_view, uint32_t> _lookup;
+
+  std::atomic<uint64_t> _frame{0};
+  std::atomic<VkDeviceSize> _residentBytes{0};
+
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  // stale items, whose priority changed since, are skipped when popped
+  std::priority_queue<QueueItem> _queue;
+  std::vector<uint32_t> _uploading;
+  // failed loads whose queued copies may still write into their resources
+  std::vector<uint32_t> _failing;
+  std::vector<uint32_t> _resident;
+  bool _stopping = false;
+  std::vector<std::thread> _threads;
+};
+
+} // namespace assets
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <type_traits>
+
+// on-disk layout of a cooked asset container, shared by the cooker and
+// assets::AssetFile. Everything is little endian and read in place from
+// the mapped file, so every struct here has a fixed size and layout
+//
+//   FileHeader
+//   blobs, each starting on a blobAlignment boundary
+//   TocEntry[entryCount] at tocOffset
+namespace assets {
+
+constexpr uint32_t fileMagic = 0x41454756; // "VGEA"
+constexpr uint32_t fileVersion = 1;
+
+// blob data can be handed to memcpy and GPU copies without realignment
+constexpr uint64_t blobAlignment = 64;
+constexpr uint32_t maxNameLength = 64;
+constexpr uint32_t maxMips = 16;
+
+enum class AssetType : uint32_t {
+  Mesh = 1,
+  Texture = 2,
+};
+
+enum class TextureFormat : uint32_t {
+  Rgba8Unorm = 1,
+  Rgba8Srgb = 2,
+};
+
+struct FileHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t entryCount;
+  uint32_t reserved;
+  uint64_t tocOffset;
+  // checked against the mapping, catches truncated files
+  uint64_t fileSize;
+};
+
+struct Vertex {
+  float position[3];
+  float normal[3];
+  float uv[2];
+};
+
+// offsets are relative to the start of the entry's blob
+struct MeshInfo {
+  uint32_t vertexCount;
+  uint32_t indexCount;
+  uint64_t vertexOffset;
+  uint64_t indexOffset;
+  // bounding sphere, center xyz and radius w
+  float bounds[4];
+};
+
+struct MipInfo {
+  uint64_t offset;
+  uint64_t size;
+  uint32_t width;
+  uint32_t height;
+};
+
+// mips are tightly packed rows, largest first
+struct TextureInfo {
+  TextureFormat format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t mipCount;
+  MipInfo mips[maxMips];
+};
+
+struct TocEntry {
+  // null terminated, the source file name without its extension
+  char name[maxNameLength];
+  AssetType type;
+  uint32_t reserved;
+  uint64_t offset;
+  uint64_t size;
+  union {
+    MeshInfo mesh;
+    TextureInfo texture;
+  };
+};
+
+static_assert(std::is_trivially_copyable_v<TocEntry>);
+static_assert(sizeof(FileHeader) == 32);
+static_assert(sizeof(Vertex) == 32);
+static_assert(sizeof(TocEntry) % 8 == 0);
+
+} // namespace assets
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "engine.hpp"
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+// lower is better for every metric
+struct Metric {
+  std::string name;
+  double value = 0.0;
+};
+
+struct ScenarioResult {
+  std::string name;
+  std::vector<Metric> metrics;
+
+  const Metric *find(const std::string &metric) const;
+};
+
+struct BenchResults {
+  // numbers taken on another GPU or driver don't compare
+  std::string device;
+  std::vector<ScenarioResult> scenarios;
+
+  const ScenarioResult *find(const std::string &scenario) const;
+};
+
+// a synthetic scene, run headless for a fixed number of frames
+struct Scenario {
+  std::string name;
+  engine::EngineConfig config;
+  // extra work before every frame on top of drawing the scene, may be empty
+  engine::Engine::FrameCallback frame;
+  // after the last frame, once the device is idle, may be empty
+  std::function<void(engine::Engine &engine)> teardown;
+};
+
+struct BenchOptions {
+  // every scenario starts from this, forced headless
+  engine::EngineConfig base;
+  // results are written here as JSON
+  std::string outputPath;
+  // results of an earlier run, empty skips the comparison
+  std::string baselinePath;
+  // runs just the scenario of this name when not empty
+  std::string scenario;
+  // relative slowdown a metric may show before it counts as a regression
+  double tolerance = 0.1;
+};
+
+std::vector<Scenario> defaultScenarios(const engine::EngineConfig &base);
+
+// `device` is set to the GPU the scenario ran on
+ScenarioResult runScenario(const Scenario &scenario, std::string &device);
+
+void writeResults(const std::string &path, const BenchResults &results);
+// reads what writeResults() wrote, throws on anything else
+BenchResults readResults(const std::string &path);
+
+// prints every metric next to its baseline, false when any regressed
+bool compareResults(const BenchResults &current, const BenchResults &baseline,
+                    double tolerance, std::ostream &out);
+
+// runs the scenarios and the comparison, returns the process exit code
+int runBenchmarks(const BenchOptions &options);
+
+} // namespace bench
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "ecs/entity.hpp"
+
+#include <array>
+#include <cstddef>
+#include <tuple>
+#include <vector>
+
+namespace ecs {
+
+struct Chunk {
+  std::byte *data = nullptr;
+  uint32_t count = 0;
+};
+
+// every entity with exactly the same set of components. Entities are
+// packed into fixed size chunks, each chunk stores the entity ids and then
+// one contiguous array per component (SoA), so a query touching two
+// components only streams those two arrays through the cache
+class Archetype {
+public:
+  static constexpr size_t chunkBytes = 16 * 1024;
+
+  explicit Archetype(const Signature &signature);
+  ~Archetype();
+
+  Archetype(const Archetype &) = delete;
+  Archetype &operator=(const Archetype &) = delete;
+
+  const Signature &signature() const { return _signature; }
+  const std::vector<ComponentId> &components() const { return _components; }
+  bool has(ComponentId id) const { return _signature.test(id); }
+
+  uint32_t chunkCapacity() const { return _capacity; }
+  size_t chunkCount() const { return _chunks.size(); }
+  Chunk &chunk(size_t index) { return _chunks[index]; }
+  uint32_t size() const { return _size; }
+
+  // appends an uninitialized row for `entity`, returns {chunk, row}
+  std::pair<uint32_t, uint32_t> pushBack(Entity entity);
+  // fills the hole with the last row, returns the entity that moved into
+  // it or an invalid entity when the removed row was the last one
+  Entity remove(uint32_t chunk, uint32_t row);
+
+  Entity *entities(const Chunk &chunk) const {
+    return reinterpret_cast<Entity *>(chunk.data);
+  }
+  // null when the archetype has no such component
+  void *column(ComponentId id, const Chunk &chunk) const {
+    return _offsets[id] == UINT32_MAX ? nullptr : chunk.data + _offsets[id];
+  }
+  void *component(ComponentId id, uint32_t chunk, uint32_t row) const;
+
+private:
+  Signature _signature;
+  std::vector<ComponentId> _components;
+  // byte offset of each component array inside a chunk
+  std::array<uint32_t, maxComponents> _offsets;
+  uint32_t _capacity = 0;
+  size_t _allocationSize = chunkBytes;
+
+  std::vector<Chunk> _chunks;
+  uint32_t _size = 0;
+};
+
+// one chunk of a query result
+class ChunkView {
+public:
+  ChunkView(Archetype &archetype, Chunk &chunk)
+      : _archetype(&archetype), _chunk(&chunk) {}
+
+  uint32_t size() const { return _chunk->count; }
+  const Entity *entities() const { return _archetype->entities(*_chunk); }
+
+  // the whole column, null when this chunk's archetype lacks T
+  template <typename T> T *get() const {
+    return static_cast<T *>(_archetype->column(componentId<T>(), *_chunk));
+  }
+
+  template <typename... Ts, typename F> void each(F &&f) const {
+    std::tuple<Ts *...> columns(get<Ts>()...);
+    for (uint32_t i = 0; i < _chunk->count; i++) {
+      f(std::get<Ts *>(columns)[i]...);
+    }
+  }
+
+private:
+  Archetype *_archetype;
+  Chunk *_chunk;
+};
+
+} // namespace ecs
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+namespace ecs {
+
+// index into the world's entity records, the generation tells a recycled
+// index apart from the entity that used to live there
+struct Entity {
+  uint32_t index = UINT32_MAX;
+  uint32_t generation = 0;
+
+  bool valid() const { return index != UINT32_MAX; }
+  bool operator==(const Entity &other) const {
+    return index == other.index && generation == other.generation;
+  }
+  bool operator!=(const Entity &other) const { return !(*this == other); }
+};
+
+using ComponentId = uint32_t;
+constexpr uint32_t maxComponents = 64;
+using Signature = std::bitset<maxComponents>;
+
+struct ComponentInfo {
+  size_t size = 0;
+  size_t alignment = 0;
+};
+
+namespace detail {
+ComponentId registerComponent(size_t size, size_t alignment);
+
+template <typename T> ComponentId typeId() {
+  static_assert(std::is_trivially_copyable_v<T>,
+                "components are moved between chunks with memcpy");
+  static const ComponentId id = registerComponent(sizeof(T), alignof(T));
+  return id;
+}
+} // namespace detail
+
+const ComponentInfo &componentInfo(ComponentId id);
+
+// ids are handed out on first use, in whatever order the program first
+// touches each type. Queries may ask for `const T`, it is the same id
+template <typename T> ComponentId componentId() {
+  return detail::typeId<std::remove_cv_t<T>>();
+}
+
+template <typename... Ts> Signature signatureOf() {
+  Signature signature;
+  (signature.set(componentId<Ts>()), ...);
+  return signature;
+}
+
+} // namespace ecs
@@ -0,0 +1,233 @@
+#pragma once
+
+#include "ecs/archetype.hpp"
+#include "ecs/entity.hpp"
+#include "jobs/jobSystem.hpp"
+
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ecs {
+
+class CommandBuffer;
+
+// owns every entity and its components. Structural changes (create,
+// destroy, add, remove) move rows between archetypes and invalidate
+// chunk views, so while a query runs they go through a CommandBuffer
+class World {
+public:
+  World();
+  ~World() = default;
+
+  World(const World &) = delete;
+  World &operator=(const World &) = delete;
+
+  Entity create() { return createIn(*_empty); }
+  template <typename... Ts> Entity create(const Ts &...components);
+  void destroy(Entity entity);
+  bool alive(Entity entity) const;
+
+  template <typename T> void add(Entity entity, const T &component);
+  template <typename T> void remove(Entity entity);
+  template <typename T> T *get(Entity entity);
+  template <typename T> bool has(Entity entity) const;
+
+  // living entities
+  uint32_t size() const {
+    return static_cast<uint32_t>(_records.size() - _freeList.size());
+  }
+  // bumped by every create, destroy, add and remove, lets systems cache
+  // what they derive from the entity layout
+  uint64_t structureVersion() const { return _structureVersion; }
+
+  // every non-empty chunk holding at least the components Ts and none of
+  // the components in `without`
+  template <typename... Ts>
+  std::vector<ChunkView> chunks(const Signature &without = {});
+  // same into a vector the caller keeps, so it keeps its capacity too
+  template <typename... Ts>
+  void chunks(std::vector<ChunkView> &views, const Signature &without = {});
+  // calls f(const ChunkView &) for the same chunks without collecting them
+  template <typename... Ts, typename F>
+  void eachChunk(F &&f, const Signature &without = {});
+
+  // calls f(Ts &...) for every entity with the components Ts
+  template <typename... Ts, typename F> void each(F &&f);
+  // same as each() with one job per chunk, f must be safe to call from
+  // several threads at once
+  template <typename... Ts, typename F>
+  void parallelEach(jobs::JobSystem &jobs, F &&f,
+                    const Signature &without = {});
+
+  // replays and clears the deferred changes
+  void apply(CommandBuffer &commands);
+
+private:
+  struct Record {
+    Archetype *archetype = nullptr;
+    uint32_t chunk = 0;
+    uint32_t row = 0;
+    uint32_t generation = 0;
+  };
+
+  Archetype &archetypeFor(const Signature &signature);
+  Entity createIn(Archetype &archetype);
+  // moves the entity's row into `target`, keeping the components both
+  // archetypes share
+  void move(Entity entity, Archetype &target);
+  void fixMoved(Entity moved, uint32_t chunk, uint32_t row);
+
+  std::vector<Record> _records;
+  std::vector<uint32_t> _freeList;
+
+  std::vector<std::unique_ptr<Archetype>> _archetypes;
+  std::unordered_map<Signature, Archetype *> _archetypeLookup;
+  Archetype *_empty = nullptr;
+  uint64_t _structureVersion = 0;
+};
+
+// records structural changes to replay with World::apply() once nothing
+// iterates the world anymore. Safe to record into from several jobs
+class CommandBuffer {
+public:
+  template <typename... Ts> void create(const Ts &...components) {
+    push([=](World &world) { world.create(components...); });
+  }
+  void destroy(Entity entity) {
+    push([=](World &world) { world.destroy(entity); });
+  }
+  template <typename T> void add(Entity entity, const T &component) {
+    push([=](World &world) { world.add(entity, component); });
+  }
+  template <typename T> void remove(Entity entity) {
+    push([=](World &world) { world.template remove<T>(entity); });
+  }
+
+  bool empty() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _commands.empty();
+  }
+
+private:
+  friend class World;
+
+  template <typename F> void push(F &&command) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _commands.emplace_back(std::forward<F>(command));
+  }
+
+  std::mutex _mutex;
+  std::vector<std::function<void(World &)>> _commands;
+};
+
+template <typename... Ts> Entity World::create(const Ts &...components) {
+  Entity entity = createIn(archetypeFor(signatureOf<Ts...>()));
+  const Record &record = _records[entity.index];
+  (std::memcpy(record.archetype->component(componentId<Ts>(), record.chunk,
+                                           record.row),
+               &components, sizeof(Ts)),
+   ...);
+  return entity;
+}
+
+template <typename T> void World::add(Entity entity, const T &component) {
+  if (!alive(entity)) {
+    throw std::runtime_error("failed to add component to a dead entity!");
+  }
+
+  ComponentId id = componentId<T>();
+  Record &record = _records[entity.index];
+  _structureVersion++;
+  if (!record.archetype->has(id)) {
+    Signature signature = record.archetype->signature();
+    signature.set(id);
+    move(entity, archetypeFor(signature));
+  }
+  std::memcpy(record.archetype->component(id, record.chunk, record.row),
+              &component, sizeof(T));
+}
+
+template <typename T> void World::remove(Entity entity) {
+  ComponentId id = componentId<T>();
+  if (!alive(entity) || !_records[entity.index].archetype->has(id)) {
+    return;
+  }
+
+  Signature signature = _records[entity.index].archetype->signature();
+  signature.reset(id);
+  move(entity, archetypeFor(signature));
+}
+
+template <typename T> T *World::get(Entity entity) {
+  if (!alive(entity)) {
+    return nullptr;
+  }
+  const Record &record = _records[entity.index];
+  if (!record.archetype->has(componentId<T>())) {
+    return nullptr;
+  }
+  return static_cast<T *>(record.archetype->component(
+      componentId<T>(), record.chunk, record.row));
+}
+
+template <typename T> bool World::has(Entity entity) const {
+  return alive(entity) &&
+         _records[entity.index].archetype->has(componentId<T>());
+}
+
+template <typename... Ts>
+std::vector<ChunkView> World::chunks(const Signature &without) {
+  std::vector<ChunkView> views;
+  chunks<Ts...>(views, without);
+  return views;
+}
+
+template <typename... Ts>
+void World::chunks(std::vector<ChunkView> &views, const Signature &without) {
+  views.clear();
+  eachChunk<Ts...>([&views](const ChunkView &view) { views.push_back(view); },
+                   without);
+}
+
+template <typename... Ts, typename F>
+void World::eachChunk(F &&f, const Signature &without) {
+  Signature query = signatureOf<Ts...>();
+  for (auto &archetype : _archetypes) {
+    if ((archetype->signature() & query) != query ||
+        (archetype->signature() & without).any()) {
+      continue;
+    }
+    for (size_t i = 0; i < archetype->chunkCount(); i++) {
+      f(ChunkView(*archetype, archetype->chunk(i)));
+    }
+  }
+}
+
+template <typename... Ts, typename F> void World::each(F &&f) {
+  eachChunk<Ts...>([&f](const ChunkView &view) { view.each<Ts...>(f); });
+}
+
+template <typename... Ts, typename F>
+void World::parallelEach(jobs::JobSystem &jobs, F &&f,
+                         const Signature &without) {
+  std::vector<ChunkView> views = chunks<Ts...>(without);
+
+  jobs::Counter counter;
+  jobs.parallelFor(
+      static_cast<uint32_t>(views.size()), 1,
+      [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+          views[i].each<Ts...>(f);
+        }
+      },
+      counter);
+  jobs.wait(counter);
+}
+
+} // namespace ecs
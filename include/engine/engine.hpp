@@ -1,70 +1,333 @@
 #pragma once
 
+#include "assets/assetManager.hpp"
+#include "ecs/world.hpp"
+#include "jobs/jobSystem.hpp"
+#include "memory/allocationTracker.hpp"
+#include "memory/allocator.hpp"
+#include "memory/frameArena.hpp"
+#include "memory/ringBuffer.hpp"
+#include "profiling/gpuProfiler.hpp"
+#include "profiling/startupTimer.hpp"
+#include "rendering/bindlessHeap.hpp"
+#include "rendering/frame.hpp"
+#include "rendering/framePacer.hpp"
+#include "rendering/offscreen.hpp"
+#include "rendering/parallelRecorder.hpp"
+#include "rendering/pipelineCache.hpp"
+#include "rendering/pipelineLibrary.hpp"
+#include "rendering/renderGraph.hpp"
+#include "rendering/shaderCompiler.hpp"
+#include "rendering/shaderWatcher.hpp"
 #include "rendering/swapchain.hpp"
+#include "rendering/uploader.hpp"
+#include "scene/gpuScene.hpp"
+#include "scene/simulation.hpp"
+#include "scene/transforms.hpp"
 #include "types.hpp"
 
+#include <functional>
+#include <mutex>
 #include <optional>
+#include <string>
 #include <vector>
 
+#ifndef ENGINE_SHADER_DIR
+#define ENGINE_SHADER_DIR "shaders"
+#endif
+
 namespace engine {
 
 const std::vector<const char *> deviceExtensions = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME};
 
+// enabled when the device has them, subsystems check isExtensionEnabled()
+const std::vector<const char *> optionalDeviceExtensions = {
+    VK_EXT_MEMORY_BUDGET_EXTENSION_NAME};
+
 struct QueueFamilyIndices {
   std::optional<uint32_t> graphicsFamily;
   std::optional<uint32_t> presentFamily;
+  // transfer only and compute without graphics, empty when the device has
+  // no such family and the work has to share the graphics queue
+  std::optional<uint32_t> transferFamily;
+  std::optional<uint32_t> computeFamily;
 
-  bool isComplete() {
-    return graphicsFamily.has_value() && presentFamily.has_value();
+  bool isComplete(bool needsPresent = true) const {
+    return graphicsFamily.has_value() &&
+           (presentFamily.has_value() || !needsPresent);
   }
 };
 
+// everything device selection and setup ask of a physical device, queried
+// once per device instead of once per question
+struct DeviceCapabilities {
+  VkPhysicalDevice device = VK_NULL_HANDLE;
+  VkPhysicalDeviceProperties properties{};
+  VkPhysicalDeviceMemoryProperties memory{};
+  // largest device local heap, shared system memory on integrated GPUs
+  VkDeviceSize deviceLocalBytes = 0;
+  QueueFamilyIndices queueFamilies;
+  std::vector<VkExtensionProperties> extensions;
+  // formats and present modes for the window surface, empty when headless
+  rendering::SwapchainSupportDetails swapChainSupport;
+
+  // what the device supports, not what is enabled. pNext is cleared, the
+  // 1.2 and 1.3 structs stay zero below Vulkan 1.3
+  VkPhysicalDeviceFeatures features{};
+  VkPhysicalDeviceVulkan12Features features12{};
+  VkPhysicalDeviceVulkan13Features features13{};
+  // VK_KHR_present_id and VK_KHR_present_wait, extensions and features
+  bool presentWait = false;
+
+  bool hasExtension(const char *name) const;
+  // descriptor indexing as rendering::BindlessHeap uses it
+  bool supportsBindless() const;
+  // indirect count and what the cull shader needs, see scene::GpuScene
+  bool supportsGpuDriven() const;
+};
+
+struct EngineConfig {
+  // number of frames the CPU may record ahead of the GPU
+  uint32_t framesInFlight = 2;
+
+  // render into offscreen images instead of a window and swapchain, works
+  // on software implementations such as lavapipe
+  bool headless = false;
+  uint32_t width = 800;
+  uint32_t height = 600;
+
+  // stop after this many frames, 0 runs until the window is closed
+  uint64_t maxFrames = 0;
+
+  // fixed simulation steps per second, run on their own thread and
+  // interpolated for rendering
+  float tickRate = 60.0f;
+
+  // job system workers, 0 uses one per core minus the main thread
+  uint32_t workerThreads = 0;
+  // entities in the demo scene, one triangle each
+  uint32_t drawCount = 1024;
+
+  // transient per-frame data, see memory::RingBuffer. The CPU draw path
+  // adds room for every entity's matrix on top
+  VkDeviceSize frameRingSize = 4 * 1024 * 1024;
+  // staging memory for rendering::Uploader
+  VkDeviceSize stagingSize = 32 * 1024 * 1024;
+
+  // cooked container mounted at startup, see the cooker target
+  std::string assetPath;
+  // GPU memory streamed assets may hold before the least recently used
+  // ones are evicted
+  VkDeviceSize assetBudget = 256 * 1024 * 1024;
+  uint32_t ioThreads = 2;
+
+  // one global update-after-bind descriptor set, see
+  // rendering::BindlessHeap. Ignored without descriptor indexing support
+  bool bindless = false;
+  // cull and pick lods in a compute pass and draw the survivors with one
+  // vkCmdDrawIndexedIndirectCount, see scene::GpuScene. Implies bindless,
+  // falls back to CPU culling without indirect count support
+  bool gpuDriven = false;
+
+  // present mode, swapchain images and how far the CPU may run ahead
+  rendering::PacingMode pacing = rendering::PacingMode::Steady;
+  // frames per second, 0 is unlimited except when power saving
+  float frameRateLimit = 0.0f;
+
+  // print the GPU timings and CPU frame pacing every this many frames, 0
+  // never does
+  uint32_t profileInterval = 0;
+  // records CPU scopes and writes them here as a Chrome trace on exit
+  std::string tracePath;
+
+  std::string shaderDir = ENGINE_SHADER_DIR;
+  // watch shaderDir and rebuild the pipelines whose shaders were edited
+  // while running, see rendering::ShaderWatcher
+  bool hotReload = false;
+  // picks the GPU by index or by part of its name instead of by score,
+  // main() fills it from ENGINE_GPU. A GPU that is not suitable is an
+  // error rather than a fallback
+  std::string gpu;
+
+  // compiled shaders and pipeline caches persist here between runs
+  std::string cacheDir = "cache";
+  // headless only, the last rendered frame is written here as a PPM
+  std::string capturePath;
+};
+
 class Engine {
 public:
-  Engine();
+  using FrameCallback = std::function<void(Engine &engine, uint64_t frame)>;
+
+  Engine(const EngineConfig &config = {});
   ~Engine();
   void run();
 
+  // runs on the render thread before every frame, with the number of the
+  // frame about to be drawn
+  void setFrameCallback(FrameCallback callback);
+  // the next frame renders at this size. Resizes the window, or recreates
+  // the offscreen targets when headless
+  void resize(uint32_t width, uint32_t height);
+
+  // what the selected GPU supports, for subsystems that adapt to it
+  const DeviceCapabilities &deviceCapabilities() const {
+    return _deviceCapabilities;
+  }
+  // shared by every subsystem for parallel work
+  jobs::JobSystem &jobs() { return _jobs; }
+  // streams buffer and image data in on the transfer queue
+  rendering::Uploader &uploader() { return _uploader; }
+  assets::AssetManager &assets() { return _assets; }
+  const profiling::GpuProfiler &gpuProfiler() const { return _gpuProfiler; }
+  memory::Allocator &allocator() { return _allocator; }
+  const profiling::StartupTimer &startupTimer() const { return _startup; }
+
 private:
   void loop();
+  // bounds how far the CPU runs ahead, see rendering::FramePacer
+  void paceFrame();
+  void printAllocations();
+  // one fixed step, on the simulation thread
+  void updateScene(float deltaTime);
+  void drawFrame();
+  // returns the upload timeline value the submission has to wait for
+  uint64_t recordCommandBuffer(VkCommandBuffer commandBuffer, VkImage image,
+                               VkImageView view,
+                               const rendering::ResourceState &finalState);
+  void submitFrame(rendering::FrameData &frame, VkSemaphore wait,
+                   VkPipelineStageFlags waitStage, VkSemaphore signal,
+                   uint64_t uploadValue);
+  const std::vector<VkCommandBuffer> &recordDraws();
+  void addIndirectScene(rendering::GraphImage target,
+                        const VkClearColorValue &clear);
+  bool shouldClose();
+  void captureFrame(const std::string &path);
 
+  void createWindow();
   void createInstance();
   void setupDebugMessenger();
   void createSurface();
   void pickPhysicalDevice();
   void createLogicalDevice();
+  void createUploader();
+  void createAssets();
   void createSwapChain();
+  // false while the window is minimized, the old swapchain stays retired
+  // until the frames using it are done
+  bool recreateSwapChain();
+  void destroyRetiredSwapChains(bool all);
+  void createOffscreenTargets();
+  void createCommands();
+  void createSyncObjects();
+  void createPipelines();
+  void createScene();
+  void createGpuScene();
 
-  bool isDeviceSuitable(VkPhysicalDevice device);
+  // safe to run for several devices at once
+  DeviceCapabilities queryDeviceCapabilities(VkPhysicalDevice device);
+  bool isDeviceSuitable(const DeviceCapabilities &capabilities);
+  // higher is better, only meaningful for suitable devices
+  uint64_t scoreDevice(const DeviceCapabilities &capabilities);
   QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device);
-  bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+  bool checkDeviceExtensionSupport(const DeviceCapabilities &capabilities);
+  bool checkDeviceFeatureSupport(const DeviceCapabilities &capabilities);
+  bool isExtensionEnabled(const char *extension) const;
   rendering::SwapchainSupportDetails
   querySwapChainSupport(VkPhysicalDevice device);
 
   VkSurfaceFormatKHR chooseSwapSurfaceFormat(
       const std::vector<VkSurfaceFormatKHR> &availableFormats);
-  VkPresentModeKHR chooseSwapPresentMode(
-      const std::vector<VkPresentModeKHR> &availablePresentModes);
   VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities);
 
-  GLFWwindow *_window;
+  EngineConfig _config;
+  profiling::StartupTimer _startup;
+  FrameCallback _frameCallback;
+
+  GLFWwindow *_window = nullptr;
   int _width;
   int _height;
 
   VkInstance _instance;
   VkDebugUtilsMessengerEXT _debugMessenger;
-  VkSurfaceKHR _surface;
+  VkSurfaceKHR _surface = VK_NULL_HANDLE;
 
   VkPhysicalDevice _physicalDevice = VK_NULL_HANDLE;
+  // of _physicalDevice, filled in by pickPhysicalDevice()
+  DeviceCapabilities _deviceCapabilities;
   VkDevice _device;
+  std::vector<const char *> _enabledExtensions;
+  bool _pipelineStatisticsEnabled = false;
+  bool _bindlessEnabled = false;
+  bool _gpuDrivenEnabled = false;
+  bool _presentWaitEnabled = false;
+
+  memory::Allocator _allocator;
+  memory::RingBuffer _frameRing;
+  // CPU scratch that only lives as long as the frame recording it
+  memory::FrameArena _frameArena;
+  // the counters at the last report, reports show the difference
+  memory::AllocationCounters _reportedAllocations;
+  rendering::BindlessHeap _bindless;
+  rendering::Uploader _uploader;
+  assets::AssetManager _assets;
+
+  jobs::JobSystem _jobs;
+  rendering::ShaderCompiler _shaderCompiler;
+  rendering::PipelineCache _pipelineCache;
+  rendering::PipelineLibrary _pipelines;
+  rendering::ShaderWatcher _shaderWatcher;
 
   VkQueue _graphicsQueue;
   VkQueue _presentQueue;
+  // fall back to the graphics queue when there is no dedicated family
+  VkQueue _transferQueue;
+  VkQueue _computeQueue;
+  // queues are externally synchronized, the uploader may submit to the
+  // graphics queue from a streaming thread
+  std::mutex _graphicsQueueMutex;
 
-  VkSwapchainKHR _swapChain;
+  VkSwapchainKHR _swapChain = VK_NULL_HANDLE;
   std::vector<VkImage> _swapChainImages;
+  std::vector<VkImageView> _swapChainImageViews;
   VkFormat _swapChainImageFormat;
   VkExtent2D _swapChainExtent;
+  // resized, or the last acquire or present said the swapchain no longer
+  // matches the surface
+  bool _swapChainOutOfDate = false;
+
+  // a replaced swapchain and everything per image, frames recorded before
+  // the replacement may still render to or present its images
+  struct RetiredSwapChain {
+    VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+    std::vector<VkImageView> views;
+    std::vector<VkSemaphore> renderFinishedSemaphores;
+    uint64_t frameNumber = 0;
+  };
+  std::vector<RetiredSwapChain> _retiredSwapChains;
+
+  rendering::OffscreenTarget _offscreen;
+
+  std::vector<rendering::FrameData> _frames;
+  rendering::FramePacer _pacer;
+  rendering::ParallelRecorder _recorder;
+  profiling::GpuProfiler _gpuProfiler;
+  rendering::RenderGraph _graph;
+
+  // owned by the simulation thread once the loop runs, the renderer only
+  // sees the interpolated instances
+  ecs::World _world;
+  scene::TransformHierarchy _hierarchy;
+  scene::Simulation _simulation;
+  scene::RenderInstances _renderInstances;
+  scene::GpuScene _gpuScene;
+  uint32_t _currentFrame = 0;
+  uint64_t _frameNumber = 0;
+
+  // indexed by swapchain image, a present may still be reading the image
+  // after the frame that rendered it has been recycled
+  std::vector<VkSemaphore> _renderFinishedSemaphores;
+  std::vector<VkFence> _imagesInFlight;
 };
 } // namespace engine
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "jobs/workStealingDeque.hpp"
+#include "memory/objectPool.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace jobs {
+
+using JobFunction = std::function<void()>;
+using RangeFunction = std::function<void(uint32_t begin, uint32_t end)>;
+
+class Counter;
+
+struct Job {
+  JobFunction function;
+  Counter *counter = nullptr;
+};
+
+// counts unfinished jobs. Jobs started with a counter increment it when
+// they are queued and decrement it when they finish, other jobs can be
+// made to wait for it to reach zero with runAfter()
+class Counter {
+public:
+  Counter() = default;
+  Counter(const Counter &) = delete;
+  Counter &operator=(const Counter &) = delete;
+
+  uint32_t value() const { return _value.load(std::memory_order_acquire); }
+  bool done() const { return value() == 0; }
+
+private:
+  friend class JobSystem;
+
+  std::atomic<uint32_t> _value{0};
+  // guards the decrement to zero so runAfter() can't miss it
+  std::mutex _mutex;
+  std::vector<Job *> _continuations;
+  std::exception_ptr _error;
+};
+
+// one worker per core, each with its own work-stealing deque. Jobs queued
+// from a worker go to that worker's deque, jobs queued from any other
+// thread go to a shared injection queue. Idle workers steal from each
+// other before going to sleep
+class JobSystem {
+public:
+  JobSystem() = default;
+  ~JobSystem();
+
+  JobSystem(const JobSystem &) = delete;
+  JobSystem &operator=(const JobSystem &) = delete;
+
+  // 0 uses one worker per core, minus one for the main thread
+  void init(uint32_t threadCount = 0);
+  // runs whatever is still queued, then joins the workers
+  void destroy();
+
+  void run(JobFunction job, Counter *counter = nullptr);
+  // queued once `dependency` reaches zero
+  void runAfter(Counter &dependency, JobFunction job,
+                Counter *counter = nullptr);
+  // splits [0, count) into jobs of at most `batchSize` indices
+  void parallelFor(uint32_t count, uint32_t batchSize, RangeFunction job,
+                   Counter &counter);
+
+  // runs other jobs on the calling thread until `counter` reaches zero,
+  // then rethrows the first exception a job of the counter threw
+  void wait(Counter &counter);
+
+  uint32_t threadCount() const {
+    return static_cast<uint32_t>(_workers.size());
+  }
+
+  // 1..threadCount() on workers, 0 on every other thread
+  static uint32_t workerIndex();
+
+  // every thread outside the pool shares index 0, so only one of them may
+  // run jobs while it waits. Others turn it off and just wait
+  static void setHelpWhileWaiting(bool help);
+
+private:
+  void workerLoop(uint32_t index);
+  void schedule(Job *job);
+  bool tryRunOne();
+  void execute(Job *job);
+  void finish(Counter &counter, std::exception_ptr error);
+
+  // every job is created and destroyed once, on whichever thread queues
+  // and runs it
+  memory::ObjectPool<Job> _jobPool;
+  std::vector<std::thread> _workers;
+  std::vector<std::unique_ptr<WorkStealingDeque<Job *>>> _deques;
+
+  std::mutex _injectionMutex;
+  std::deque<Job *> _injection;
+
+  // jobs sitting in any queue, lets workers sleep without losing wakeups
+  std::atomic<uint32_t> _queued{0};
+  std::atomic<uint32_t> _sleeping{0};
+  std::atomic<bool> _stopping{false};
+  std::mutex _sleepMutex;
+  std::condition_variable _wake;
+};
+
+} // namespace jobs
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace jobs {
+
+// fixed capacity Chase-Lev deque. The owning thread pushes and pops at the
+// bottom, any other thread steals from the top, none of them take a lock
+template <typename T> class WorkStealingDeque {
+public:
+  // capacity must be a power of two
+  explicit WorkStealingDeque(size_t capacity = 4096)
+      : _mask(static_cast<int64_t>(capacity) - 1),
+        _buffer(new std::atomic<T>[capacity]) {}
+
+  WorkStealingDeque(const WorkStealingDeque &) = delete;
+  WorkStealingDeque &operator=(const WorkStealingDeque &) = delete;
+
+  // owner only, fails when the deque is full
+  bool push(T item) {
+    int64_t bottom = _bottom.load(std::memory_order_relaxed);
+    int64_t top = _top.load(std::memory_order_acquire);
+    if (bottom - top > _mask) {
+      return false;
+    }
+
+    _buffer[bottom & _mask].store(item, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    _bottom.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // owner only, newest item first
+  bool pop(T &item) {
+    int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+    _bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = _top.load(std::memory_order_relaxed);
+
+    if (top > bottom) {
+      _bottom.store(bottom + 1, std::memory_order_relaxed);
+      return false;
+    }
+
+    item = _buffer[bottom & _mask].load(std::memory_order_relaxed);
+    if (top == bottom) {
+      // last item, race the thieves for it
+      bool won = _top.compare_exchange_strong(top, top + 1,
+                                              std::memory_order_seq_cst,
+                                              std::memory_order_relaxed);
+      _bottom.store(bottom + 1, std::memory_order_relaxed);
+      return won;
+    }
+    return true;
+  }
+
+  // any thread, oldest item first
+  bool steal(T &item) {
+    int64_t top = _top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = _bottom.load(std::memory_order_acquire);
+
+    if (top >= bottom) {
+      return false;
+    }
+
+    item = _buffer[top & _mask].load(std::memory_order_relaxed);
+    return _top.compare_exchange_strong(top, top + 1,
+                                        std::memory_order_seq_cst,
+                                        std::memory_order_relaxed);
+  }
+
+private:
+  // top and bottom are hammered by different threads, keep them apart
+  alignas(64) std::atomic<int64_t> _top{0};
+  alignas(64) std::atomic<int64_t> _bottom{0};
+  int64_t _mask;
+  std::unique_ptr<std::atomic<T>[]> _buffer;
+};
+
+} // namespace jobs
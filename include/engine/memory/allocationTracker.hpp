@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+namespace memory {
+
+struct AllocationCounters {
+  uint64_t count = 0;
+  uint64_t bytes = 0;
+};
+
+// counts calls to the global operator new on every thread. Needs
+// ENGINE_TRACK_ALLOCATIONS, without it nothing is counted and the
+// counters stay zero
+bool allocationTrackingAvailable();
+void trackAllocations(bool enabled);
+// everything counted while tracking was on
+AllocationCounters allocationCounters();
+// the part of allocationCounters() made on the calling thread
+AllocationCounters threadAllocationCounters();
+
+} // namespace memory
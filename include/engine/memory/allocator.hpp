@@ -0,0 +1,168 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <set>
+#include <vector>
+
+namespace memory {
+
+enum class MemoryUsage {
+  // device local, never touched by the CPU
+  GpuOnly,
+  // host visible and coherent, written by the CPU and read by the GPU
+  CpuToGpu,
+  // host visible, preferably cached, written by the GPU and read back
+  GpuToCpu,
+};
+
+struct Allocation {
+  VkDeviceMemory memory = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  VkDeviceSize size = 0;
+  // persistent mapping of the allocation, null for device local memory
+  void *mapped = nullptr;
+
+  uint32_t memoryType = 0;
+  // owning block within the memory type's pool, unused when dedicated
+  uint32_t block = 0;
+  uint8_t order = 0;
+  bool dedicated = false;
+};
+
+struct Buffer {
+  VkBuffer buffer = VK_NULL_HANDLE;
+  Allocation allocation;
+};
+
+struct Image {
+  VkImage image = VK_NULL_HANDLE;
+  Allocation allocation;
+};
+
+struct HeapStats {
+  VkDeviceSize size = 0;
+  // bytes reserved through vkAllocateMemory, blocks and dedicated
+  VkDeviceSize reservedBytes = 0;
+  // bytes handed out to resources
+  VkDeviceSize usedBytes = 0;
+  // as reported by VK_EXT_memory_budget, or estimated without it
+  VkDeviceSize budget = 0;
+  VkDeviceSize usage = 0;
+};
+
+struct AllocatorStats {
+  uint32_t deviceAllocationCount = 0;
+  uint32_t blockCount = 0;
+  uint32_t dedicatedCount = 0;
+  uint32_t allocationCount = 0;
+
+  VkDeviceSize reservedBytes = 0;
+  VkDeviceSize usedBytes = 0;
+  VkDeviceSize largestFreeRange = 0;
+  // 0 when all free space inside blocks is one contiguous range, approaching
+  // 1 as it is split into many small ranges
+  float fragmentation = 0.0f;
+
+  std::vector<HeapStats> heaps;
+};
+
+// one large VkDeviceMemory carved up by a binary buddy scheme, freed ranges
+// merge back with their buddy so long lived resources do not fragment it
+class BuddyBlock {
+public:
+  BuddyBlock(VkDeviceMemory memory, VkDeviceSize size, VkDeviceSize minSize,
+             void *mapped);
+
+  bool allocate(VkDeviceSize size, VkDeviceSize alignment,
+                VkDeviceSize &offset, uint8_t &order);
+  void free(VkDeviceSize offset, uint8_t order);
+
+  bool empty() const { return _freeBytes == _size; }
+  VkDeviceSize largestFreeRange() const;
+
+  VkDeviceMemory memory() const { return _memory; }
+  void *mapped() const { return _mapped; }
+  VkDeviceSize size() const { return _size; }
+  VkDeviceSize freeBytes() const { return _freeBytes; }
+
+private:
+  VkDeviceSize orderSize(uint8_t order) const { return _minSize << order; }
+
+  VkDeviceMemory _memory;
+  VkDeviceSize _size;
+  VkDeviceSize _minSize;
+  VkDeviceSize _freeBytes;
+  void *_mapped;
+  uint8_t _maxOrder;
+
+  // free ranges by order, order 0 being _minSize bytes
+  std::vector<std::set<VkDeviceSize>> _freeLists;
+};
+
+// engine owned device memory allocator. Resources are sub-allocated from
+// large blocks per memory type instead of one vkAllocateMemory each, which
+// keeps us well below maxMemoryAllocationCount and off the slow driver path
+class Allocator {
+public:
+  Allocator() = default;
+  ~Allocator();
+
+  void init(VkPhysicalDevice physicalDevice, VkDevice device,
+            bool memoryBudgetSupported);
+  void destroy();
+
+  Allocation allocate(const VkMemoryRequirements &requirements,
+                      MemoryUsage usage);
+  void free(Allocation &allocation);
+
+  Buffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                      MemoryUsage memoryUsage);
+  void destroyBuffer(Buffer &buffer);
+
+  Image createImage(const VkImageCreateInfo &imageInfo,
+                    MemoryUsage memoryUsage);
+  void destroyImage(Image &image);
+
+  // refreshes the driver reported budget, cheap enough to call every frame
+  void updateBudget();
+
+  AllocatorStats stats();
+  void printStats(std::ostream &out);
+
+  VkDevice device() const { return _device; }
+
+private:
+  struct Pool {
+    std::vector<std::unique_ptr<BuddyBlock>> blocks;
+  };
+
+  uint32_t findMemoryType(uint32_t typeFilter, MemoryUsage usage);
+  VkDeviceSize blockSizeFor(uint32_t memoryType);
+  VkDeviceMemory allocateDeviceMemory(uint32_t memoryType, VkDeviceSize size,
+                                      void **mapped);
+  void freeDeviceMemory(uint32_t memoryType, VkDeviceMemory memory,
+                        VkDeviceSize size);
+
+  VkPhysicalDevice _physicalDevice = VK_NULL_HANDLE;
+  VkDevice _device = VK_NULL_HANDLE;
+  VkPhysicalDeviceMemoryProperties _memoryProperties{};
+  VkDeviceSize _bufferImageGranularity = 1;
+  uint32_t _maxAllocationCount = 0;
+
+  bool _memoryBudgetSupported = false;
+  std::vector<HeapStats> _heaps;
+  std::vector<Pool> _pools;
+
+  uint32_t _deviceAllocationCount = 0;
+  uint32_t _dedicatedCount = 0;
+  uint32_t _allocationCount = 0;
+
+  std::mutex _mutex;
+};
+
+} // namespace memory
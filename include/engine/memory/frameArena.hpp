@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace memory {
+
+// bump allocator over a list of heap blocks. reset() rewinds to the first
+// block and keeps them all, so once the arena has grown to what a frame
+// needs it never touches the heap again. Not thread safe
+class LinearArena {
+public:
+  explicit LinearArena(size_t blockSize = 64 * 1024);
+  LinearArena(const LinearArena &) = delete;
+  LinearArena &operator=(const LinearArena &) = delete;
+
+  // larger than the block size gets a block of its own
+  void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+  // uninitialized, T must be trivially destructible, nothing is destroyed
+  template <typename T> T *allocateArray(size_t count) {
+    static_assert(std::is_trivially_destructible_v<T>,
+                  "arena memory is released without running destructors");
+    return static_cast<T *>(allocate(sizeof(T) * count, alignof(T)));
+  }
+
+  void reset();
+
+  size_t used() const;
+  size_t capacity() const;
+
+private:
+  struct Block {
+    std::unique_ptr<std::byte[]> data;
+    size_t size = 0;
+  };
+
+  size_t _blockSize;
+  std::vector<Block> _blocks;
+  // block being bumped and the offset into it
+  size_t _current = 0;
+  size_t _offset = 0;
+  size_t _usedInEarlierBlocks = 0;
+};
+
+// std allocator on top of a LinearArena, deallocate is a no-op
+template <typename T> class ArenaAllocator {
+public:
+  using value_type = T;
+
+  explicit ArenaAllocator(LinearArena &arena) : _arena(&arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U> &other) : _arena(other.arena()) {}
+
+  T *allocate(size_t count) {
+    return static_cast<T *>(_arena->allocate(sizeof(T) * count, alignof(T)));
+  }
+  void deallocate(T *, size_t) {}
+
+  LinearArena *arena() const { return _arena; }
+
+  template <typename U> bool operator==(const ArenaAllocator<U> &other) const {
+    return _arena == other.arena();
+  }
+  template <typename U> bool operator!=(const ArenaAllocator<U> &other) const {
+    return _arena != other.arena();
+  }
+
+private:
+  LinearArena *_arena;
+};
+
+template <typename T> using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+// one LinearArena per thread per frame in flight, for CPU data that only
+// lives as long as the frame recording it. A frame's arenas are rewound
+// once its fence has signaled, like RingBuffer does for GPU memory.
+//
+// Threads are told apart by JobSystem::workerIndex(), so only the render
+// thread and the job workers may use it
+class FrameArena {
+public:
+  // threadCount includes the render thread, JobSystem::threadCount() + 1
+  void create(uint32_t frameCount, uint32_t threadCount,
+              size_t blockSize = 64 * 1024);
+  void destroy();
+
+  // only call once the frame slot's fence has signaled
+  void beginFrame(uint32_t frameIndex);
+
+  // the calling thread's arena for the current frame
+  LinearArena &local();
+
+  // bytes handed out this frame across all threads, and reserved in total
+  size_t usedThisFrame() const;
+  size_t capacity() const;
+
+private:
+  uint32_t _frameCount = 0;
+  uint32_t _threadCount = 0;
+  uint32_t _frameIndex = 0;
+  // frame major, _frameIndex * _threadCount + thread
+  std::vector<std::unique_ptr<LinearArena>> _arenas;
+};
+
+} // namespace memory
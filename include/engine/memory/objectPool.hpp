@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace memory {
+
+// fixed size slots for objects created and destroyed at a high rate. Slots
+// come from blocks of `BlockSize` that are never returned until the pool
+// goes away, so once a pool has seen its peak it stops touching the heap.
+// Safe to use from any thread
+template <typename T, size_t BlockSize = 256> class ObjectPool {
+public:
+  ObjectPool() = default;
+  ObjectPool(const ObjectPool &) = delete;
+  ObjectPool &operator=(const ObjectPool &) = delete;
+
+  template <typename... Args> T *create(Args &&...args) {
+    Slot *slot = acquire();
+    try {
+      return new (slot->storage) T(std::forward<Args>(args)...);
+    } catch (...) {
+      release(slot);
+      throw;
+    }
+  }
+
+  void destroy(T *object) {
+    object->~T();
+    release(reinterpret_cast<Slot *>(object));
+  }
+
+  size_t liveCount() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _live;
+  }
+  size_t capacity() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _blocks.size() * BlockSize;
+  }
+
+private:
+  union Slot {
+    Slot *next;
+    alignas(T) std::byte storage[sizeof(T)];
+  };
+
+  Slot *acquire() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_free == nullptr) {
+      _blocks.push_back(std::make_unique<Slot[]>(BlockSize));
+      Slot *block = _blocks.back().get();
+      for (size_t i = 0; i < BlockSize; i++) {
+        block[i].next = _free;
+        _free = &block[i];
+      }
+    }
+    Slot *slot = _free;
+    _free = slot->next;
+    _live++;
+    return slot;
+  }
+
+  void release(Slot *slot) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    slot->next = _free;
+    _free = slot;
+    _live--;
+  }
+
+  mutable std::mutex _mutex;
+  std::vector<std::unique_ptr<Slot[]>> _blocks;
+  Slot *_free = nullptr;
+  size_t _live = 0;
+};
+
+} // namespace memory
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "memory/allocator.hpp"
+
+#include <atomic>
+
+namespace memory {
+
+struct TransientAllocation {
+  VkBuffer buffer = VK_NULL_HANDLE;
+  VkDeviceSize offset = 0;
+  void *mapped = nullptr;
+};
+
+// persistently mapped buffer split into one linear region per frame in
+// flight. Per-frame data (uniforms, dynamic vertices) is bump allocated and
+// the whole region is recycled at once when its frame's fence has signaled
+class RingBuffer {
+public:
+  RingBuffer() = default;
+  ~RingBuffer();
+
+  void create(Allocator &allocator, VkDeviceSize bytesPerFrame,
+              uint32_t frameCount, VkBufferUsageFlags usage);
+  void destroy();
+
+  // only call once the GPU is done with everything `frameIndex` recorded
+  void beginFrame(uint32_t frameIndex);
+
+  // safe to call from several threads recording the same frame
+  TransientAllocation allocate(VkDeviceSize size,
+                               VkDeviceSize alignment = 256);
+
+  VkBuffer buffer() const { return _buffer.buffer; }
+  VkDeviceSize usedThisFrame() const { return _head.load() - _frameBase; }
+
+private:
+  Allocator *_allocator = nullptr;
+  Buffer _buffer;
+
+  VkDeviceSize _frameSize = 0;
+  VkDeviceSize _frameBase = 0;
+  std::atomic<VkDeviceSize> _head{0};
+};
+
+} // namespace memory
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// PROFILE_SCOPE("name") times the rest of the enclosing block. Builds
+// without ENGINE_PROFILING compile every scope out, with it a scope is a
+// single flag check while profiling is disabled at runtime
+#ifdef ENGINE_PROFILING
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name)                                                    \
+  ::profiling::CpuScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_THREAD(name) ::profiling::setThreadName(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_THREAD(name) ((void)0)
+#endif
+
+namespace profiling {
+
+// events are only recorded while enabled
+void enableCpuProfiling(bool enabled);
+bool cpuProfilingEnabled();
+
+// nanoseconds on a steady clock
+uint64_t cpuTimestamp();
+
+// appends to the calling thread's own buffer, which no other thread ever
+// writes to. `name` must outlive the profiler, string literals are the
+// intent. Events past a thread's capacity are dropped and counted
+void recordCpuEvent(const char *name, uint64_t begin, uint64_t end);
+
+// label for the calling thread in exported traces
+void setThreadName(const std::string &name);
+
+// Chrome trace event JSON, opens in chrome://tracing and ui.perfetto.dev.
+// Safe while other threads keep recording, their newer events are left out
+void writeChromeTrace(const std::string &path);
+
+class CpuScope {
+public:
+  explicit CpuScope(const char *name)
+      : _name(cpuProfilingEnabled() ? name : nullptr),
+        _begin(_name != nullptr ? cpuTimestamp() : 0) {}
+  ~CpuScope() {
+    if (_name != nullptr) {
+      recordCpuEvent(_name, _begin, cpuTimestamp());
+    }
+  }
+
+  CpuScope(const CpuScope &) = delete;
+  CpuScope &operator=(const CpuScope &) = delete;
+
+private:
+  const char *_name;
+  uint64_t _begin;
+};
+
+} // namespace profiling
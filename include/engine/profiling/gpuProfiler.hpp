@@ -0,0 +1,138 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace profiling {
+
+enum class PipelineStatistic : uint32_t {
+  InputVertices,
+  InputPrimitives,
+  VertexInvocations,
+  ClippingPrimitives,
+  FragmentInvocations,
+  ComputeInvocations,
+  Count,
+};
+
+constexpr uint32_t pipelineStatisticCount =
+    static_cast<uint32_t>(PipelineStatistic::Count);
+
+struct GpuScopeResult {
+  const char *name = nullptr;
+  // index into GpuFrameResult::scopes, UINT32_MAX for top level scopes
+  uint32_t parent = UINT32_MAX;
+  uint32_t depth = 0;
+  double milliseconds = 0.0;
+  bool hasStatistics = false;
+  uint64_t statistics[pipelineStatisticCount] = {};
+};
+
+// scopes are in the order they were begun, so every parent comes before
+// its children
+struct GpuFrameResult {
+  uint64_t frameNumber = 0;
+  // first scope begin to last scope end
+  double milliseconds = 0.0;
+  std::vector<GpuScopeResult> scopes;
+};
+
+// timestamp and pipeline statistics queries around named scopes of a
+// primary command buffer. Each frame in flight has its own query pools,
+// which are read back without waiting when that frame slot comes round
+// again, so results trail recording by framesInFlight frames. Everything
+// becomes a no-op on queue families without timestamp support
+class GpuProfiler {
+public:
+  GpuProfiler() = default;
+  ~GpuProfiler();
+
+  // pipeline statistics need the pipelineStatisticsQuery and
+  // inheritedQueries features enabled on the device
+  void create(VkPhysicalDevice physicalDevice, VkDevice device,
+              uint32_t queueFamily, uint32_t frameCount,
+              bool pipelineStatistics, uint32_t maxScopes = 128);
+  void destroy();
+
+  // right after vkBeginCommandBuffer, once the frame slot's fence has been
+  // waited on. Collects the slot's previous results and resets its pools
+  void beginFrame(VkCommandBuffer commandBuffer, uint32_t frameIndex,
+                  uint64_t frameNumber);
+
+  // `name` has to outlive the results, string literals are the intent.
+  // Pipeline statistics are gathered by the outermost scope only, as
+  // queries of one type cannot nest
+  uint32_t beginScope(VkCommandBuffer commandBuffer, const char *name);
+  void endScope(VkCommandBuffer commandBuffer, uint32_t scope);
+
+  bool enabled() const { return _enabled; }
+  // for VkCommandBufferInheritanceInfo::pipelineStatistics of secondaries
+  // executed inside a scope, 0 when statistics are off
+  VkQueryPipelineStatisticFlags statisticsFlags() const;
+
+  // the most recent frame whose queries have been read back
+  const GpuFrameResult &result() const { return _result; }
+  void print(std::ostream &out) const;
+
+private:
+  struct Scope {
+    const char *name;
+    uint32_t parent;
+    uint32_t depth;
+    uint32_t statisticsQuery;
+  };
+
+  struct Frame {
+    VkQueryPool timestamps = VK_NULL_HANDLE;
+    VkQueryPool statistics = VK_NULL_HANDLE;
+    std::vector<Scope> scopes;
+    uint32_t statisticsCount = 0;
+    uint64_t frameNumber = 0;
+  };
+
+  void collect(Frame &frame);
+
+  VkDevice _device = VK_NULL_HANDLE;
+  bool _enabled = false;
+  bool _statisticsEnabled = false;
+  uint32_t _maxScopes = 0;
+  // nanoseconds per tick
+  double _timestampPeriod = 1.0;
+  uint64_t _timestampMask = ~0ull;
+
+  std::vector<Frame> _frames;
+  Frame *_current = nullptr;
+  std::vector<uint32_t> _stack;
+  // the scope holding the open statistics query
+  uint32_t _statisticsScope = UINT32_MAX;
+
+  GpuFrameResult _result;
+  // collect() fills this and swaps it with _result, so both keep their
+  // capacity. The query read back buffers are sized for _maxScopes
+  GpuFrameResult _collected;
+  std::vector<uint64_t> _timestampValues;
+  std::vector<uint64_t> _statisticsValues;
+};
+
+// begins a scope on construction and ends it when it goes out of scope
+class GpuScope {
+public:
+  GpuScope(GpuProfiler &profiler, VkCommandBuffer commandBuffer,
+           const char *name)
+      : _profiler(profiler), _commandBuffer(commandBuffer),
+        _scope(profiler.beginScope(commandBuffer, name)) {}
+  ~GpuScope() { _profiler.endScope(_commandBuffer, _scope); }
+
+  GpuScope(const GpuScope &) = delete;
+  GpuScope &operator=(const GpuScope &) = delete;
+
+private:
+  GpuProfiler &_profiler;
+  VkCommandBuffer _commandBuffer;
+  uint32_t _scope;
+};
+
+} // namespace profiling
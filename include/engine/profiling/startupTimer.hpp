@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace profiling {
+
+// wall clock breakdown of engine startup, from the constructor to the
+// first submitted frame. Phases may overlap and run on any thread, each is
+// reported with its offset from start() so the overlap shows
+class StartupTimer {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  void start();
+  // `name` must outlive the timer, string literals are the intent
+  void record(const char *name, Clock::time_point begin,
+              Clock::time_point end);
+  // the first frame has been submitted, later calls do nothing
+  void finish();
+
+  bool finished() const { return _finished; }
+  double totalMilliseconds() const;
+  void print(std::ostream &out) const;
+
+private:
+  struct Phase {
+    const char *name;
+    double beginMilliseconds;
+    double milliseconds;
+  };
+
+  Clock::time_point _start;
+  Clock::time_point _end;
+  bool _finished = false;
+
+  // phases finish on whichever thread ran them
+  mutable std::mutex _mutex;
+  std::vector<Phase> _phases;
+};
+
+// records the rest of the enclosing block as one startup phase
+class StartupPhase {
+public:
+  StartupPhase(StartupTimer &timer, const char *name)
+      : _timer(timer), _name(name), _begin(StartupTimer::Clock::now()) {}
+  ~StartupPhase() {
+    _timer.record(_name, _begin, StartupTimer::Clock::now());
+  }
+
+  StartupPhase(const StartupPhase &) = delete;
+  StartupPhase &operator=(const StartupPhase &) = delete;
+
+private:
+  StartupTimer &_timer;
+  const char *_name;
+  StartupTimer::Clock::time_point _begin;
+};
+
+} // namespace profiling
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace rendering {
+
+// bindings of the global set, must match shaders/bindless.glsl
+enum class BindlessBinding : uint32_t {
+  SampledImages,
+  StorageBuffers,
+  Samplers,
+  Count,
+};
+
+struct BindlessLimits {
+  uint32_t sampledImages = 65536;
+  uint32_t storageBuffers = 65536;
+  uint32_t samplers = 256;
+};
+
+// one update-after-bind descriptor set holding every sampled image,
+// storage buffer and sampler, which shaders index by the integer handles
+// handed out here. It is bound once per command buffer instead of
+// allocating and binding sets per draw.
+//
+// Needs descriptorIndexing with runtime arrays, partially bound bindings
+// and update-after-bind for sampled images and storage buffers. Sampler 0
+// is always a linear repeat sampler
+class BindlessHeap {
+public:
+  static constexpr uint32_t invalidHandle = UINT32_MAX;
+
+  BindlessHeap() = default;
+  ~BindlessHeap();
+  BindlessHeap(const BindlessHeap &) = delete;
+  BindlessHeap &operator=(const BindlessHeap &) = delete;
+
+  // the limits are clamped to what the device supports
+  void create(VkPhysicalDevice physicalDevice, VkDevice device,
+              uint32_t framesInFlight, const BindlessLimits &limits = {});
+  void destroy();
+
+  // safe from any thread. The descriptor is written before the handle is
+  // returned, frames already recorded never read the new slot
+  uint32_t addImage(VkImageView view,
+                    VkImageLayout layout =
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+  uint32_t addStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0,
+                            VkDeviceSize range = VK_WHOLE_SIZE);
+  uint32_t addSampler(VkSampler sampler);
+
+  // the slot is handed out again once every frame that may have read it
+  // has retired, the resource itself may be destroyed at the same point
+  void remove(BindlessBinding binding, uint32_t handle);
+
+  // main thread, once per frame after the frame's fence wait
+  void beginFrame(uint64_t frameNumber);
+
+  void bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint,
+            VkPipelineLayout layout, uint32_t set = 0) const;
+
+  bool enabled() const { return _set != VK_NULL_HANDLE; }
+  VkDescriptorSetLayout layout() const { return _layout; }
+  VkDescriptorSet set() const { return _set; }
+  uint32_t capacity(BindlessBinding binding) const;
+  // handles currently in use
+  uint32_t count(BindlessBinding binding) const;
+
+private:
+  struct Slots {
+    uint32_t capacity = 0;
+    // slots below this have been handed out at least once
+    uint32_t highWater = 0;
+    std::vector<uint32_t> free;
+    // frame a removed slot was removed in
+    std::deque<std::pair<uint64_t, uint32_t>> retired;
+  };
+
+  uint32_t allocate(BindlessBinding binding);
+  void write(BindlessBinding binding, uint32_t handle,
+             const VkDescriptorImageInfo *imageInfo,
+             const VkDescriptorBufferInfo *bufferInfo);
+
+  VkDevice _device = VK_NULL_HANDLE;
+  uint32_t _framesInFlight = 1;
+
+  VkDescriptorSetLayout _layout = VK_NULL_HANDLE;
+  VkDescriptorPool _pool = VK_NULL_HANDLE;
+  VkDescriptorSet _set = VK_NULL_HANDLE;
+  VkSampler _defaultSampler = VK_NULL_HANDLE;
+
+  // guards the slots and descriptor writes, vkUpdateDescriptorSets on one
+  // set is externally synchronized
+  mutable std::mutex _mutex;
+  Slots _slots[static_cast<uint32_t>(BindlessBinding::Count)];
+  uint64_t _frame = 0;
+};
+
+} // namespace rendering
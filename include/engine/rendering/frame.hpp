@@ -0,0 +1,17 @@
+#pragma once
+
+#include "types.hpp"
+
+namespace rendering {
+
+// everything a single frame in flight needs to be recorded and submitted
+// without touching the resources of the frames the GPU is still working on
+struct FrameData {
+  VkCommandPool commandPool = VK_NULL_HANDLE;
+  VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+  VkSemaphore imageAvailableSemaphore = VK_NULL_HANDLE;
+  VkFence inFlightFence = VK_NULL_HANDLE;
+};
+
+} // namespace rendering
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace rendering {
+
+enum class PacingMode {
+  // mailbox or immediate, the CPU runs at most one frame ahead of the
+  // display so input is sampled as late as possible
+  LowLatency,
+  // fifo, the full framesInFlight queue absorbs CPU hitches
+  Steady,
+  // fifo with the fewest images, one frame ahead and capped at 30 fps
+  // unless a frame rate limit is given
+  PowerSaving,
+};
+
+const char *pacingModeName(PacingMode mode);
+
+// CPU frame to frame intervals over the last few seconds
+struct FrameTimeStats {
+  uint32_t frameCount = 0;
+  double meanMilliseconds = 0.0;
+  double stdDevMilliseconds = 0.0;
+  double p99Milliseconds = 0.0;
+  double maxMilliseconds = 0.0;
+};
+
+// decides how the swapchain presents and how far the CPU may run ahead of
+// it. With VK_KHR_present_id and VK_KHR_present_wait the CPU waits for
+// the display itself, otherwise for the GPU to finish older frames
+class FramePacer {
+public:
+  // `frameRateLimit` in frames per second, 0 leaves it to the mode.
+  // `presentWait` needs both extensions and their features enabled
+  void create(VkDevice device, PacingMode mode, uint32_t framesInFlight,
+              float frameRateLimit, bool presentWait);
+
+  VkPresentModeKHR
+  choosePresentMode(const std::vector<VkPresentModeKHR> &available) const;
+  uint32_t chooseImageCount(const VkSurfaceCapabilitiesKHR &capabilities) const;
+
+  // frames recorded but not yet displayed (present wait) or not yet
+  // finished on the GPU (fences) when the next one starts
+  uint32_t framesAhead() const { return _framesAhead; }
+
+  // present ids only increase per swapchain, frames presented to the old
+  // one are never waited for
+  void swapchainChanged(uint64_t frameNumber);
+  // chains the frame's present id into `presentInfo`, which has to be
+  // presented before the next call
+  void attachPresentId(VkPresentInfoKHR &presentInfo, uint64_t frameNumber);
+  // before the frame samples input. Returns false without present wait,
+  // the caller then throttles on the fence of frame N - framesAhead()
+  bool waitForPresent(VkSwapchainKHR swapchain, uint64_t frameNumber);
+
+  // sleeps off the rest of the frame under a frame rate limit and starts
+  // timing the next one
+  void beginFrame();
+
+  FrameTimeStats stats() const;
+  void print(std::ostream &out) const;
+
+  PacingMode mode() const { return _mode; }
+  bool presentWaitEnabled() const { return _waitForPresent != nullptr; }
+
+private:
+  static constexpr uint32_t historySize = 240;
+
+  VkDevice _device = VK_NULL_HANDLE;
+  PacingMode _mode = PacingMode::Steady;
+  uint32_t _framesAhead = 1;
+  PFN_vkWaitForPresentKHR _waitForPresent = nullptr;
+
+  VkPresentIdKHR _presentId{};
+  uint64_t _presentIdValue = 0;
+  uint64_t _firstPresentId = 1;
+
+  std::chrono::steady_clock::duration _frameInterval{0};
+  std::chrono::steady_clock::time_point _nextFrame;
+  std::chrono::steady_clock::time_point _lastFrame;
+  bool _started = false;
+
+  // ring of the latest frame times in milliseconds
+  std::vector<double> _history;
+  uint32_t _historyNext = 0;
+};
+
+} // namespace rendering
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "memory/allocator.hpp"
+#include "types.hpp"
+#include <cstdint>
+#include <vector>
+
+namespace rendering {
+
+// color targets used in place of the swapchain when running without a
+// window, one image per frame in flight so frames never share a target
+class OffscreenTarget {
+public:
+  OffscreenTarget() = default;
+  ~OffscreenTarget();
+
+  void create(memory::Allocator &allocator, VkFormat format,
+              VkExtent2D extent, uint32_t imageCount);
+  void destroy();
+
+  // copies an image that was left in TRANSFER_SRC_OPTIMAL into host memory
+  // as tightly packed texels, blocks until the copy is done
+  std::vector<uint8_t> readback(VkQueue queue, uint32_t queueFamily,
+                                uint32_t index);
+
+  VkImage image(uint32_t index) const { return _images[index].image; }
+  VkImageView view(uint32_t index) const { return _views[index]; }
+  uint32_t imageCount() const { return static_cast<uint32_t>(_images.size()); }
+  VkFormat format() const { return _format; }
+  VkExtent2D extent() const { return _extent; }
+
+private:
+  memory::Allocator *_allocator = nullptr;
+  VkDevice _device = VK_NULL_HANDLE;
+
+  std::vector<memory::Image> _images;
+  std::vector<VkImageView> _views;
+
+  VkFormat _format = VK_FORMAT_UNDEFINED;
+  VkExtent2D _extent{};
+};
+
+} // namespace rendering
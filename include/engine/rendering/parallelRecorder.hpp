@@ -0,0 +1,58 @@
+#pragma once
+
+#include "jobs/jobSystem.hpp"
+#include "types.hpp"
+
+#include <functional>
+#include <vector>
+
+namespace rendering {
+
+// records items [begin, end) into an already begun secondary buffer
+using RecordFunction =
+    std::function<void(VkCommandBuffer commandBuffer, uint32_t begin,
+                       uint32_t end)>;
+
+// splits draw recording across the job system. Every thread that can run
+// a job owns one command pool per frame in flight, so recording never
+// takes a lock, and each batch of items lands in its own secondary buffer
+class ParallelRecorder {
+public:
+  ParallelRecorder() = default;
+  ~ParallelRecorder();
+
+  // threadCount includes the recording thread, JobSystem::threadCount() + 1
+  void create(VkDevice device, uint32_t queueFamily, uint32_t frameCount,
+              uint32_t threadCount);
+  void destroy();
+
+  // only call once the GPU is done with everything `frameIndex` recorded
+  void beginFrame(uint32_t frameIndex);
+
+  // records `count` items in batches of `batchSize` and blocks until all
+  // of them are done. Secondaries are returned in item order, ready for
+  // vkCmdExecuteCommands, and stay valid until the next call
+  const std::vector<VkCommandBuffer> &
+  record(jobs::JobSystem &jobs, uint32_t count, uint32_t batchSize,
+         const VkCommandBufferInheritanceInfo &inheritance,
+         const RecordFunction &recordFunction);
+
+private:
+  struct ThreadPool {
+    VkCommandPool pool = VK_NULL_HANDLE;
+    std::vector<VkCommandBuffer> buffers;
+    uint32_t used = 0;
+  };
+
+  VkCommandBuffer nextBuffer(ThreadPool &threadPool);
+
+  VkDevice _device = VK_NULL_HANDLE;
+  uint32_t _threadCount = 0;
+  uint32_t _frameIndex = 0;
+  // frame major, _pools[frame * _threadCount + thread]
+  std::vector<ThreadPool> _pools;
+  // reused every frame so recording never grows it past the peak
+  std::vector<VkCommandBuffer> _secondaries;
+};
+
+} // namespace rendering
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "types.hpp"
+
+#include <string>
+#include <vector>
+
+namespace rendering {
+
+// VkPipelineCache that is loaded from and saved to disk. The file is only
+// trusted when it was written for the same device and driver build
+class PipelineCache {
+public:
+  PipelineCache() = default;
+  ~PipelineCache();
+
+  // reads the file, needs no device so it can run on any thread while the
+  // device is still being created
+  void load(std::string path);
+  // checks what load() read against the device, a mismatch starts empty
+  void create(VkPhysicalDevice physicalDevice, VkDevice device);
+  void save();
+  void destroy();
+
+  VkPipelineCache handle() const { return _cache; }
+  bool loadedFromDisk() const { return _loadedFromDisk; }
+
+private:
+  struct Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t deviceUUID[VK_UUID_SIZE];
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+    uint64_t dataSize;
+    uint64_t dataHash;
+  };
+
+  Header expectedHeader();
+
+  VkPhysicalDevice _physicalDevice = VK_NULL_HANDLE;
+  VkDevice _device = VK_NULL_HANDLE;
+  VkPipelineCache _cache = VK_NULL_HANDLE;
+  std::string _path;
+  bool _loadedFromDisk = false;
+
+  // from load(), until create() has handed it to the driver
+  Header _fileHeader{};
+  std::vector<char> _fileData;
+};
+
+} // namespace rendering
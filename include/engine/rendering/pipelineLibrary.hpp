@@ -0,0 +1,139 @@
+#pragma once
+
+#include "jobs/jobSystem.hpp"
+#include "rendering/pipelineCache.hpp"
+#include "rendering/shaderCompiler.hpp"
+#include "types.hpp"
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace rendering {
+
+struct GraphicsPipelineDesc {
+  std::string name;
+  ShaderSource vertex;
+  ShaderSource fragment;
+
+  std::vector<VkVertexInputBindingDescription> vertexBindings;
+  std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  VkCullModeFlags cullMode = 0;
+  bool blend = false;
+
+  // dynamic rendering attachment formats
+  std::vector<VkFormat> colorFormats;
+  VkFormat depthFormat = VK_FORMAT_UNDEFINED;
+  bool depthTest = false;
+  bool depthWrite = false;
+
+  std::vector<VkDescriptorSetLayout> setLayouts;
+  uint32_t pushConstantSize = 0;
+};
+
+struct ComputePipelineDesc {
+  std::string name;
+  ShaderSource shader;
+
+  std::vector<VkDescriptorSetLayout> setLayouts;
+  uint32_t pushConstantSize = 0;
+};
+
+// every pipeline the engine may need, declared up front so all of them can
+// be built before they are first drawn with
+struct PipelineManifest {
+  std::vector<GraphicsPipelineDesc> graphics;
+  std::vector<ComputePipelineDesc> compute;
+};
+
+// builds pipelines through the persistent PipelineCache as background
+// jobs. The render thread never waits on a pipeline compile, get() returns
+// VK_NULL_HANDLE until the pipeline is ready. Edited shaders are rebuilt
+// the same way and take over at a frame boundary
+class PipelineLibrary {
+public:
+  PipelineLibrary() = default;
+  ~PipelineLibrary();
+
+  void init(VkDevice device, ShaderCompiler &shaderCompiler,
+            PipelineCache &pipelineCache, jobs::JobSystem &jobs,
+            uint32_t framesInFlight);
+  void destroy();
+
+  // queues everything in the manifest and returns immediately
+  void prewarm(const PipelineManifest &manifest);
+
+  // compares every pipeline's shaders with the ones it was built from and
+  // rebuilds those that changed as background jobs. The pipelines in use
+  // stay valid until update() replaces them
+  void reload();
+  // render thread, at the start of a frame before anything is recorded.
+  // Swaps rebuilt pipelines in and destroys the replaced ones once no
+  // frame in flight can still be using them
+  void update(uint64_t frameNumber);
+
+  VkPipeline get(const std::string &name) const;
+  VkPipelineLayout layout(const std::string &name) const;
+
+  // blocks until `name` is built, for loading screens and tools
+  VkPipeline wait(const std::string &name);
+  bool idle() const;
+
+private:
+  struct Entry {
+    GraphicsPipelineDesc graphics;
+    ComputePipelineDesc compute;
+    bool isCompute = false;
+
+    VkPipelineLayout layout = VK_NULL_HANDLE;
+    std::atomic<VkPipeline> pipeline{VK_NULL_HANDLE};
+    jobs::Counter built;
+    // keys of the shaders `pipeline` was built from, empty until it is
+    std::vector<uint64_t> keys;
+
+    // a rebuild waiting for update() to swap it in, with its keys
+    VkPipeline replacement = VK_NULL_HANDLE;
+    std::vector<uint64_t> replacementKeys;
+    jobs::Counter rebuilt;
+    // changed again while being built, checked once more when it lands
+    bool stale = false;
+  };
+
+  // frames before `frameNumber` may still be drawing with it
+  struct RetiredPipeline {
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    uint64_t frameNumber = 0;
+  };
+
+  Entry &addEntry(const std::string &name,
+                  const std::vector<VkDescriptorSetLayout> &setLayouts,
+                  uint32_t pushConstantSize, VkShaderStageFlags stages);
+  void build(Entry &entry);
+  // only builds when the shader keys no longer match entry.keys
+  void rebuild(Entry &entry);
+  std::vector<uint64_t> shaderKeys(const Entry &entry);
+  // `keys` is only written when the pipeline was created
+  VkPipeline buildPipeline(const Entry &entry, std::vector<uint64_t> &keys);
+  VkPipeline buildGraphics(const GraphicsPipelineDesc &desc,
+                           VkPipelineLayout layout,
+                           std::vector<uint64_t> &keys);
+  VkPipeline buildCompute(const ComputePipelineDesc &desc,
+                          VkPipelineLayout layout,
+                          std::vector<uint64_t> &keys);
+
+  VkDevice _device = VK_NULL_HANDLE;
+  ShaderCompiler *_shaderCompiler = nullptr;
+  PipelineCache *_pipelineCache = nullptr;
+  jobs::JobSystem *_jobs = nullptr;
+  uint32_t _framesInFlight = 0;
+
+  std::unordered_map<std::string, std::unique_ptr<Entry>> _entries;
+  // set by reload() until every rebuild it started has been swapped in
+  bool _reloading = false;
+  std::vector<RetiredPipeline> _retired;
+};
+
+} // namespace rendering
@@ -0,0 +1,323 @@
+#pragma once
+
+#include "memory/allocator.hpp"
+#include "memory/frameArena.hpp"
+#include "profiling/gpuProfiler.hpp"
+#include "types.hpp"
+
+#include <deque>
+#include <new>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace rendering {
+
+struct GraphImage {
+  uint32_t index = UINT32_MAX;
+
+  bool valid() const { return index != UINT32_MAX; }
+};
+
+struct GraphBuffer {
+  uint32_t index = UINT32_MAX;
+
+  bool valid() const { return index != UINT32_MAX; }
+};
+
+// how a pass touches a resource, each maps to the stages, access and
+// layout the graph synchronizes with
+enum class ImageUsage {
+  ColorAttachment,
+  DepthAttachment,
+  DepthRead,
+  SampledFragment,
+  SampledCompute,
+  StorageRead,
+  StorageWrite,
+  TransferSrc,
+  TransferDst,
+};
+
+enum class BufferUsage {
+  IndirectRead,
+  VertexRead,
+  IndexRead,
+  UniformRead,
+  StorageReadGraphics,
+  StorageReadCompute,
+  StorageWriteCompute,
+  TransferSrc,
+  TransferDst,
+};
+
+struct ResourceState {
+  VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+  VkAccessFlags2 access = VK_ACCESS_2_NONE;
+  VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+};
+
+// transient images only exist for the frame, their usage flags are
+// collected from the passes that use them
+struct TransientImageDesc {
+  VkFormat format = VK_FORMAT_UNDEFINED;
+  VkExtent2D extent{};
+  VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+};
+
+class RenderGraph;
+
+class GraphPass {
+public:
+  GraphPass &read(GraphImage image, ImageUsage usage);
+  GraphPass &write(GraphImage image, ImageUsage usage);
+  GraphPass &read(GraphBuffer buffer, BufferUsage usage);
+  GraphPass &write(GraphBuffer buffer, BufferUsage usage);
+
+  // attachments make the graph wrap the pass in vkCmdBeginRendering
+  GraphPass &colorAttachment(GraphImage image, VkAttachmentLoadOp loadOp,
+                             VkClearColorValue clear = {});
+  GraphPass &depthAttachment(GraphImage image, VkAttachmentLoadOp loadOp,
+                             float clearDepth = 1.0f);
+  GraphPass &renderingFlags(VkRenderingFlags flags);
+
+  // kept even when nothing reads what it writes
+  GraphPass &sideEffects();
+  // called as function(VkCommandBuffer, RenderGraph &). The callable is
+  // moved into the graph's arena, declaring a frame never allocates once
+  // the graph has seen one like it
+  template <typename Function> GraphPass &execute(Function &&function);
+
+private:
+  friend class RenderGraph;
+
+  struct PassFunction {
+    void *object = nullptr;
+    void (*invoke)(void *object, VkCommandBuffer commandBuffer,
+                   RenderGraph &graph) = nullptr;
+    void (*destroy)(void *object) = nullptr;
+  };
+
+  // passes are reused from frame to frame, this keeps their capacity
+  void reset(const char *name, memory::LinearArena &arena);
+  void releaseFunction();
+
+  struct ImageAccess {
+    uint32_t image;
+    ImageUsage usage;
+    bool write;
+  };
+  struct BufferAccess {
+    uint32_t buffer;
+    BufferUsage usage;
+    bool write;
+  };
+  struct Attachment {
+    uint32_t image;
+    VkAttachmentLoadOp loadOp;
+    VkClearValue clear;
+  };
+
+  const char *_name = nullptr;
+  std::vector<ImageAccess> _images;
+  std::vector<BufferAccess> _buffers;
+  std::vector<Attachment> _colorAttachments;
+  Attachment _depthAttachment{UINT32_MAX, VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                              {}};
+  VkRenderingFlags _renderingFlags = 0;
+  bool _sideEffects = false;
+  memory::LinearArena *_arena = nullptr;
+  PassFunction _function;
+};
+
+template <typename Function>
+GraphPass &GraphPass::execute(Function &&function) {
+  using Stored = std::decay_t<Function>;
+  releaseFunction();
+
+  void *object = _arena->allocate(sizeof(Stored), alignof(Stored));
+  _function.object = new (object) Stored(std::forward<Function>(function));
+  _function.invoke = [](void *object, VkCommandBuffer commandBuffer,
+                        RenderGraph &graph) {
+    (*static_cast<Stored *>(object))(commandBuffer, graph);
+  };
+  _function.destroy = [](void *object) {
+    static_cast<Stored *>(object)->~Stored();
+  };
+  return *this;
+}
+
+// a frame declared as passes with the resources they read and write.
+// compile() drops passes nothing depends on, places transient images
+// whose lifetimes do not overlap in the same memory, and works out the
+// barriers. execute() records every pass with one vkCmdPipelineBarrier2
+// in front of it holding all of the barriers the pass needs
+//
+// declared again every frame, the transient images are only recreated
+// when the set of transients or their lifetimes change
+class RenderGraph {
+public:
+  RenderGraph() = default;
+  ~RenderGraph();
+
+  void create(memory::Allocator &allocator, uint32_t frameCount);
+  void destroy();
+
+  // after the frame slot's fence wait, clears last frame's declarations
+  void beginFrame(uint32_t frameIndex);
+
+  // names have to outlive the frame and the profiler results, string
+  // literals are the intent
+  //
+  // external images such as the swapchain image acquired for the frame.
+  // `initial` is the state the image is in when the graph starts, it is
+  // left in `final` once the frame has executed
+  GraphImage importImage(const char *name, VkImage image,
+                         VkImageView view, VkFormat format,
+                         VkExtent2D extent, const ResourceState &initial,
+                         const ResourceState &final);
+  GraphBuffer importBuffer(const char *name, VkBuffer buffer,
+                           const ResourceState &initial,
+                           const ResourceState &final);
+  GraphImage createImage(const char *name, const TransientImageDesc &desc);
+
+  GraphPass &addPass(const char *name);
+
+  void compile();
+  // profiles every pass under its name when a profiler is given
+  void execute(VkCommandBuffer commandBuffer,
+               profiling::GpuProfiler *profiler = nullptr);
+
+  // for pass functions
+  VkImage image(GraphImage image) const;
+  VkImageView view(GraphImage image) const;
+  VkFormat format(GraphImage image) const;
+  VkExtent2D extent(GraphImage image) const;
+  VkBuffer buffer(GraphBuffer buffer) const;
+
+  // transient memory of the frame slot last compiled, with and without
+  // aliasing
+  void print(std::ostream &out) const;
+
+private:
+  struct ImageResource {
+    const char *name = nullptr;
+    VkImage image = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent2D extent{};
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    bool transient = false;
+    VkImageUsageFlags usage = 0;
+
+    ResourceState initial;
+    ResourceState final;
+    // first and last surviving pass to touch a transient
+    uint32_t firstPass = UINT32_MAX;
+    uint32_t lastPass = 0;
+    // memory block a transient is placed in
+    uint32_t block = UINT32_MAX;
+  };
+
+  struct BufferResource {
+    const char *name = nullptr;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    ResourceState initial;
+    ResourceState final;
+  };
+
+  // everything a pass does with one resource, merged
+  struct Use {
+    bool image;
+    uint32_t index;
+    ResourceState state;
+    bool write;
+  };
+
+  // synchronization state of a resource while barriers are worked out
+  struct Tracker {
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    // the last write or layout transition
+    VkPipelineStageFlags2 writeStages = VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2 writeAccess = VK_ACCESS_2_NONE;
+    // reads since then, the next write has to wait for them
+    VkPipelineStageFlags2 readStages = VK_PIPELINE_STAGE_2_NONE;
+    // what the last write has already been made visible to
+    VkPipelineStageFlags2 visibleStages = VK_PIPELINE_STAGE_2_NONE;
+    VkAccessFlags2 visibleAccess = VK_ACCESS_2_NONE;
+  };
+
+  struct Barriers {
+    std::vector<VkImageMemoryBarrier2> images;
+    std::vector<VkBufferMemoryBarrier2> buffers;
+  };
+
+  // physical transients of one frame in flight, indexed like _images
+  struct FrameResources {
+    uint64_t signature = 0;
+    bool built = false;
+    std::vector<memory::Allocation> blocks;
+    std::vector<VkImage> images;
+    std::vector<VkImageView> views;
+    std::vector<uint32_t> imageBlocks;
+    // what the transients take, and would take without aliasing
+    VkDeviceSize aliasedBytes = 0;
+    VkDeviceSize unaliasedBytes = 0;
+  };
+
+  void cullPasses();
+  void collectUses();
+  uint64_t transientSignature() const;
+  void allocateTransients();
+  void releaseFrame(FrameResources &frame);
+  void buildBarriers();
+  bool transition(Tracker &tracker, const ResourceState &state, bool write,
+                  VkPipelineStageFlags2 &srcStages,
+                  VkAccessFlags2 &srcAccess) const;
+  void addImageBarrier(Barriers &barriers, const ImageResource &image,
+                       VkImageLayout oldLayout, const ResourceState &state,
+                       VkPipelineStageFlags2 srcStages,
+                       VkAccessFlags2 srcAccess) const;
+  void addBufferBarrier(Barriers &barriers, const BufferResource &buffer,
+                        const ResourceState &state,
+                        VkPipelineStageFlags2 srcStages,
+                        VkAccessFlags2 srcAccess) const;
+  void recordBarriers(VkCommandBuffer commandBuffer,
+                      const Barriers &barriers) const;
+  void beginRendering(VkCommandBuffer commandBuffer, const GraphPass &pass,
+                      uint32_t position);
+  void resetPasses();
+
+  memory::Allocator *_allocator = nullptr;
+  VkDevice _device = VK_NULL_HANDLE;
+
+  std::vector<FrameResources> _frames;
+  FrameResources *_frame = nullptr;
+
+  std::vector<ImageResource> _images;
+  std::vector<BufferResource> _buffers;
+  // only grows, the first _passCount are this frame's. A deque so the
+  // references addPass() hands out stay valid
+  std::deque<GraphPass> _passes;
+  size_t _passCount = 0;
+  // pass functions of the frame being declared
+  memory::LinearArena _functionArena;
+
+  // filled in by compile(), indexed by position in _order
+  std::vector<uint32_t> _order;
+  std::vector<std::vector<Use>> _uses;
+  std::vector<Barriers> _passBarriers;
+  Barriers _finalBarriers;
+  bool _compiled = false;
+
+  // scratch of compile() and execute(), kept so their capacity is reused
+  std::vector<bool> _neededImages;
+  std::vector<bool> _neededBuffers;
+  std::vector<Tracker> _imageTrackers;
+  std::vector<Tracker> _bufferTrackers;
+  std::vector<uint32_t> _blockOwners;
+  std::vector<VkRenderingAttachmentInfo> _colorAttachmentInfos;
+};
+
+} // namespace rendering
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "jobs/jobSystem.hpp"
+#include "types.hpp"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace rendering {
+
+struct ShaderSource {
+  // relative to the shader directory
+  std::string path;
+  VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+  std::vector<std::pair<std::string, std::string>> defines;
+  std::string entryPoint = "main";
+};
+
+struct ShaderBinary {
+  std::vector<uint32_t> spirv;
+  // content hash of everything that affects the SPIR-V, names the cache file
+  uint64_t key = 0;
+  bool fromCache = false;
+};
+
+// compiles GLSL to SPIR-V with shaderc behind a content addressed on-disk
+// cache, so a warm start only reads the binaries back
+class ShaderCompiler {
+public:
+  // without a job system everything is compiled on the calling thread
+  ShaderCompiler(std::string shaderDir, std::string cacheDir,
+                 bool optimize = true, jobs::JobSystem *jobs = nullptr);
+
+  ShaderBinary compile(const ShaderSource &source);
+
+  // cache hits are read on the calling thread, misses are compiled in
+  // parallel as jobs. Results are in the order of `sources`
+  std::vector<ShaderBinary>
+  compileAll(const std::vector<ShaderSource> &sources);
+
+  VkShaderModule createModule(VkDevice device, const ShaderBinary &binary);
+
+  // the key compile() would give `source` right now, reads the source and
+  // its includes but compiles nothing
+  uint64_t key(const ShaderSource &source);
+
+  const std::string &shaderDir() const { return _shaderDir; }
+
+private:
+  // hashes the source, every file it includes (recursively), the defines
+  // and the compiler options
+  uint64_t computeKey(const ShaderSource &source, std::string &text);
+  void hashIncludes(const std::string &path, const std::string &text,
+                    uint64_t &hash, std::vector<std::string> &visited);
+
+  std::string cachePath(uint64_t key);
+  bool loadCached(uint64_t key, std::vector<uint32_t> &spirv);
+  void storeCached(uint64_t key, const std::vector<uint32_t> &spirv);
+
+  std::vector<uint32_t> compileGlsl(const ShaderSource &source,
+                                    const std::string &text);
+
+  std::string _shaderDir;
+  std::string _cacheDir;
+  bool _optimize;
+  jobs::JobSystem *_jobs;
+};
+
+} // namespace rendering
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+
+namespace rendering {
+
+// notices edits to anything under the shader directory, including files
+// only reached through #include. Uses inotify on Linux and never reports
+// a change elsewhere
+class ShaderWatcher {
+public:
+  ShaderWatcher() = default;
+  ~ShaderWatcher();
+  ShaderWatcher(const ShaderWatcher &) = delete;
+  ShaderWatcher &operator=(const ShaderWatcher &) = delete;
+
+  void create(const std::string &shaderDir);
+  void destroy();
+
+  // never blocks. True once something changed and the directory has been
+  // quiet for a moment since, editors tend to save in several steps
+  bool poll();
+  bool active() const { return _fd >= 0; }
+
+private:
+  void watchDirectory(const std::string &path);
+
+  int _fd = -1;
+  // watch descriptor to directory, new subdirectories get watched too
+  std::unordered_map<int, std::string> _directories;
+  bool _changed = false;
+  std::chrono::steady_clock::time_point _lastChange;
+};
+
+} // namespace rendering
@@ -23,16 +23,21 @@ public:
   ~Swapchain();
 
   void querySwapchainSupportDetails(VkPhysicalDevice &device);
+  // pass the swapchain being replaced when recreating, it is retired but
+  // stays alive until the caller destroys it
   void create(VkDevice &device, GLFWwindow *window,
-              engine::QueueFamilyIndices indices);
+              engine::QueueFamilyIndices indices,
+              VkSwapchainKHR oldSwapchain = VK_NULL_HANDLE);
 
   VkSurfaceFormatKHR chooseSwapSurfaceFormat(VkFormat format,
                                              VkColorSpaceKHR colorSpace);
   VkPresentModeKHR chooseSwapPresentMode(VkPresentModeKHR presentMode);
   VkExtent2D chooseSwapExtent(GLFWwindow *window);
 
+  VkSwapchainKHR handle() const { return _swapchain; }
+
 private:
-  VkSwapchainKHR _swapchain;
+  VkSwapchainKHR _swapchain = VK_NULL_HANDLE;
   std::vector<VkImage> _swapchainImages;
   SwapchainSupportDetails _details;
   VkSurfaceKHR _surface;
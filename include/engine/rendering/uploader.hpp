@@ -0,0 +1,116 @@
+#pragma once
+
+#include "memory/allocator.hpp"
+#include "types.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace rendering {
+
+struct UploadQueueInfo {
+  VkQueue queue = VK_NULL_HANDLE;
+  uint32_t family = 0;
+  // held around vkQueueSubmit when the queue is shared with the renderer
+  std::mutex *submitMutex = nullptr;
+};
+
+// streams buffer and image data to the GPU through one persistently
+// mapped staging ring. Copies are batched into a single command buffer
+// until flush(), which submits them on the transfer queue and signals a
+// timeline semaphore. When the transfer queue is a different family the
+// resources are released there and acquired again on the graphics queue
+// by recordAcquires()
+class Uploader {
+public:
+  Uploader() = default;
+  ~Uploader();
+
+  void create(memory::Allocator &allocator, VkPhysicalDevice physicalDevice,
+              const UploadQueueInfo &transfer, uint32_t graphicsFamily,
+              VkDeviceSize stagingSize);
+  void destroy();
+
+  // every upload returns a ticket, the data is usable by graphics work
+  // once isReady(ticket). Buffers larger than the ring are split up,
+  // images are staged a few regions at a time and only each region has
+  // to fit. Blocks only when the ring is full
+  uint64_t uploadBuffer(VkBuffer buffer, VkDeviceSize offset,
+                        const void *data, VkDeviceSize size);
+  // region offsets are relative to `data`, each region's bytes run up to
+  // the next one's. The image ends up in SHADER_READ_ONLY_OPTIMAL
+  uint64_t uploadImage(VkImage image, const VkImageSubresourceRange &range,
+                       const std::vector<VkBufferImageCopy> &regions,
+                       const void *data, VkDeviceSize size);
+  // single mip level, single layer color image
+  uint64_t uploadImage(VkImage image, VkExtent3D extent, const void *data,
+                       VkDeviceSize size);
+
+  // submits everything queued since the last flush
+  void flush();
+  // blocks until the transfer queue finished every submitted batch, what
+  // is still recording is never submitted
+  void waitIdle();
+
+  // called on the graphics command buffer before anything uses uploaded
+  // data. Acquires every finished batch and returns the timeline value
+  // the graphics submission must wait on, 0 when there is nothing new
+  uint64_t recordAcquires(VkCommandBuffer commandBuffer);
+
+  bool isReady(uint64_t ticket) const { return ticket <= _acquiredValue; }
+  // covers everything queued so far, including the copies an upload that
+  // threw part way through had already recorded
+  uint64_t currentTicket();
+  VkSemaphore timeline() const { return _timeline; }
+
+private:
+  struct Batch {
+    VkCommandPool pool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    uint64_t value = 0;
+    // staging ring position once this batch's data is no longer needed
+    uint64_t ringEnd = 0;
+    std::vector<VkBufferMemoryBarrier> bufferAcquires;
+    std::vector<VkImageMemoryBarrier> imageAcquires;
+  };
+
+  // reserves `size` bytes of staging memory, may flush and wait for older
+  // batches. Returns the offset into the ring buffer
+  VkDeviceSize allocateStaging(std::unique_lock<std::mutex> &lock,
+                               VkDeviceSize size);
+  Batch &recordingBatch();
+  void flushLocked();
+  // returns the timeline value the transfer queue has reached
+  uint64_t retireFinished();
+  bool ownershipTransfer() const { return _transferFamily != _graphicsFamily; }
+
+  memory::Allocator *_allocator = nullptr;
+  VkDevice _device = VK_NULL_HANDLE;
+  VkQueue _queue = VK_NULL_HANDLE;
+  std::mutex *_submitMutex = nullptr;
+  uint32_t _transferFamily = 0;
+  uint32_t _graphicsFamily = 0;
+
+  memory::Buffer _staging;
+  VkDeviceSize _stagingSize = 0;
+  VkDeviceSize _alignment = 16;
+  // absolute byte positions, the ring offset is position % _stagingSize
+  uint64_t _head = 0;
+  uint64_t _tail = 0;
+
+  VkSemaphore _timeline = VK_NULL_HANDLE;
+  uint64_t _nextValue = 1;
+  // read by streaming threads through isReady()
+  std::atomic<uint64_t> _acquiredValue{0};
+
+  std::mutex _mutex;
+  std::unique_ptr<Batch> _recording;
+  std::deque<std::unique_ptr<Batch>> _inFlight;
+  std::vector<std::unique_ptr<Batch>> _freeBatches;
+};
+
+} // namespace rendering
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "ecs/entity.hpp"
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+
+namespace scene {
+
+struct Transform {
+  glm::vec3 position{0.0f};
+  glm::quat rotation{1.0f, 0.0f, 0.0f, 0.0f};
+  glm::vec3 scale{1.0f};
+};
+
+// Transform is relative to the parent's LocalToWorld
+struct Parent {
+  ecs::Entity entity;
+};
+
+// rebuilt from Transform (and the parent chain) every frame, what the
+// renderer reads
+struct LocalToWorld {
+  glm::mat4 matrix{1.0f};
+};
+
+// bounding sphere in local space, center xyz and radius w
+struct Bounds {
+  glm::vec4 sphere{0.0f, 0.0f, 0.0f, 1.0f};
+};
+
+// Bounds moved by LocalToWorld, laid out so a chunk's column feeds
+// cullSpheres() directly
+struct WorldBounds {
+  glm::vec4 sphere{0.0f};
+};
+
+// constant rotation, radians per second around `axis`
+struct Spin {
+  glm::vec3 axis{0.0f, 0.0f, 1.0f};
+  float speed = 0.0f;
+};
+
+struct Renderable {
+  // only the built-in triangle (0) exists so far
+  uint32_t mesh = 0;
+};
+
+} // namespace scene
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+namespace scene {
+
+// inward facing planes, xyz normalized so the distance is in world units
+struct Frustum {
+  glm::vec4 planes[6];
+};
+
+// clip space is Vulkan's, z from 0 to 1
+Frustum extractFrustum(const glm::mat4 &viewProjection);
+
+// spheres are center xyz and radius w. Writes the index of every sphere
+// touching the frustum to `visible`, which must have room for `count`
+// entries, and returns how many were written. Tests 8 spheres at a time
+// with AVX, 4 with SSE, and falls back to scalar code elsewhere
+uint32_t cullSpheres(const Frustum &frustum, const glm::vec4 *spheres,
+                     uint32_t count, uint32_t *visible);
+
+} // namespace scene
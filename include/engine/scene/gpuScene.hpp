@@ -0,0 +1,142 @@
+#pragma once
+
+#include "jobs/jobSystem.hpp"
+#include "memory/allocator.hpp"
+#include "rendering/bindlessHeap.hpp"
+#include "rendering/renderGraph.hpp"
+#include "rendering/uploader.hpp"
+#include "scene/culling.hpp"
+#include "scene/simulation.hpp"
+#include "types.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace scene {
+
+constexpr uint32_t maxMeshLods = 4;
+
+// one level of detail, a range of the shared index buffer. Levels are
+// ordered finest first, a level is used while the instance's projected
+// radius is at least minSize
+struct MeshLod {
+  uint32_t firstIndex = 0;
+  uint32_t indexCount = 0;
+  int32_t vertexOffset = 0;
+  float minSize = 0.0f;
+};
+
+// the layouts below must match shaders/gpuScene.glsl
+struct GpuMesh {
+  uint32_t lodCount = 0;
+  uint32_t pad[3] = {};
+  MeshLod lods[maxMeshLods];
+};
+
+struct GpuInstance {
+  glm::mat4 localToWorld;
+  glm::vec4 sphere;
+  uint32_t mesh;
+  uint32_t pad[3];
+};
+
+// push constants of shaders/cull.comp, handles index the bindless heap
+struct CullConstants {
+  glm::vec4 planes[6];
+  uint32_t instances;
+  uint32_t meshes;
+  uint32_t commands;
+  uint32_t count;
+  uint32_t instanceCount;
+  uint32_t maxDraws;
+  float lodScale;
+};
+
+// this frame's buffers as declared to the render graph
+struct GpuSceneBuffers {
+  rendering::GraphBuffer instances;
+  rendering::GraphBuffer commands;
+  rendering::GraphBuffer count;
+};
+
+// the renderable part of the world mirrored in storage buffers, culled
+// and turned into draws by a compute pass so the CPU records one
+// vkCmdDrawIndexedIndirectCount no matter how many instances there are.
+//
+// Every buffer is reached through the bindless heap, the shaders only get
+// handles. Instances and draws are per frame slot, meshes are shared and
+// only ever appended
+class GpuScene {
+public:
+  GpuScene() = default;
+  ~GpuScene();
+  GpuScene(const GpuScene &) = delete;
+  GpuScene &operator=(const GpuScene &) = delete;
+
+  void create(memory::Allocator &allocator, rendering::Uploader &uploader,
+              rendering::BindlessHeap &bindless, uint32_t framesInFlight,
+              uint32_t maxInstances, uint32_t maxIndices = 1 << 20,
+              uint32_t maxMeshes = 1024);
+  void destroy();
+
+  // the indices go out through the uploader, the returned id is what
+  // Renderable::mesh refers to. At least one and at most maxMeshLods lods
+  uint32_t addMesh(const std::vector<uint32_t> &indices,
+                   const std::vector<MeshLod> &lods);
+
+  // copies every renderable into this frame slot's instance buffer, after
+  // the slot's fence wait
+  void update(uint32_t frameIndex, const RenderInstances &instances,
+              jobs::JobSystem &jobs);
+
+  // adds the passes that reset and fill this frame's draws. `lodScale`
+  // turns a world space radius into the size lods are picked by
+  GpuSceneBuffers addCulling(rendering::RenderGraph &graph,
+                             const Frustum &frustum, VkPipeline pipeline,
+                             VkPipelineLayout layout, float lodScale = 1.0f);
+
+  // inside a pass that reads the buffers addCulling() returned, with the
+  // pipeline bound. Pushes the instance buffer's handle to the vertex stage
+  void draw(VkCommandBuffer commandBuffer, VkPipelineLayout layout) const;
+
+  bool enabled() const { return _allocator != nullptr; }
+  // false until every mesh added so far has reached the graphics queue,
+  // nothing is drawn before that
+  bool ready() const { return _uploader->isReady(_indicesTicket); }
+  uint32_t instanceCount() const { return _instanceCount; }
+
+private:
+  struct Frame {
+    memory::Buffer instances;
+    // VkDrawIndexedIndirectCommand per visible instance
+    memory::Buffer commands;
+    memory::Buffer count;
+    uint32_t instancesHandle = rendering::BindlessHeap::invalidHandle;
+    uint32_t commandsHandle = rendering::BindlessHeap::invalidHandle;
+    uint32_t countHandle = rendering::BindlessHeap::invalidHandle;
+  };
+
+  memory::Allocator *_allocator = nullptr;
+  rendering::Uploader *_uploader = nullptr;
+  rendering::BindlessHeap *_bindless = nullptr;
+
+  uint32_t _maxInstances = 0;
+  uint32_t _maxIndices = 0;
+  uint32_t _maxMeshes = 0;
+
+  memory::Buffer _indices;
+  uint32_t _indexCount = 0;
+  uint64_t _indicesTicket = 0;
+  // host visible, meshes are written in place
+  memory::Buffer _meshes;
+  uint32_t _meshesHandle = rendering::BindlessHeap::invalidHandle;
+  uint32_t _meshCount = 0;
+
+  std::vector<Frame> _frames;
+  uint32_t _frameIndex = 0;
+  uint32_t _instanceCount = 0;
+};
+
+} // namespace scene
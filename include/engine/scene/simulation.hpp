@@ -0,0 +1,100 @@
+#pragma once
+
+#include "ecs/world.hpp"
+#include "jobs/jobSystem.hpp"
+
+#include <glm/glm.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace scene {
+
+// everything the renderer needs of the renderables, one entry each
+struct RenderInstances {
+  std::vector<glm::mat4> localToWorld;
+  // world space, center xyz and radius w, feeds cullSpheres() directly
+  std::vector<glm::vec4> spheres;
+  std::vector<uint32_t> meshes;
+
+  uint32_t size() const { return static_cast<uint32_t>(meshes.size()); }
+  void resize(uint32_t count);
+};
+
+// the renderables as one tick left them
+struct RenderSnapshot {
+  uint64_t tick = 0;
+  // when the tick's state is meant to be on screen
+  std::chrono::steady_clock::time_point time;
+  // matches instances entry by entry, pairs up the two snapshots
+  // interpolated between
+  std::vector<ecs::Entity> entities;
+  RenderInstances instances;
+};
+
+// runs the world at a fixed tick rate on its own thread. After every tick
+// the renderables are copied into a snapshot, the renderer blends the two
+// latest ones for the current time and never touches the world itself.
+//
+// Rendering shows the state one tick in the past, so there are always two
+// snapshots around it. A slow frame never holds a tick back and a slow
+// tick only stretches one interpolation
+class Simulation {
+public:
+  using TickFunction = std::function<void(float deltaTime)>;
+
+  Simulation() = default;
+  ~Simulation();
+  Simulation(const Simulation &) = delete;
+  Simulation &operator=(const Simulation &) = delete;
+
+  // `world` belongs to the simulation thread until stop()
+  void start(ecs::World &world, jobs::JobSystem &jobs, float tickRate,
+             TickFunction tick);
+  void stop();
+
+  // render thread, fills `out` with the world as it was one tick ago.
+  // Empty until the first tick has been published
+  void interpolate(jobs::JobSystem &jobs, RenderInstances &out);
+
+  uint64_t tickCount() const { return _tickCount.load(); }
+  // ticks dropped because the simulation fell too far behind
+  uint64_t droppedTicks() const { return _droppedTicks.load(); }
+
+private:
+  // two pinned by the renderer, two published and one being written
+  static constexpr uint32_t snapshotCount = 5;
+  static constexpr uint32_t none = UINT32_MAX;
+
+  void run();
+  void capture(RenderSnapshot &snapshot);
+
+  ecs::World *_world = nullptr;
+  jobs::JobSystem *_jobs = nullptr;
+  TickFunction _tick;
+  std::chrono::steady_clock::duration _interval{0};
+  float _deltaTime = 0.0f;
+  // capture() scratch, kept so a steady tick does not allocate
+  std::vector<ecs::ChunkView> _captureChunks;
+  std::vector<uint32_t> _captureOffsets;
+
+  std::thread _thread;
+  std::atomic<bool> _stopping{false};
+  std::atomic<uint64_t> _tickCount{0};
+  std::atomic<uint64_t> _droppedTicks{0};
+
+  // guards the indices below, never held while copying
+  std::mutex _mutex;
+  RenderSnapshot _snapshots[snapshotCount];
+  uint32_t _latest = none;
+  uint32_t _previous = none;
+  uint32_t _readLatest = none;
+  uint32_t _readPrevious = none;
+};
+
+} // namespace scene
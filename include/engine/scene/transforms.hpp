@@ -0,0 +1,64 @@
+#pragma once
+
+#include "ecs/world.hpp"
+#include "jobs/jobSystem.hpp"
+#include "scene/components.hpp"
+
+#include <vector>
+
+namespace scene {
+
+glm::mat4 composeTransform(const Transform &transform);
+
+void updateSpin(ecs::World &world, jobs::JobSystem &jobs, float deltaTime);
+
+// Bounds -> WorldBounds, run after the hierarchy
+void updateWorldBounds(ecs::World &world, jobs::JobSystem &jobs);
+
+// computes LocalToWorld for every entity with a Transform. Roots are
+// streamed chunk by chunk, children are sorted into levels by depth so
+// every level only reads matrices the previous one finished. A level is
+// gathered into flat arrays a chunk at a time, its matrices computed in
+// a linear pass and written back to the same chunks
+class TransformHierarchy {
+public:
+  void update(ecs::World &world, jobs::JobSystem &jobs);
+
+  uint32_t depth() const { return static_cast<uint32_t>(_levels.size()); }
+
+private:
+  // no parent, the local transform is the world transform
+  static constexpr uint32_t noParent = UINT32_MAX;
+
+  // the entries [begin, end) of a level that live in one chunk
+  struct ChunkRun {
+    ecs::ChunkView view;
+    uint32_t begin;
+    uint32_t end;
+  };
+
+  // ordered by chunk and row, fixed until the structure changes
+  struct Level {
+    std::vector<uint32_t> rows;
+    // into the previous level's world matrices, the roots' for the first
+    std::vector<uint32_t> parents;
+    std::vector<ChunkRun> runs;
+
+    // refilled every update
+    std::vector<glm::vec3> positions;
+    std::vector<glm::quat> rotations;
+    std::vector<glm::vec3> scales;
+    std::vector<glm::mat4> world;
+  };
+
+  // only when the world's structure changed since the last frame
+  void rebuild(ecs::World &world);
+
+  uint64_t _builtVersion = UINT64_MAX;
+  // roots with children, only their world matrices are used
+  Level _roots;
+  // _levels[0] holds the children of roots, _levels[1] their children...
+  std::vector<Level> _levels;
+};
+
+} // namespace scene
@@ -0,0 +1,24 @@
+// the global set of rendering::BindlessHeap, indexed by the handles it
+// hands out. Handles that differ within a draw or workgroup have to be
+// wrapped in nonuniformEXT()
+#extension GL_EXT_nonuniform_qualifier : require
+
+#ifndef BINDLESS_SET
+#define BINDLESS_SET 0
+#endif
+
+layout(set = BINDLESS_SET, binding = 0) uniform texture2D bindlessImages[];
+
+layout(set = BINDLESS_SET, binding = 1) readonly buffer BindlessBuffer {
+  uint words[];
+}
+bindlessBuffers[];
+
+layout(set = BINDLESS_SET, binding = 2) uniform sampler bindlessSamplers[];
+
+// sampler 0 is always linear repeat
+vec4 sampleBindless(uint imageHandle, uint samplerHandle, vec2 uv) {
+  return texture(sampler2D(bindlessImages[nonuniformEXT(imageHandle)],
+                           bindlessSamplers[nonuniformEXT(samplerHandle)]),
+                 uv);
+}
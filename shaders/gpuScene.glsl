@@ -0,0 +1,55 @@
+// the buffers of scene::GpuScene as seen through the bindless heap, the
+// layouts must match gpuScene.hpp. Include after bindless.glsl
+
+struct Instance {
+  mat4 localToWorld;
+  vec4 sphere;
+  uint mesh;
+  uint pad0;
+  uint pad1;
+  uint pad2;
+};
+
+struct MeshLod {
+  uint firstIndex;
+  uint indexCount;
+  int vertexOffset;
+  float minSize;
+};
+
+struct Mesh {
+  uint lodCount;
+  uint pad0;
+  uint pad1;
+  uint pad2;
+  MeshLod lods[4];
+};
+
+// VkDrawIndexedIndirectCommand
+struct DrawCommand {
+  uint indexCount;
+  uint instanceCount;
+  uint firstIndex;
+  int vertexOffset;
+  uint firstInstance;
+};
+
+layout(set = BINDLESS_SET, binding = 1) readonly buffer InstanceBuffer {
+  Instance instances[];
+}
+instanceBuffers[];
+
+layout(set = BINDLESS_SET, binding = 1) readonly buffer MeshBuffer {
+  Mesh meshes[];
+}
+meshBuffers[];
+
+layout(set = BINDLESS_SET, binding = 1) writeonly buffer DrawCommandBuffer {
+  DrawCommand commands[];
+}
+drawCommandBuffers[];
+
+layout(set = BINDLESS_SET, binding = 1) buffer DrawCountBuffer {
+  uint drawCount;
+}
+drawCountBuffers[];
@@ -0,0 +1,24 @@
+#version 450
+#extension GL_GOOGLE_include_directive : require
+
+#include "bindless.glsl"
+#include "gpuScene.glsl"
+
+// drawn by vkCmdDrawIndexedIndirectCount, gl_InstanceIndex is the
+// instance the cull pass emitted the draw for
+layout(push_constant) uniform Draw { uint instances; }
+draw;
+
+layout(location = 0) out vec3 fragColor;
+
+vec2 positions[3] = vec2[](vec2(0.0, -0.5), vec2(0.5, 0.5), vec2(-0.5, 0.5));
+
+vec3 colors[3] =
+    vec3[](vec3(1.0, 0.0, 0.0), vec3(0.0, 1.0, 0.0), vec3(0.0, 0.0, 1.0));
+
+void main() {
+  mat4 localToWorld =
+      instanceBuffers[draw.instances].instances[gl_InstanceIndex].localToWorld;
+  gl_Position = localToWorld * vec4(positions[gl_VertexIndex], 0.0, 1.0);
+  fragColor = colors[gl_VertexIndex];
+}
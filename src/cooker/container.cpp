@@ -0,0 +1,86 @@
+#include "cooker/cooker.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+
+namespace cooker {
+
+namespace {
+
+void pad(std::ofstream &file, uint64_t alignment) {
+  static const char zeros[assets::blobAlignment] = {};
+  uint64_t position = static_cast<uint64_t>(file.tellp());
+  uint64_t padding = (alignment - position % alignment) % alignment;
+  file.write(zeros, static_cast<std::streamsize>(padding));
+}
+
+} // namespace
+
+void writeContainer(const std::filesystem::path &path,
+                    const std::vector<CookedAsset> &cooked) {
+  std::vector<assets::TocEntry> entries(cooked.size());
+  std::set<std::string> names;
+  for (size_t i = 0; i < cooked.size(); i++) {
+    const CookedAsset &asset = cooked[i];
+    if (asset.name.size() >= assets::maxNameLength) {
+      throw std::runtime_error("asset name " + asset.name + " is too long!");
+    }
+    if (!names.insert(asset.name).second) {
+      throw std::runtime_error("asset " + asset.name + " is cooked twice!");
+    }
+
+    assets::TocEntry &entry = entries[i];
+    std::memset(&entry, 0, sizeof(entry));
+    std::memcpy(entry.name, asset.name.c_str(), asset.name.size());
+    entry.type = asset.type;
+    entry.size = asset.blob.size();
+    if (asset.type == assets::AssetType::Mesh) {
+      entry.mesh = asset.mesh;
+    } else {
+      entry.texture = asset.texture;
+    }
+  }
+
+  // written next to the target and renamed over it, a crash never leaves
+  // a half written container behind for the engine to map
+  std::filesystem::path temporary = path;
+  temporary += ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      throw std::runtime_error("failed to open " + temporary.string() + "!");
+    }
+
+    assets::FileHeader header{};
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    for (size_t i = 0; i < cooked.size(); i++) {
+      pad(file, assets::blobAlignment);
+      entries[i].offset = static_cast<uint64_t>(file.tellp());
+      file.write(reinterpret_cast<const char *>(cooked[i].blob.data()),
+                 static_cast<std::streamsize>(cooked[i].blob.size()));
+    }
+
+    pad(file, alignof(assets::TocEntry));
+    header.magic = assets::fileMagic;
+    header.version = assets::fileVersion;
+    header.entryCount = static_cast<uint32_t>(entries.size());
+    header.tocOffset = static_cast<uint64_t>(file.tellp());
+    file.write(reinterpret_cast<const char *>(entries.data()),
+               static_cast<std::streamsize>(entries.size() *
+                                            sizeof(assets::TocEntry)));
+    header.fileSize = static_cast<uint64_t>(file.tellp());
+
+    file.seekp(0);
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    if (!file) {
+      throw std::runtime_error("failed to write " + temporary.string() + "!");
+    }
+  }
+
+  std::filesystem::rename(temporary, path);
+}
+
+} // namespace cooker
@@ -0,0 +1,66 @@
+#include "cooker/cooker.hpp"
+
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+void printUsage() {
+  std::cerr << "usage: cooker -o <output> [--linear | --srgb] <inputs>...\n"
+            << "  .obj meshes, .ppm and .pgm textures. Textures are sRGB\n"
+            << "  unless --linear comes before them" << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  std::filesystem::path output;
+  std::vector<std::pair<std::filesystem::path, bool>> inputs;
+
+  bool srgb = true;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+      output = argv[++i];
+    } else if (strcmp(argv[i], "--linear") == 0) {
+      srgb = false;
+    } else if (strcmp(argv[i], "--srgb") == 0) {
+      srgb = true;
+    } else if (argv[i][0] == '-') {
+      printUsage();
+      return -1;
+    } else {
+      inputs.emplace_back(argv[i], srgb);
+    }
+  }
+
+  if (output.empty() || inputs.empty()) {
+    printUsage();
+    return -1;
+  }
+
+  try {
+    std::vector<cooker::CookedAsset> cooked;
+    for (const auto &[path, isSrgb] : inputs) {
+      std::string extension = path.extension().string();
+      if (extension == ".obj") {
+        cooked.push_back(cooker::cookMesh(path));
+      } else if (extension == ".ppm" || extension == ".pgm") {
+        cooked.push_back(cooker::cookTexture(path, isSrgb));
+      } else {
+        throw std::runtime_error("no cooker for " + path.string() + "!");
+      }
+
+      const cooker::CookedAsset &asset = cooked.back();
+      std::cout << "cooked " << asset.name << " (" << asset.blob.size()
+                << " bytes)" << std::endl;
+    }
+
+    cooker::writeContainer(output, cooked);
+    std::cout << "wrote " << cooked.size() << " assets to " << output.string()
+              << std::endl;
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,191 @@
+#include "cooker/cooker.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace cooker {
+
+namespace {
+
+struct Corner {
+  int position = -1;
+  int uv = -1;
+  int normal = -1;
+
+  bool operator==(const Corner &other) const {
+    return position == other.position && uv == other.uv &&
+           normal == other.normal;
+  }
+};
+
+struct CornerHash {
+  size_t operator()(const Corner &corner) const {
+    size_t hash = std::hash<int>()(corner.position);
+    hash = hash * 31 + std::hash<int>()(corner.uv);
+    return hash * 31 + std::hash<int>()(corner.normal);
+  }
+};
+
+// OBJ indices start at 1, negative ones count back from the last element
+int resolveIndex(const std::string &token, size_t count) {
+  if (token.empty()) {
+    return -1;
+  }
+  int index = std::stoi(token);
+  int resolved = index < 0 ? static_cast<int>(count) + index : index - 1;
+  if (index == 0 || resolved < 0 || resolved >= static_cast<int>(count)) {
+    throw std::runtime_error("obj index " + token + " is out of range!");
+  }
+  return resolved;
+}
+
+} // namespace
+
+CookedAsset cookMesh(const std::filesystem::path &path) {
+  std::ifstream file(path);
+  if (!file) {
+    throw std::runtime_error("failed to open " + path.string() + "!");
+  }
+
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec2> uvs;
+  std::vector<glm::vec3> normals;
+
+  std::vector<Corner> corners;
+  std::vector<uint32_t> indices;
+  std::unordered_map<Corner, uint32_t, CornerHash> cornerLookup;
+
+  std::string line;
+  std::vector<uint32_t> face;
+  while (std::getline(file, line)) {
+    std::istringstream stream(line);
+    std::string keyword;
+    stream >> keyword;
+
+    if (keyword == "v") {
+      glm::vec3 position;
+      stream >> position.x >> position.y >> position.z;
+      positions.push_back(position);
+    } else if (keyword == "vt") {
+      glm::vec2 uv;
+      stream >> uv.x >> uv.y;
+      // OBJ puts v = 0 at the bottom, Vulkan samples from the top
+      uv.y = 1.0f - uv.y;
+      uvs.push_back(uv);
+    } else if (keyword == "vn") {
+      glm::vec3 normal;
+      stream >> normal.x >> normal.y >> normal.z;
+      normals.push_back(normal);
+    } else if (keyword == "f") {
+      face.clear();
+      std::string token;
+      while (stream >> token) {
+        // v, v/vt, v//vn or v/vt/vn
+        std::string parts[3];
+        size_t part = 0;
+        for (char c : token) {
+          if (c == '/') {
+            part = std::min<size_t>(part + 1, 2);
+          } else {
+            parts[part] += c;
+          }
+        }
+
+        Corner corner;
+        corner.position = resolveIndex(parts[0], positions.size());
+        corner.uv = resolveIndex(parts[1], uvs.size());
+        corner.normal = resolveIndex(parts[2], normals.size());
+        if (corner.position < 0) {
+          throw std::runtime_error("obj face without a position in " +
+                                   path.string() + "!");
+        }
+
+        auto [it, inserted] = cornerLookup.emplace(
+            corner, static_cast<uint32_t>(corners.size()));
+        if (inserted) {
+          corners.push_back(corner);
+        }
+        face.push_back(it->second);
+      }
+
+      for (size_t i = 2; i < face.size(); i++) {
+        indices.push_back(face[0]);
+        indices.push_back(face[i - 1]);
+        indices.push_back(face[i]);
+      }
+    }
+  }
+
+  if (indices.empty()) {
+    throw std::runtime_error(path.string() + " has no faces!");
+  }
+
+  // area weighted face normals summed per position, so corners that only
+  // differ in their uv still shade the same
+  std::vector<glm::vec3> generatedNormals(positions.size(), glm::vec3(0.0f));
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    int a = corners[indices[i]].position;
+    int b = corners[indices[i + 1]].position;
+    int c = corners[indices[i + 2]].position;
+    glm::vec3 normal = glm::cross(positions[b] - positions[a],
+                                  positions[c] - positions[a]);
+    generatedNormals[a] += normal;
+    generatedNormals[b] += normal;
+    generatedNormals[c] += normal;
+  }
+
+  std::vector<assets::Vertex> vertices(corners.size());
+  glm::vec3 minimum(std::numeric_limits<float>::max());
+  glm::vec3 maximum(std::numeric_limits<float>::lowest());
+  for (size_t i = 0; i < corners.size(); i++) {
+    const Corner &corner = corners[i];
+    glm::vec3 position = positions[corner.position];
+    glm::vec3 normal = corner.normal >= 0 ? normals[corner.normal]
+                                          : generatedNormals[corner.position];
+    if (glm::dot(normal, normal) > 0.0f) {
+      normal = glm::normalize(normal);
+    }
+    glm::vec2 uv = corner.uv >= 0 ? uvs[corner.uv] : glm::vec2(0.0f);
+
+    std::memcpy(vertices[i].position, &position, sizeof(float) * 3);
+    std::memcpy(vertices[i].normal, &normal, sizeof(float) * 3);
+    std::memcpy(vertices[i].uv, &uv, sizeof(float) * 2);
+
+    minimum = glm::min(minimum, position);
+    maximum = glm::max(maximum, position);
+  }
+
+  glm::vec3 center = (minimum + maximum) * 0.5f;
+  float radius = 0.0f;
+  for (const Corner &corner : corners) {
+    radius = std::max(radius, glm::length(positions[corner.position] - center));
+  }
+
+  CookedAsset cooked;
+  cooked.name = path.stem().string();
+  cooked.type = assets::AssetType::Mesh;
+  cooked.mesh.vertexCount = static_cast<uint32_t>(vertices.size());
+  cooked.mesh.indexCount = static_cast<uint32_t>(indices.size());
+  cooked.mesh.vertexOffset = 0;
+  cooked.mesh.indexOffset = vertices.size() * sizeof(assets::Vertex);
+  cooked.mesh.bounds[0] = center.x;
+  cooked.mesh.bounds[1] = center.y;
+  cooked.mesh.bounds[2] = center.z;
+  cooked.mesh.bounds[3] = radius;
+
+  size_t vertexBytes = vertices.size() * sizeof(assets::Vertex);
+  size_t indexBytes = indices.size() * sizeof(uint32_t);
+  cooked.blob.resize(vertexBytes + indexBytes);
+  std::memcpy(cooked.blob.data(), vertices.data(), vertexBytes);
+  std::memcpy(cooked.blob.data() + vertexBytes, indices.data(), indexBytes);
+  return cooked;
+}
+
+} // namespace cooker
@@ -0,0 +1,162 @@
+#include "cooker/cooker.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+namespace cooker {
+
+namespace {
+
+struct Image {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<uint8_t> rgba;
+};
+
+// the next header field, skipping whitespace and # comments
+std::string readToken(std::istream &stream) {
+  std::string token;
+  char c;
+  while (stream.get(c)) {
+    if (c == '#') {
+      std::string comment;
+      std::getline(stream, comment);
+    } else if (std::isspace(static_cast<unsigned char>(c))) {
+      if (!token.empty()) {
+        return token;
+      }
+    } else {
+      token += c;
+    }
+  }
+  return token;
+}
+
+Image loadNetpbm(const std::filesystem::path &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("failed to open " + path.string() + "!");
+  }
+
+  std::string magic = readToken(file);
+  uint32_t channels = magic == "P6" ? 3 : magic == "P5" ? 1 : 0;
+  if (channels == 0) {
+    throw std::runtime_error(path.string() + " is not a binary PPM or PGM!");
+  }
+
+  Image image;
+  image.width = static_cast<uint32_t>(std::stoul(readToken(file)));
+  image.height = static_cast<uint32_t>(std::stoul(readToken(file)));
+  // readToken already ate the single whitespace before the pixel data
+  if (std::stoul(readToken(file)) != 255) {
+    throw std::runtime_error(path.string() + " is not 8 bits per channel!");
+  }
+  if (image.width == 0 || image.height == 0) {
+    throw std::runtime_error(path.string() + " is empty!");
+  }
+
+  size_t pixelCount = size_t(image.width) * image.height;
+  std::vector<uint8_t> pixels(pixelCount * channels);
+  file.read(reinterpret_cast<char *>(pixels.data()),
+            static_cast<std::streamsize>(pixels.size()));
+  if (!file) {
+    throw std::runtime_error(path.string() + " is truncated!");
+  }
+
+  image.rgba.resize(pixelCount * 4);
+  for (size_t i = 0; i < pixelCount; i++) {
+    for (uint32_t c = 0; c < 3; c++) {
+      image.rgba[i * 4 + c] = pixels[i * channels + std::min(c, channels - 1)];
+    }
+    image.rgba[i * 4 + 3] = 255;
+  }
+  return image;
+}
+
+float toLinear(uint8_t value) {
+  float c = value / 255.0f;
+  return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+}
+
+uint8_t fromLinear(float c) {
+  c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+  return static_cast<uint8_t>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// 2x2 box filter, odd edges reuse their last row or column. sRGB color is
+// averaged in linear space so the mips do not darken
+Image downsample(const Image &source, bool srgb) {
+  Image mip;
+  mip.width = std::max(source.width / 2, 1u);
+  mip.height = std::max(source.height / 2, 1u);
+  mip.rgba.resize(size_t(mip.width) * mip.height * 4);
+
+  for (uint32_t y = 0; y < mip.height; y++) {
+    uint32_t y0 = std::min(y * 2, source.height - 1);
+    uint32_t y1 = std::min(y * 2 + 1, source.height - 1);
+    for (uint32_t x = 0; x < mip.width; x++) {
+      uint32_t x0 = std::min(x * 2, source.width - 1);
+      uint32_t x1 = std::min(x * 2 + 1, source.width - 1);
+      const uint8_t *texels[4] = {
+          &source.rgba[(size_t(y0) * source.width + x0) * 4],
+          &source.rgba[(size_t(y0) * source.width + x1) * 4],
+          &source.rgba[(size_t(y1) * source.width + x0) * 4],
+          &source.rgba[(size_t(y1) * source.width + x1) * 4]};
+
+      uint8_t *out = &mip.rgba[(size_t(y) * mip.width + x) * 4];
+      for (uint32_t c = 0; c < 4; c++) {
+        bool linearize = srgb && c < 3;
+        float sum = 0.0f;
+        for (const uint8_t *texel : texels) {
+          sum += linearize ? toLinear(texel[c]) : texel[c] / 255.0f;
+        }
+        float average = sum / 4.0f;
+        out[c] = linearize ? fromLinear(average)
+                           : static_cast<uint8_t>(average * 255.0f + 0.5f);
+      }
+    }
+  }
+  return mip;
+}
+
+} // namespace
+
+CookedAsset cookTexture(const std::filesystem::path &path, bool srgb) {
+  std::vector<Image> mips;
+  mips.push_back(loadNetpbm(path));
+  while ((mips.back().width > 1 || mips.back().height > 1) &&
+         mips.size() < assets::maxMips) {
+    mips.push_back(downsample(mips.back(), srgb));
+  }
+
+  CookedAsset cooked;
+  cooked.name = path.stem().string();
+  cooked.type = assets::AssetType::Texture;
+  cooked.texture.format = srgb ? assets::TextureFormat::Rgba8Srgb
+                               : assets::TextureFormat::Rgba8Unorm;
+  cooked.texture.width = mips[0].width;
+  cooked.texture.height = mips[0].height;
+  cooked.texture.mipCount = static_cast<uint32_t>(mips.size());
+
+  // mips start 16 byte aligned, which covers every texel size and most
+  // optimalBufferCopyOffsetAlignment values
+  for (size_t i = 0; i < mips.size(); i++) {
+    size_t offset = (cooked.blob.size() + 15) & ~size_t(15);
+    cooked.blob.resize(offset + mips[i].rgba.size());
+    std::memcpy(cooked.blob.data() + offset, mips[i].rgba.data(),
+                mips[i].rgba.size());
+
+    assets::MipInfo &info = cooked.texture.mips[i];
+    info.offset = offset;
+    info.size = mips[i].rgba.size();
+    info.width = mips[i].width;
+    info.height = mips[i].height;
+  }
+  return cooked;
+}
+
+} // namespace cooker
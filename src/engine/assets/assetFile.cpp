@@ -0,0 +1,273 @@
+#include "assets/assetFile.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace assets {
+
+namespace {
+
+bool inRange(uint64_t offset, uint64_t size, uint64_t limit) {
+  return offset <= limit && size <= limit - offset;
+}
+
+uint32_t texelSize(TextureFormat format) {
+  switch (format) {
+  case TextureFormat::Rgba8Unorm:
+  case TextureFormat::Rgba8Srgb:
+    return 4;
+  }
+  return 0;
+}
+
+} // namespace
+
+VkFormat TextureView::format() const {
+  switch (info->format) {
+  case TextureFormat::Rgba8Unorm:
+    return VK_FORMAT_R8G8B8A8_UNORM;
+  case TextureFormat::Rgba8Srgb:
+    return VK_FORMAT_R8G8B8A8_SRGB;
+  }
+  return VK_FORMAT_UNDEFINED;
+}
+
+std::vector<VkBufferImageCopy> TextureView::copyRegions() const {
+  std::vector<VkBufferImageCopy> regions(info->mipCount);
+  for (uint32_t mip = 0; mip < info->mipCount; mip++) {
+    VkBufferImageCopy &region = regions[mip];
+    region = {};
+    region.bufferOffset = info->mips[mip].offset;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.mipLevel = mip;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent = {info->mips[mip].width, info->mips[mip].height, 1};
+  }
+  return regions;
+}
+
+AssetFile::~AssetFile() { close(); }
+
+void AssetFile::open(const std::string &path) {
+  close();
+  _path = path;
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                            nullptr, OPEN_EXISTING,
+                            FILE_FLAG_RANDOM_ACCESS, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    throw std::runtime_error("failed to open asset file " + path + "!");
+  }
+  _file = file;
+
+  LARGE_INTEGER size;
+  GetFileSizeEx(file, &size);
+  _size = static_cast<size_t>(size.QuadPart);
+
+  HANDLE mapping =
+      CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  void *data = mapping != nullptr
+                   ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)
+                   : nullptr;
+  _mapping = mapping;
+  if (data == nullptr) {
+    close();
+    throw std::runtime_error("failed to map asset file " + path + "!");
+  }
+  _data = static_cast<const uint8_t *>(data);
+#else
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error("failed to open asset file " + path + "!");
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0) {
+    ::close(fd);
+    throw std::runtime_error("failed to map asset file " + path + "!");
+  }
+  _size = static_cast<size_t>(info.st_size);
+
+  // the mapping keeps its own reference to the file
+  void *data = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    _size = 0;
+    throw std::runtime_error("failed to map asset file " + path + "!");
+  }
+  _data = static_cast<const uint8_t *>(data);
+
+  // assets are pulled out one at a time, not streamed front to back
+  madvise(data, _size, MADV_RANDOM);
+#endif
+
+  try {
+    validate();
+  } catch (...) {
+    close();
+    throw;
+  }
+
+  _lookup.reserve(_entryCount);
+  for (uint32_t i = 0; i < _entryCount; i++) {
+    _lookup.emplace(std::string_view(_entries[i].name), &_entries[i]);
+  }
+}
+
+void AssetFile::close() {
+#ifdef _WIN32
+  if (_data != nullptr) {
+    UnmapViewOfFile(_data);
+  }
+  if (_mapping != nullptr) {
+    CloseHandle(_mapping);
+  }
+  if (_file != nullptr) {
+    CloseHandle(_file);
+  }
+  _mapping = nullptr;
+  _file = nullptr;
+#else
+  if (_data != nullptr) {
+    munmap(const_cast<uint8_t *>(_data), _size);
+  }
+#endif
+
+  _data = nullptr;
+  _size = 0;
+  _entries = nullptr;
+  _entryCount = 0;
+  _lookup.clear();
+}
+
+const TocEntry *AssetFile::find(std::string_view name) const {
+  auto it = _lookup.find(name);
+  return it != _lookup.end() ? it->second : nullptr;
+}
+
+MeshView AssetFile::mesh(const TocEntry &entry) const {
+  if (entry.type != AssetType::Mesh) {
+    throw std::runtime_error(std::string(entry.name) + " is not a mesh!");
+  }
+
+  const uint8_t *blob = _data + entry.offset;
+  MeshView view;
+  view.vertices =
+      reinterpret_cast<const Vertex *>(blob + entry.mesh.vertexOffset);
+  view.vertexCount = entry.mesh.vertexCount;
+  view.indices =
+      reinterpret_cast<const uint32_t *>(blob + entry.mesh.indexOffset);
+  view.indexCount = entry.mesh.indexCount;
+  view.bounds = {entry.mesh.bounds[0], entry.mesh.bounds[1],
+                 entry.mesh.bounds[2], entry.mesh.bounds[3]};
+  return view;
+}
+
+TextureView AssetFile::texture(const TocEntry &entry) const {
+  if (entry.type != AssetType::Texture) {
+    throw std::runtime_error(std::string(entry.name) + " is not a texture!");
+  }
+
+  TextureView view;
+  view.info = &entry.texture;
+  view.data = _data + entry.offset;
+  view.size = entry.size;
+  return view;
+}
+
+void AssetFile::prefetch(const TocEntry &entry) const {
+#ifdef _WIN32
+  WIN32_MEMORY_RANGE_ENTRY range;
+  range.VirtualAddress = const_cast<uint8_t *>(_data + entry.offset);
+  range.NumberOfBytes = static_cast<SIZE_T>(entry.size);
+  PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+#else
+  // madvise wants a page aligned start
+  uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  uintptr_t begin = reinterpret_cast<uintptr_t>(_data + entry.offset);
+  uintptr_t alignedBegin = begin & ~(pageSize - 1);
+  madvise(reinterpret_cast<void *>(alignedBegin),
+          entry.size + (begin - alignedBegin), MADV_WILLNEED);
+#endif
+}
+
+void AssetFile::validate() {
+  // only the header and table of contents are checked, the blobs stay
+  // untouched until somebody asks for them
+  if (_size < sizeof(FileHeader)) {
+    throw std::runtime_error("asset file " + _path + " is truncated!");
+  }
+
+  const auto *header = reinterpret_cast<const FileHeader *>(_data);
+  if (header->magic != fileMagic || header->version != fileVersion) {
+    throw std::runtime_error("asset file " + _path +
+                             " has an unsupported format!");
+  }
+  if (header->fileSize != _size || header->tocOffset % 8 != 0 ||
+      !inRange(header->tocOffset,
+               uint64_t(header->entryCount) * sizeof(TocEntry), _size)) {
+    throw std::runtime_error("asset file " + _path + " is truncated!");
+  }
+
+  _entries = reinterpret_cast<const TocEntry *>(_data + header->tocOffset);
+  _entryCount = header->entryCount;
+
+  for (uint32_t i = 0; i < _entryCount; i++) {
+    const TocEntry &entry = _entries[i];
+    bool valid = std::memchr(entry.name, '\0', maxNameLength) != nullptr &&
+                 entry.offset % blobAlignment == 0 &&
+                 inRange(entry.offset, entry.size, header->tocOffset);
+
+    if (valid && entry.type == AssetType::Mesh) {
+      const MeshInfo &mesh = entry.mesh;
+      valid = mesh.vertexOffset % alignof(Vertex) == 0 &&
+              mesh.indexOffset % alignof(uint32_t) == 0 &&
+              inRange(mesh.vertexOffset,
+                      uint64_t(mesh.vertexCount) * sizeof(Vertex),
+                      entry.size) &&
+              inRange(mesh.indexOffset,
+                      uint64_t(mesh.indexCount) * sizeof(uint32_t),
+                      entry.size);
+    } else if (valid && entry.type == AssetType::Texture) {
+      const TextureInfo &texture = entry.texture;
+      // no more mips than the full chain down to 1x1
+      valid = texelSize(texture.format) != 0 && texture.width > 0 &&
+              texture.height > 0 && texture.mipCount > 0 &&
+              texture.mipCount <= maxMips &&
+              (std::max(texture.width, texture.height) >>
+               (texture.mipCount - 1)) != 0;
+      for (uint32_t mip = 0; valid && mip < texture.mipCount; mip++) {
+        const MipInfo &info = texture.mips[mip];
+        // every level halves the one above, copy offsets have to be a
+        // multiple of the texel size
+        valid = info.width == std::max(1u, texture.width >> mip) &&
+                info.height == std::max(1u, texture.height >> mip) &&
+                info.size == uint64_t(info.width) * info.height *
+                                 texelSize(texture.format) &&
+                info.offset % texelSize(texture.format) == 0 &&
+                inRange(info.offset, info.size, entry.size);
+      }
+    } else if (valid) {
+      valid = false;
+    }
+
+    if (!valid) {
+      throw std::runtime_error("asset file " + _path + " has a corrupt entry!");
+    }
+  }
+}
+
+} // namespace assets
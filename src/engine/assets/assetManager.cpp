@@ -0,0 +1,357 @@
+#include "assets/assetManager.hpp"
+#include "profiling/cpuProfiler.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace assets {
+
+AssetManager::~AssetManager() { destroy(); }
+
+void AssetManager::create(memory::Allocator &allocator,
+                          rendering::Uploader &uploader, VkDeviceSize budget,
+                          uint32_t ioThreads, uint32_t framesInFlight,
+                          rendering::BindlessHeap *bindless) {
+  _allocator = &allocator;
+  _uploader = &uploader;
+  _bindless = bindless;
+  _budget = budget;
+  _framesInFlight = framesInFlight;
+  _stopping = false;
+
+  // I/O threads spend their time blocked on page faults, they are kept
+  // apart from the job system so they never hold up a frame's jobs
+  for (uint32_t i = 0; i < std::max(ioThreads, 1u); i++) {
+    _threads.emplace_back([this] { ioLoop(); });
+  }
+}
+
+void AssetManager::stop() {
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stopping = true;
+  }
+  _wake.notify_all();
+  for (auto &thread : _threads) {
+    thread.join();
+  }
+  _threads.clear();
+}
+
+void AssetManager::destroy() {
+  if (_allocator == nullptr) {
+    return;
+  }
+
+  // a loader may have flushed copies into the memory freed below
+  stop();
+  _uploader->waitIdle();
+
+  for (Entry &entry : _entries) {
+    release(entry);
+  }
+  _entries.clear();
+  _lookup.clear();
+  _files.clear();
+  _queue = {};
+  _uploading.clear();
+  _failing.clear();
+  _resident.clear();
+  _allocator = nullptr;
+}
+
+void AssetManager::mount(const std::string &path) {
+  auto file = std::make_unique<AssetFile>();
+  file->open(path);
+
+  for (uint32_t i = 0; i < file->entryCount(); i++) {
+    const TocEntry &toc = file->entries()[i];
+    Entry &entry = _entries.emplace_back();
+    entry.file = file.get();
+    entry.toc = &toc;
+    _lookup[std::string_view(toc.name)] =
+        static_cast<uint32_t>(_entries.size() - 1);
+  }
+
+  std::cout << "mounted " << path << " (" << file->entryCount()
+            << " assets)" << std::endl;
+  _files.push_back(std::move(file));
+}
+
+AssetHandle AssetManager::request(std::string_view name, float priority) {
+  auto it = _lookup.find(name);
+  if (it == _lookup.end()) {
+    return {};
+  }
+
+  AssetHandle handle;
+  handle.index = it->second;
+  Entry &entry = _entries[handle.index];
+  entry.lastUsed.store(_frame, std::memory_order_relaxed);
+
+  Residency state = entry.state.load(std::memory_order_acquire);
+  if (state != Residency::Unloaded && state != Residency::Queued) {
+    return handle;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    state = entry.state.load(std::memory_order_relaxed);
+    if (state == Residency::Queued && entry.priority == priority) {
+      return handle;
+    }
+    if (state != Residency::Unloaded && state != Residency::Queued) {
+      return handle;
+    }
+
+    entry.priority = priority;
+    entry.state = Residency::Queued;
+    _queue.push({priority, handle.index});
+  }
+  _wake.notify_one();
+  return handle;
+}
+
+Residency AssetManager::residency(AssetHandle handle) const {
+  if (!handle.valid()) {
+    return Residency::Failed;
+  }
+  return _entries[handle.index].state.load(std::memory_order_acquire);
+}
+
+const GpuMesh *AssetManager::mesh(AssetHandle handle) const {
+  if (residency(handle) != Residency::Resident) {
+    return nullptr;
+  }
+  const Entry &entry = _entries[handle.index];
+  if (entry.toc->type != AssetType::Mesh) {
+    return nullptr;
+  }
+  entry.lastUsed.store(_frame, std::memory_order_relaxed);
+  return &entry.mesh;
+}
+
+const GpuTexture *AssetManager::texture(AssetHandle handle) const {
+  if (residency(handle) != Residency::Resident) {
+    return nullptr;
+  }
+  const Entry &entry = _entries[handle.index];
+  if (entry.toc->type != AssetType::Texture) {
+    return nullptr;
+  }
+  entry.lastUsed.store(_frame, std::memory_order_relaxed);
+  return &entry.texture;
+}
+
+void AssetManager::update(uint64_t frameNumber) {
+  _frame = frameNumber;
+
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  // resident once the graphics queue has acquired the upload, which the
+  // previous frame's command buffer did before anything can draw with it
+  auto uploaded = std::stable_partition(
+      _uploading.begin(), _uploading.end(), [this](uint32_t index) {
+        return !_uploader->isReady(_entries[index].ticket);
+      });
+  for (auto it = uploaded; it != _uploading.end(); it++) {
+    _entries[*it].state.store(Residency::Resident, std::memory_order_release);
+    _resident.push_back(*it);
+  }
+  _uploading.erase(uploaded, _uploading.end());
+
+  // a failed load is freed like an eviction, once the transfer queue is
+  // done with whatever it queued before failing
+  auto retired = std::stable_partition(
+      _failing.begin(), _failing.end(), [this](uint32_t index) {
+        return !_uploader->isReady(_entries[index].ticket);
+      });
+  for (auto it = retired; it != _failing.end(); it++) {
+    release(_entries[*it], Residency::Failed);
+  }
+  _failing.erase(retired, _failing.end());
+
+  if (_residentBytes <= _budget) {
+    return;
+  }
+
+  // frames still in flight may reference anything used since the oldest
+  // of them was recorded, everything older is safe to free right away
+  std::vector<uint32_t> candidates;
+  for (uint32_t index : _resident) {
+    if (_entries[index].lastUsed + _framesInFlight <= frameNumber) {
+      candidates.push_back(index);
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [this](uint32_t a, uint32_t b) {
+              return _entries[a].lastUsed < _entries[b].lastUsed;
+            });
+
+  size_t evicted = 0;
+  for (; evicted < candidates.size() && _residentBytes > _budget; evicted++) {
+    release(_entries[candidates[evicted]]);
+  }
+  if (evicted == 0) {
+    return;
+  }
+
+  _resident.erase(std::remove_if(_resident.begin(), _resident.end(),
+                                 [this](uint32_t index) {
+                                   return _entries[index].state !=
+                                          Residency::Resident;
+                                 }),
+                  _resident.end());
+}
+
+void AssetManager::ioLoop() {
+  PROFILE_THREAD("asset io");
+  while (true) {
+    uint32_t index;
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _wake.wait(lock, [this] { return _stopping || !_queue.empty(); });
+      if (_stopping) {
+        return;
+      }
+
+      QueueItem item = _queue.top();
+      _queue.pop();
+      Entry &entry = _entries[item.index];
+      if (entry.state != Residency::Queued || entry.priority != item.priority) {
+        continue;
+      }
+      entry.state = Residency::Loading;
+      index = item.index;
+    }
+
+    Entry &entry = _entries[index];
+    Residency result = Residency::Uploading;
+    uint64_t failedTicket = 0;
+    try {
+      load(entry);
+    } catch (const std::exception &e) {
+      std::cerr << "failed to load " << entry.toc->name << ": " << e.what()
+                << std::endl;
+      // copies queued before the throw still target the entry's resources
+      failedTicket = _uploader->currentTicket();
+      result = Residency::Failed;
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    entry.state = result;
+    if (result == Residency::Uploading) {
+      _uploading.push_back(index);
+    } else {
+      entry.ticket = failedTicket;
+      _failing.push_back(index);
+    }
+  }
+}
+
+void AssetManager::load(Entry &entry) {
+  PROFILE_SCOPE("loadAsset");
+  const TocEntry &toc = *entry.toc;
+  // one sequential read ahead instead of a page fault per 4 KiB
+  entry.file->prefetch(toc);
+
+  if (toc.type == AssetType::Mesh) {
+    MeshView view = entry.file->mesh(toc);
+    GpuMesh &mesh = entry.mesh;
+    mesh.vertices = _allocator->createBuffer(
+        view.vertexBytes(),
+        VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        memory::MemoryUsage::GpuOnly);
+    mesh.indices = _allocator->createBuffer(
+        view.indexBytes(),
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        memory::MemoryUsage::GpuOnly);
+    mesh.indexCount = view.indexCount;
+    mesh.bounds = view.bounds;
+
+    entry.bytes =
+        mesh.vertices.allocation.size + mesh.indices.allocation.size;
+    _residentBytes += entry.bytes;
+
+    // straight from the mapped file into the staging ring
+    _uploader->uploadBuffer(mesh.vertices.buffer, 0, view.vertices,
+                            view.vertexBytes());
+    entry.ticket = _uploader->uploadBuffer(mesh.indices.buffer, 0,
+                                           view.indices, view.indexBytes());
+    return;
+  }
+
+  TextureView view = entry.file->texture(toc);
+  GpuTexture &texture = entry.texture;
+  texture.format = view.format();
+  texture.extent = view.extent();
+  texture.mipCount = view.mipCount();
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = texture.format;
+  imageInfo.extent = texture.extent;
+  imageInfo.mipLevels = texture.mipCount;
+  imageInfo.arrayLayers = 1;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage =
+      VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  texture.image =
+      _allocator->createImage(imageInfo, memory::MemoryUsage::GpuOnly);
+
+  entry.bytes = texture.image.allocation.size;
+  _residentBytes += entry.bytes;
+
+  VkImageSubresourceRange range{};
+  range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  range.levelCount = texture.mipCount;
+  range.layerCount = 1;
+
+  VkImageViewCreateInfo viewInfo{};
+  viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+  viewInfo.image = texture.image.image;
+  viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+  viewInfo.format = texture.format;
+  viewInfo.subresourceRange = range;
+
+  if (vkCreateImageView(_allocator->device(), &viewInfo, nullptr,
+                        &texture.view) != VK_SUCCESS) {
+    throw std::runtime_error("failed to create texture image view!");
+  }
+  // the handle is only handed out with the texture once it is resident
+  if (_bindless != nullptr) {
+    texture.bindlessIndex = _bindless->addImage(texture.view);
+  }
+
+  entry.ticket = _uploader->uploadImage(texture.image.image, range,
+                                        view.copyRegions(), view.data,
+                                        view.size);
+}
+
+void AssetManager::release(Entry &entry, Residency state) {
+  _allocator->destroyBuffer(entry.mesh.vertices);
+  _allocator->destroyBuffer(entry.mesh.indices);
+  if (_bindless != nullptr) {
+    _bindless->remove(rendering::BindlessBinding::SampledImages,
+                      entry.texture.bindlessIndex);
+    entry.texture.bindlessIndex = UINT32_MAX;
+  }
+  if (entry.texture.view != VK_NULL_HANDLE) {
+    vkDestroyImageView(_allocator->device(), entry.texture.view, nullptr);
+    entry.texture.view = VK_NULL_HANDLE;
+  }
+  _allocator->destroyImage(entry.texture.image);
+
+  _residentBytes -= entry.bytes;
+  entry.bytes = 0;
+  entry.state = state;
+}
+
+} // namespace assets
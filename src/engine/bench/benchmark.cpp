@@ -0,0 +1,474 @@
+#include "bench/benchmark.hpp"
+#include "memory/allocationTracker.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// frames every scenario runs unless the base config asks for a count
+constexpr uint64_t defaultFrameCount = 300;
+// pipelines finish compiling and pools grow to their peak in these, they
+// are left out of every frame metric
+constexpr uint64_t warmupFrames = 30;
+// allocator stats and resident memory are sampled this often
+constexpr uint64_t sampleInterval = 10;
+
+// differences below this are noise whatever the relative change
+constexpr double noiseFloor = 0.05;
+
+constexpr VkDeviceSize uploadBufferSize = 64 * 1024 * 1024;
+constexpr VkDeviceSize uploadPerFrame = 16 * 1024 * 1024;
+
+// a size change every few frames, each one recreating the targets
+constexpr uint64_t resizeInterval = 8;
+constexpr VkExtent2D resizeExtents[] = {
+    {800, 600}, {1280, 720}, {640, 480}, {1920, 1080}, {1024, 768}};
+
+double percentile(std::vector<double> values, uint32_t percent) {
+  if (values.empty()) {
+    return 0.0;
+  }
+  std::sort(values.begin(), values.end());
+  return values[(values.size() - 1) * percent / 100];
+}
+
+double mebibytes(uint64_t bytes) {
+  return static_cast<double>(bytes) / (1024.0 * 1024.0);
+}
+
+// 0 where there is no cheap way to ask
+uint64_t residentBytes() {
+#ifdef __linux__
+  std::ifstream statm("/proc/self/statm");
+  uint64_t size = 0;
+  uint64_t resident = 0;
+  if (statm >> size >> resident) {
+    return resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+  }
+#endif
+  return 0;
+}
+
+std::string escape(const std::string &text) {
+  std::string escaped;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      escaped += '\\';
+    }
+    escaped += c;
+  }
+  return escaped;
+}
+
+// just enough JSON for what writeResults() produces: objects, strings and
+// numbers
+class JsonReader {
+public:
+  explicit JsonReader(const std::string &text) : _text(text) {}
+
+  std::string string() {
+    expect('"');
+    std::string value;
+    while (_position < _text.size() && _text[_position] != '"') {
+      if (_text[_position] == '\\') {
+        _position++;
+      }
+      if (_position < _text.size()) {
+        value += _text[_position++];
+      }
+    }
+    expect('"');
+    return value;
+  }
+
+  double number() {
+    skipWhitespace();
+    const char *begin = _text.c_str() + _position;
+    char *end = nullptr;
+    double value = std::strtod(begin, &end);
+    if (end == begin) {
+      fail();
+    }
+    _position += static_cast<size_t>(end - begin);
+    return value;
+  }
+
+  // `member` is called with every key and has to read its value
+  template <typename Member> void object(Member &&member) {
+    expect('{');
+    if (consume('}')) {
+      return;
+    }
+    do {
+      std::string key = string();
+      expect(':');
+      member(key);
+    } while (consume(','));
+    expect('}');
+  }
+
+  void skipValue() {
+    skipWhitespace();
+    if (peek() == '"') {
+      string();
+    } else if (peek() == '{') {
+      object([this](const std::string &) { skipValue(); });
+    } else {
+      number();
+    }
+  }
+
+private:
+  char peek() const {
+    return _position < _text.size() ? _text[_position] : '\0';
+  }
+
+  void skipWhitespace() {
+    while (_position < _text.size() &&
+           std::isspace(static_cast<unsigned char>(_text[_position]))) {
+      _position++;
+    }
+  }
+
+  bool consume(char c) {
+    skipWhitespace();
+    if (peek() != c) {
+      return false;
+    }
+    _position++;
+    return true;
+  }
+
+  void expect(char c) {
+    if (!consume(c)) {
+      fail();
+    }
+  }
+
+  [[noreturn]] void fail() {
+    throw std::runtime_error("failed to parse benchmark results!");
+  }
+
+  const std::string &_text;
+  size_t _position = 0;
+};
+
+} // namespace
+
+const Metric *ScenarioResult::find(const std::string &metric) const {
+  for (const Metric &candidate : metrics) {
+    if (candidate.name == metric) {
+      return &candidate;
+    }
+  }
+  return nullptr;
+}
+
+const ScenarioResult *BenchResults::find(const std::string &scenario) const {
+  for (const ScenarioResult &candidate : scenarios) {
+    if (candidate.name == scenario) {
+      return &candidate;
+    }
+  }
+  return nullptr;
+}
+
+std::vector<Scenario> defaultScenarios(const engine::EngineConfig &base) {
+  engine::EngineConfig config = base;
+  // no window, so a software implementation such as lavapipe will do
+  config.headless = true;
+  config.profileInterval = 0;
+  config.tracePath.clear();
+  config.capturePath.clear();
+  if (config.maxFrames == 0) {
+    config.maxFrames = defaultFrameCount;
+  }
+
+  std::vector<Scenario> scenarios;
+
+  // culled and staged per batch on the job system, one instanced draw each
+  Scenario manyDraws;
+  manyDraws.name = "manyDraws";
+  manyDraws.config = config;
+  manyDraws.config.drawCount = 20000;
+  scenarios.push_back(manyDraws);
+
+  // mostly simulation and culling, drawn indirectly where supported
+  Scenario manyEntities;
+  manyEntities.name = "manyEntities";
+  manyEntities.config = config;
+  manyEntities.config.drawCount = 200000;
+  manyEntities.config.gpuDriven = true;
+  scenarios.push_back(manyEntities);
+
+  // keeps the staging ring and the transfer queue saturated
+  Scenario heavyUploads;
+  heavyUploads.name = "heavyUploads";
+  heavyUploads.config = config;
+  struct UploadState {
+    memory::Buffer buffer;
+    std::vector<uint8_t> data;
+  };
+  auto uploads = std::make_shared<UploadState>();
+  heavyUploads.frame = [uploads](engine::Engine &engine, uint64_t frame) {
+    if (uploads->buffer.buffer == VK_NULL_HANDLE) {
+      uploads->buffer = engine.allocator().createBuffer(
+          uploadBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+          memory::MemoryUsage::GpuOnly);
+      uploads->data.assign(uploadPerFrame, 0x5a);
+    }
+    // whole slots keep every copy aligned and inside the buffer
+    VkDeviceSize offset =
+        (frame % (uploadBufferSize / uploadPerFrame)) * uploadPerFrame;
+    engine.uploader().uploadBuffer(uploads->buffer.buffer, offset,
+                                   uploads->data.data(), uploadPerFrame);
+  };
+  heavyUploads.teardown = [uploads](engine::Engine &engine) {
+    if (uploads->buffer.buffer != VK_NULL_HANDLE) {
+      engine.allocator().destroyBuffer(uploads->buffer);
+    }
+  };
+  scenarios.push_back(heavyUploads);
+
+  // recreation cost and the frames around it
+  Scenario resizeStorm;
+  resizeStorm.name = "resizeStorm";
+  resizeStorm.config = config;
+  resizeStorm.frame = [](engine::Engine &engine, uint64_t frame) {
+    if (frame == 0 || frame % resizeInterval != 0) {
+      return;
+    }
+    constexpr size_t extentCount = std::size(resizeExtents);
+    const VkExtent2D &extent =
+        resizeExtents[(frame / resizeInterval) % extentCount];
+    engine.resize(extent.width, extent.height);
+  };
+  scenarios.push_back(resizeStorm);
+
+  return scenarios;
+}
+
+ScenarioResult runScenario(const Scenario &scenario, std::string &device) {
+  std::cout << "bench: running " << scenario.name << std::endl;
+  engine::Engine engine(scenario.config);
+  device = engine.deviceCapabilities().properties.deviceName;
+
+  uint64_t frameCount = scenario.config.maxFrames;
+  std::vector<double> cpuTimes;
+  std::vector<double> gpuTimes;
+  cpuTimes.reserve(frameCount);
+  gpuTimes.reserve(frameCount);
+
+  Clock::time_point last = Clock::now();
+  uint64_t lastGpuFrame = 0;
+  uint64_t peakGpuBytes = 0;
+  uint64_t peakResidentBytes = 0;
+  memory::AllocationCounters warmAllocations;
+  // made by the bookkeeping below since warmup, taken out of the result
+  uint64_t benchAllocations = 0;
+
+  engine.setFrameCallback([&](engine::Engine &, uint64_t frame) {
+    if (frame == warmupFrames) {
+      warmAllocations = memory::allocationCounters();
+      benchAllocations = 0;
+    }
+    // only this thread's, every other thread keeps being counted
+    uint64_t before = memory::threadAllocationCounters().count;
+
+    Clock::time_point now = Clock::now();
+    if (frame > warmupFrames) {
+      cpuTimes.push_back(
+          std::chrono::duration<double, std::milli>(now - last).count());
+    }
+    last = now;
+
+    // results trail recording by the frames in flight
+    const profiling::GpuFrameResult &gpu = engine.gpuProfiler().result();
+    if (gpu.frameNumber != lastGpuFrame) {
+      lastGpuFrame = gpu.frameNumber;
+      if (gpu.frameNumber >= warmupFrames) {
+        gpuTimes.push_back(gpu.milliseconds);
+      }
+    }
+
+    if (frame % sampleInterval == 0) {
+      peakGpuBytes = std::max<uint64_t>(
+          peakGpuBytes, engine.allocator().stats().reservedBytes);
+      peakResidentBytes = std::max(peakResidentBytes, residentBytes());
+    }
+
+    benchAllocations += memory::threadAllocationCounters().count - before;
+    if (scenario.frame) {
+      scenario.frame(engine, frame);
+    }
+  });
+  engine.run();
+  if (scenario.teardown) {
+    scenario.teardown(engine);
+  }
+
+  memory::AllocationCounters allocations = memory::allocationCounters();
+  uint64_t measuredFrames =
+      frameCount > warmupFrames ? frameCount - warmupFrames : 1;
+
+  ScenarioResult result;
+  result.name = scenario.name;
+  result.metrics = {
+      {"startupMs", engine.startupTimer().totalMilliseconds()},
+      {"cpuFrameP50Ms", percentile(cpuTimes, 50)},
+      {"cpuFrameP95Ms", percentile(cpuTimes, 95)},
+      {"cpuFrameP99Ms", percentile(cpuTimes, 99)},
+      {"cpuFrameMaxMs", percentile(cpuTimes, 100)},
+      {"gpuFrameP50Ms", percentile(gpuTimes, 50)},
+      {"gpuFrameP95Ms", percentile(gpuTimes, 95)},
+      {"gpuFrameP99Ms", percentile(gpuTimes, 99)},
+      {"heapAllocationsPerFrame",
+       static_cast<double>(allocations.count - warmAllocations.count -
+                           benchAllocations) /
+           static_cast<double>(measuredFrames)},
+      {"peakGpuMemoryMiB", mebibytes(peakGpuBytes)},
+      {"peakResidentMiB", mebibytes(peakResidentBytes)},
+  };
+  return result;
+}
+
+void writeResults(const std::string &path, const BenchResults &results) {
+  std::ofstream file(path);
+  if (!file) {
+    throw std::runtime_error("failed to open " + path + "!");
+  }
+
+  file << std::fixed << std::setprecision(3);
+  file << "{\n  \"device\": \"" << escape(results.device) << "\",\n"
+       << "  \"scenarios\": {";
+  for (size_t s = 0; s < results.scenarios.size(); s++) {
+    const ScenarioResult &scenario = results.scenarios[s];
+    file << (s == 0 ? "\n" : ",\n") << "    \"" << escape(scenario.name)
+         << "\": {";
+    for (size_t m = 0; m < scenario.metrics.size(); m++) {
+      const Metric &metric = scenario.metrics[m];
+      file << (m == 0 ? "\n" : ",\n") << "      \"" << escape(metric.name)
+           << "\": " << metric.value;
+    }
+    file << "\n    }";
+  }
+  file << "\n  }\n}\n";
+}
+
+BenchResults readResults(const std::string &path) {
+  std::ifstream file(path);
+  if (!file) {
+    throw std::runtime_error("failed to open " + path + "!");
+  }
+  std::stringstream text;
+  text << file.rdbuf();
+  std::string json = text.str();
+
+  BenchResults results;
+  JsonReader reader(json);
+  reader.object([&](const std::string &key) {
+    if (key == "device") {
+      results.device = reader.string();
+    } else if (key == "scenarios") {
+      reader.object([&](const std::string &name) {
+        ScenarioResult scenario;
+        scenario.name = name;
+        reader.object([&](const std::string &metric) {
+          scenario.metrics.push_back({metric, reader.number()});
+        });
+        results.scenarios.push_back(std::move(scenario));
+      });
+    } else {
+      reader.skipValue();
+    }
+  });
+  return results;
+}
+
+bool compareResults(const BenchResults &current, const BenchResults &baseline,
+                    double tolerance, std::ostream &out) {
+  if (current.device != baseline.device) {
+    out << "bench: baseline is from " << baseline.device << ", not "
+        << current.device << ", expect differences" << std::endl;
+  }
+
+  bool passed = true;
+  out << std::fixed << std::setprecision(3);
+  for (const ScenarioResult &scenario : current.scenarios) {
+    const ScenarioResult *before = baseline.find(scenario.name);
+    if (before == nullptr) {
+      out << "  " << scenario.name << ": not in the baseline" << std::endl;
+      continue;
+    }
+
+    for (const Metric &metric : scenario.metrics) {
+      const Metric *old = before->find(metric.name);
+      if (old == nullptr) {
+        continue;
+      }
+      double change = old->value > 0.0 ? metric.value / old->value - 1.0 : 0.0;
+      bool regressed = metric.value > old->value * (1.0 + tolerance) &&
+                       metric.value - old->value > noiseFloor;
+      passed = passed && !regressed;
+
+      out << "  " << std::left << std::setw(14) << scenario.name
+          << std::setw(26) << metric.name << std::right << std::setw(12)
+          << old->value << " -> " << std::setw(12) << metric.value << " "
+          << std::showpos << std::setprecision(1) << change * 100.0 << "%"
+          << std::noshowpos << std::setprecision(3)
+          << (regressed ? "  regressed" : "") << std::endl;
+    }
+  }
+  out << std::defaultfloat;
+  return passed;
+}
+
+int runBenchmarks(const BenchOptions &options) {
+  BenchResults results;
+  for (const Scenario &scenario : defaultScenarios(options.base)) {
+    if (!options.scenario.empty() && scenario.name != options.scenario) {
+      continue;
+    }
+    results.scenarios.push_back(runScenario(scenario, results.device));
+  }
+  if (results.scenarios.empty()) {
+    throw std::runtime_error("no benchmark scenario named " +
+                             options.scenario + "!");
+  }
+
+  writeResults(options.outputPath, results);
+  std::cout << "bench: results written to " << options.outputPath
+            << std::endl;
+
+  if (options.baselinePath.empty()) {
+    return 0;
+  }
+  std::cout << "bench: comparing against " << options.baselinePath
+            << std::endl;
+  bool passed = compareResults(results, readResults(options.baselinePath),
+                               options.tolerance, std::cout);
+  std::cout << (passed ? "bench: no regressions" : "bench: regressions found")
+            << std::endl;
+  return passed ? 0 : 1;
+}
+
+} // namespace bench
@@ -0,0 +1,102 @@
+#include "ecs/archetype.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace ecs {
+
+namespace {
+
+// chunks start on a cache line, so do the arrays of any component that
+// asks for it
+constexpr size_t chunkAlignment = 64;
+
+size_t alignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+} // namespace
+
+Archetype::Archetype(const Signature &signature) : _signature(signature) {
+  _offsets.fill(UINT32_MAX);
+  for (ComponentId id = 0; id < maxComponents; id++) {
+    if (signature.test(id)) {
+      _components.push_back(id);
+    }
+  }
+
+  size_t rowSize = sizeof(Entity);
+  size_t padding = 0;
+  for (ComponentId id : _components) {
+    rowSize += componentInfo(id).size;
+    padding += componentInfo(id).alignment;
+  }
+
+  // a single huge row still gets a chunk of its own
+  size_t capacity = chunkBytes > padding ? (chunkBytes - padding) / rowSize : 0;
+  _capacity = static_cast<uint32_t>(std::max<size_t>(capacity, 1));
+
+  size_t offset = sizeof(Entity) * _capacity;
+  for (ComponentId id : _components) {
+    const ComponentInfo &info = componentInfo(id);
+    offset = alignUp(offset, info.alignment);
+    _offsets[id] = static_cast<uint32_t>(offset);
+    offset += info.size * _capacity;
+  }
+  _allocationSize = std::max(chunkBytes, alignUp(offset, chunkAlignment));
+}
+
+Archetype::~Archetype() {
+  for (auto &chunk : _chunks) {
+    ::operator delete(chunk.data, std::align_val_t(chunkAlignment));
+  }
+}
+
+std::pair<uint32_t, uint32_t> Archetype::pushBack(Entity entity) {
+  if (_chunks.empty() || _chunks.back().count == _capacity) {
+    Chunk chunk;
+    chunk.data = static_cast<std::byte *>(
+        ::operator new(_allocationSize, std::align_val_t(chunkAlignment)));
+    _chunks.push_back(chunk);
+  }
+
+  Chunk &chunk = _chunks.back();
+  uint32_t row = chunk.count++;
+  entities(chunk)[row] = entity;
+  _size++;
+  return {static_cast<uint32_t>(_chunks.size() - 1), row};
+}
+
+Entity Archetype::remove(uint32_t chunk, uint32_t row) {
+  Chunk &last = _chunks.back();
+  uint32_t lastRow = last.count - 1;
+  Entity moved;
+
+  // keep every chunk but the last one full
+  if (&last != &_chunks[chunk] || lastRow != row) {
+    Chunk &target = _chunks[chunk];
+    moved = entities(last)[lastRow];
+    entities(target)[row] = moved;
+    for (ComponentId id : _components) {
+      size_t size = componentInfo(id).size;
+      std::memcpy(target.data + _offsets[id] + size * row,
+                  last.data + _offsets[id] + size * lastRow, size);
+    }
+  }
+
+  last.count--;
+  _size--;
+  if (last.count == 0) {
+    ::operator delete(last.data, std::align_val_t(chunkAlignment));
+    _chunks.pop_back();
+  }
+  return moved;
+}
+
+void *Archetype::component(ComponentId id, uint32_t chunk,
+                           uint32_t row) const {
+  return _chunks[chunk].data + _offsets[id] + componentInfo(id).size * row;
+}
+
+} // namespace ecs
@@ -0,0 +1,32 @@
+#include "ecs/entity.hpp"
+
+#include <array>
+#include <mutex>
+#include <stdexcept>
+
+namespace ecs {
+
+namespace {
+
+std::mutex registryMutex;
+std::array<ComponentInfo, maxComponents> registry;
+uint32_t registeredCount = 0;
+
+} // namespace
+
+namespace detail {
+
+ComponentId registerComponent(size_t size, size_t alignment) {
+  std::lock_guard<std::mutex> lock(registryMutex);
+  if (registeredCount == maxComponents) {
+    throw std::runtime_error("too many component types!");
+  }
+  registry[registeredCount] = {size, alignment};
+  return registeredCount++;
+}
+
+} // namespace detail
+
+const ComponentInfo &componentInfo(ComponentId id) { return registry[id]; }
+
+} // namespace ecs
@@ -0,0 +1,99 @@
+#include "ecs/world.hpp"
+
+namespace ecs {
+
+World::World() { _empty = &archetypeFor(Signature()); }
+
+void World::destroy(Entity entity) {
+  if (!alive(entity)) {
+    return;
+  }
+
+  Record &record = _records[entity.index];
+  Entity moved = record.archetype->remove(record.chunk, record.row);
+  fixMoved(moved, record.chunk, record.row);
+
+  record.archetype = nullptr;
+  record.generation++;
+  _freeList.push_back(entity.index);
+  _structureVersion++;
+}
+
+bool World::alive(Entity entity) const {
+  return entity.index < _records.size() &&
+         _records[entity.index].archetype != nullptr &&
+         _records[entity.index].generation == entity.generation;
+}
+
+void World::apply(CommandBuffer &commands) {
+  std::vector<std::function<void(World &)>> pending;
+  {
+    std::lock_guard<std::mutex> lock(commands._mutex);
+    pending.swap(commands._commands);
+  }
+
+  for (auto &command : pending) {
+    command(*this);
+  }
+}
+
+Archetype &World::archetypeFor(const Signature &signature) {
+  auto it = _archetypeLookup.find(signature);
+  if (it != _archetypeLookup.end()) {
+    return *it->second;
+  }
+
+  _archetypes.push_back(std::make_unique<Archetype>(signature));
+  Archetype *archetype = _archetypes.back().get();
+  _archetypeLookup.emplace(signature, archetype);
+  return *archetype;
+}
+
+Entity World::createIn(Archetype &archetype) {
+  Entity entity;
+  if (!_freeList.empty()) {
+    entity.index = _freeList.back();
+    _freeList.pop_back();
+  } else {
+    entity.index = static_cast<uint32_t>(_records.size());
+    _records.emplace_back();
+  }
+
+  Record &record = _records[entity.index];
+  entity.generation = record.generation;
+  record.archetype = &archetype;
+  _structureVersion++;
+  std::tie(record.chunk, record.row) = archetype.pushBack(entity);
+  return entity;
+}
+
+void World::move(Entity entity, Archetype &target) {
+  Record &record = _records[entity.index];
+  Archetype &source = *record.archetype;
+  _structureVersion++;
+
+  auto [chunk, row] = target.pushBack(entity);
+  for (ComponentId id : target.components()) {
+    if (source.has(id)) {
+      std::memcpy(target.component(id, chunk, row),
+                  source.component(id, record.chunk, record.row),
+                  componentInfo(id).size);
+    }
+  }
+
+  Entity moved = source.remove(record.chunk, record.row);
+  fixMoved(moved, record.chunk, record.row);
+
+  record.archetype = &target;
+  record.chunk = chunk;
+  record.row = row;
+}
+
+void World::fixMoved(Entity moved, uint32_t chunk, uint32_t row) {
+  if (moved.valid()) {
+    _records[moved.index].chunk = chunk;
+    _records[moved.index].row = row;
+  }
+}
+
+} // namespace ecs
@@ -1,59 +1,765 @@
 #include "engine.hpp"
 #include "debugUtil.hpp"
+#include "profiling/cpuProfiler.hpp"
 #include "rendering/swapchain.hpp"
+#include "scene/culling.hpp"
+#include "scene/transforms.hpp"
 
 #include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cmath>
 #include <cstring>
+#include <fstream>
 #include <set>
 
 namespace engine {
 
-Engine::Engine() : _width(800), _height(600) {
-  glfwInit();
+namespace {
+
+// fewer draws than this per secondary costs more to record and execute
+// than it saves
+constexpr uint32_t minDrawBatchSize = 64;
+
+const std::vector<VkCommandBuffer> noDraws;
+
+// device selection, see Engine::scoreDevice
+constexpr uint64_t discreteGpuScore = 100000;
+constexpr uint64_t integratedGpuScore = 20000;
+constexpr uint64_t virtualGpuScore = 10000;
+// 64 GiB worth of points
+constexpr uint64_t memoryScoreCap = 64 * 1024;
+constexpr uint64_t queueFamilyScore = 2000;
+constexpr uint64_t featureScore = 4000;
+
+const char *deviceTypeName(VkPhysicalDeviceType type) {
+  switch (type) {
+  case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+    return "discrete";
+  case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+    return "integrated";
+  case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+    return "virtual";
+  case VK_PHYSICAL_DEVICE_TYPE_CPU:
+    return "cpu";
+  default:
+    return "other";
+  }
+}
 
-  glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-  glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+// an index into the enumeration order, or part of the name in any case
+bool matchesGpuName(const VkPhysicalDeviceProperties &properties,
+                    uint32_t index, const std::string &request) {
+  if (!request.empty() &&
+      std::all_of(request.begin(), request.end(),
+                  [](char c) {
+                    return std::isdigit(static_cast<unsigned char>(c)) != 0;
+                  })) {
+    return std::stoul(request) == index;
+  }
 
-  _window = glfwCreateWindow(_width, _height, "Vulkan", nullptr, nullptr);
+  auto lower = [](std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(), [](char c) {
+      return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    });
+    return text;
+  };
+  return lower(properties.deviceName).find(lower(request)) !=
+         std::string::npos;
+}
 
-  createInstance();
-  setupDebugMessenger();
-  createSurface();
-  pickPhysicalDevice();
-  createLogicalDevice();
-  createSwapChain();
+// what createPipelines() builds from, compiled while the device is being
+// created so the pipelines find them in the shader cache
+std::vector<rendering::ShaderSource> startupShaders(bool gpuDriven) {
+  std::vector<rendering::ShaderSource> sources(2);
+  sources[0].path = "triangle.vert";
+  sources[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+  sources[1].path = "triangle.frag";
+  sources[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  if (gpuDriven) {
+    sources.resize(4);
+    sources[2].path = "triangleIndirect.vert";
+    sources[2].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    sources[3].path = "cull.comp";
+    sources[3].stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+  return sources;
+}
+
+} // namespace
+
+Engine::Engine(const EngineConfig &config)
+    : _config(config), _width(static_cast<int>(config.width)),
+      _height(static_cast<int>(config.height)),
+      _shaderCompiler(config.shaderDir, config.cacheDir + "/shaders",
+                      !debug::enableValidationLayers, &_jobs) {
+  if (_config.framesInFlight == 0) {
+    throw std::runtime_error("at least one frame in flight is required!");
+  }
+
+  _startup.start();
+  if (!_config.tracePath.empty()) {
+    profiling::enableCpuProfiling(true);
+  }
+  PROFILE_THREAD("main");
+  PROFILE_SCOPE("Engine::Engine");
+
+  _jobs.init(_config.workerThreads);
+  _frameArena.create(_config.framesInFlight, _jobs.threadCount() + 1);
+
+  // none of these need the device, they run while it is being created.
+  // Nothing below touches what they write until they are waited for
+  jobs::Counter background;
+  _jobs.run(
+      [this]() {
+        profiling::StartupPhase phase(_startup, "loadPipelineCache");
+        _pipelineCache.load(_config.cacheDir + "/pipelines.bin");
+      },
+      &background);
+  _jobs.run(
+      [this]() {
+        profiling::StartupPhase phase(_startup, "compileShaders");
+        // a shader that fails here fails again when its pipeline is built,
+        // which is where errors are reported
+        try {
+          _shaderCompiler.compileAll(startupShaders(_config.gpuDriven));
+        } catch (const std::exception &) {
+        }
+      },
+      &background);
+  _jobs.run(
+      [this]() {
+        profiling::StartupPhase phase(_startup, "createScene");
+        createScene();
+      },
+      &background);
+
+  jobs::Counter instanceReady;
+  try {
+    if (!_config.headless) {
+      glfwInit();
+    }
+    // the loader scanning for drivers is most of the instance's cost, and
+    // the window does not need the instance until its surface is created
+    _jobs.run(
+        [this]() {
+          profiling::StartupPhase phase(_startup, "createInstance");
+          createInstance();
+          setupDebugMessenger();
+        },
+        &instanceReady);
+    if (!_config.headless) {
+      profiling::StartupPhase phase(_startup, "createWindow");
+      createWindow();
+    }
+    _jobs.wait(instanceReady);
+
+    {
+      profiling::StartupPhase phase(_startup, "createDevice");
+      if (!_config.headless) {
+        createSurface();
+      }
+      pickPhysicalDevice();
+      createLogicalDevice();
+    }
+    _pacer.create(_device, _config.pacing, _config.framesInFlight,
+                  _config.frameRateLimit, _presentWaitEnabled);
+    _allocator.init(_physicalDevice, _device,
+                    isExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME));
+    // the CPU path stages every instance's matrix in it each frame
+    VkDeviceSize frameRingSize = _config.frameRingSize;
+    if (!_gpuDrivenEnabled) {
+      frameRingSize += VkDeviceSize{_config.drawCount} * sizeof(glm::mat4);
+    }
+    _frameRing.create(_allocator, frameRingSize, _config.framesInFlight,
+                      VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                          VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                          VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                          VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+    if (_bindlessEnabled) {
+      _bindless.create(_physicalDevice, _device, _config.framesInFlight);
+    }
+    {
+      profiling::StartupPhase phase(_startup, "createUploader");
+      createUploader();
+      createAssets();
+    }
+    {
+      profiling::StartupPhase phase(_startup, "createSwapChain");
+      if (_config.headless) {
+        createOffscreenTargets();
+      } else {
+        createSwapChain();
+      }
+      createCommands();
+      createSyncObjects();
+    }
+
+    {
+      profiling::StartupPhase phase(_startup, "waitForBackground");
+      _jobs.wait(background);
+    }
+    {
+      profiling::StartupPhase phase(_startup, "createPipelines");
+      createPipelines();
+    }
+    if (_gpuDrivenEnabled) {
+      profiling::StartupPhase phase(_startup, "createGpuScene");
+      createGpuScene();
+    }
+  } catch (...) {
+    // the jobs write into the engine, they have to be done before it
+    // unwinds. Their own errors lose to the one already in flight
+    for (jobs::Counter *counter : {&instanceReady, &background}) {
+      try {
+        _jobs.wait(*counter);
+      } catch (...) {
+      }
+    }
+    throw;
+  }
 }
 
 Engine::~Engine() {
-  vkDestroySwapchainKHR(_device, _swapChain, nullptr);
+  // normally stopped by loop() already, it must not outlive the jobs
+  _simulation.stop();
+  for (auto &frame : _frames) {
+    vkDestroyFence(_device, frame.inFlightFence, nullptr);
+    vkDestroySemaphore(_device, frame.imageAvailableSemaphore, nullptr);
+    vkDestroyCommandPool(_device, frame.commandPool, nullptr);
+  }
+  _recorder.destroy();
+  _gpuProfiler.destroy();
+  _graph.destroy();
+  for (auto semaphore : _renderFinishedSemaphores) {
+    vkDestroySemaphore(_device, semaphore, nullptr);
+  }
+  destroyRetiredSwapChains(true);
+
+  _pipelines.destroy();
+  _jobs.destroy();
+  _pipelineCache.save();
+  _pipelineCache.destroy();
+
+  for (auto view : _swapChainImageViews) {
+    vkDestroyImageView(_device, view, nullptr);
+  }
+  _offscreen.destroy();
+  if (_swapChain != VK_NULL_HANDLE) {
+    vkDestroySwapchainKHR(_device, _swapChain, nullptr);
+  }
+
+  // I/O loaders still finishing a load submit copies into asset and
+  // scene memory, nothing is freed before the transfer queue is done
+  _assets.stop();
+  _uploader.waitIdle();
+  _gpuScene.destroy();
+  _assets.destroy();
+  _bindless.destroy();
+  _uploader.destroy();
+  _frameRing.destroy();
+  // a leak report like the other profiling output, not for every run
+  if (_config.profileInterval != 0) {
+    _allocator.printStats(std::cout);
+  }
+  _allocator.destroy();
+
   vkDestroyDevice(_device, nullptr);
 
   if (debug::enableValidationLayers) {
     debug::destroyDebugUtilsMessengerEXT(_instance, _debugMessenger, nullptr);
   }
 
-  vkDestroySurfaceKHR(_instance, _surface, nullptr);
+  if (_surface != VK_NULL_HANDLE) {
+    vkDestroySurfaceKHR(_instance, _surface, nullptr);
+  }
   vkDestroyInstance(_instance, nullptr);
 
-  glfwDestroyWindow(_window);
-  glfwTerminate();
+  if (_window != nullptr) {
+    glfwDestroyWindow(_window);
+    glfwTerminate();
+  }
 }
 
-void Engine::run() { loop(); }
+void Engine::run() {
+  loop();
+
+  if (!_config.tracePath.empty()) {
+    profiling::writeChromeTrace(_config.tracePath);
+  }
+}
 
 void Engine::loop() {
-  while (!glfwWindowShouldClose(_window)) {
-    glfwPollEvents();
-    glfwSetKeyCallback(_window, [](GLFWwindow *window, int key, int scancode,
-                                   int action, int mods) {
-      if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
-        glfwSetWindowShouldClose(window, true);
-      }
-    });
+  _simulation.start(_world, _jobs, _config.tickRate,
+                    [this](float deltaTime) { updateScene(deltaTime); });
+  // everything from here on should be served by arenas, pools and
+  // containers that already reached their peak
+  memory::trackAllocations(true);
+  _reportedAllocations = memory::allocationCounters();
+  memory::AllocationCounters loopStart = _reportedAllocations;
+
+  while (!shouldClose()) {
+    PROFILE_SCOPE("frame");
+    paceFrame();
+    if (!_config.headless) {
+      glfwPollEvents();
+    }
+
+    if (_frameCallback) {
+      _frameCallback(*this, _frameNumber);
+    }
+
+    // the world keeps ticking on its own, the frame draws it as it was
+    // one tick ago
+    _simulation.interpolate(_jobs, _renderInstances);
+
+    drawFrame();
+    if (!_startup.finished() && _frameNumber > 0) {
+      _startup.finish();
+      _startup.print(std::cout);
+    }
+  }
+  memory::trackAllocations(false);
+  _simulation.stop();
+
+  if (memory::allocationTrackingAvailable()) {
+    memory::AllocationCounters counters = memory::allocationCounters();
+    std::cout << "heap allocations in the loop: "
+              << counters.count - loopStart.count << ", "
+              << counters.bytes - loopStart.bytes << " bytes over "
+              << _frameNumber << " frames" << std::endl;
+  }
+
+  // the frames still in flight reference resources we are about to destroy
+  vkDeviceWaitIdle(_device);
+
+  if (_config.headless && !_config.capturePath.empty() && _frameNumber > 0) {
+    captureFrame(_config.capturePath);
+  }
+}
+
+void Engine::setFrameCallback(FrameCallback callback) {
+  _frameCallback = std::move(callback);
+}
+
+void Engine::resize(uint32_t width, uint32_t height) {
+  _config.width = width;
+  _config.height = height;
+  if (_config.headless) {
+    _swapChainOutOfDate = true;
+  } else {
+    // the framebuffer size callback marks the swapchain out of date
+    glfwSetWindowSize(_window, static_cast<int>(width),
+                      static_cast<int>(height));
+  }
+}
+
+void Engine::paceFrame() {
+  PROFILE_SCOPE("paceFrame");
+  // before input is polled, whatever the frame samples is shown as soon as
+  // the queue ahead of it allows
+  if (!_pacer.waitForPresent(_swapChain, _frameNumber)) {
+    uint32_t ahead = _pacer.framesAhead();
+    if (ahead < _config.framesInFlight && _frameNumber >= ahead) {
+      rendering::FrameData &older =
+          _frames[(_frameNumber - ahead) % _config.framesInFlight];
+      vkWaitForFences(_device, 1, &older.inFlightFence, VK_TRUE, UINT64_MAX);
+    }
+  }
+  _pacer.beginFrame();
+}
+
+void Engine::printAllocations() {
+  if (!memory::allocationTrackingAvailable()) {
+    return;
   }
+  memory::AllocationCounters counters = memory::allocationCounters();
+  std::cout << "heap allocations: "
+            << counters.count - _reportedAllocations.count << ", "
+            << counters.bytes - _reportedAllocations.bytes
+            << " bytes since the last report, frame arenas hold "
+            << _frameArena.capacity() << " bytes" << std::endl;
+  // the report itself allocates, keep it out of the next one
+  _reportedAllocations = memory::allocationCounters();
+}
+
+void Engine::updateScene(float deltaTime) {
+  PROFILE_SCOPE("updateScene");
+  scene::updateSpin(_world, _jobs, deltaTime);
+  _hierarchy.update(_world, _jobs);
+  scene::updateWorldBounds(_world, _jobs);
+}
+
+bool Engine::shouldClose() {
+  if (_config.maxFrames != 0 && _frameNumber >= _config.maxFrames) {
+    return true;
+  }
+  return !_config.headless && glfwWindowShouldClose(_window);
+}
+
+void Engine::drawFrame() {
+  PROFILE_SCOPE("drawFrame");
+  // nothing can be presented while minimized, sleep until that changes
+  if (_swapChainOutOfDate && !recreateSwapChain()) {
+    glfwWaitEvents();
+    return;
+  }
+
+  rendering::FrameData &frame = _frames[_currentFrame];
+
+  // only blocks when the CPU is a full framesInFlight ahead of the GPU
+  {
+    PROFILE_SCOPE("waitForFrame");
+    vkWaitForFences(_device, 1, &frame.inFlightFence, VK_TRUE, UINT64_MAX);
+  }
+
+  // everything this frame slot wrote last time round is retired now
+  _frameRing.beginFrame(_currentFrame);
+  _frameArena.beginFrame(_currentFrame);
+  _recorder.beginFrame(_currentFrame);
+  _allocator.updateBudget();
+  destroyRetiredSwapChains(false);
+  // edited shaders are compiled and their pipelines built on the workers,
+  // this frame keeps the old ones until the new ones are ready
+  if (_shaderWatcher.poll()) {
+    _pipelines.reload();
+  }
+  _pipelines.update(_frameNumber);
+  _bindless.beginFrame(_frameNumber);
+  _assets.update(_frameNumber);
+  if (_gpuDrivenEnabled) {
+    PROFILE_SCOPE("updateGpuScene");
+    _gpuScene.update(_currentFrame, _renderInstances, _jobs);
+  }
+
+  // the profiler reads this slot's queries back in recordCommandBuffer
+  if (_config.profileInterval != 0 && _frameNumber > 0 &&
+      _frameNumber % _config.profileInterval == 0) {
+    _gpuProfiler.print(std::cout);
+    _graph.print(std::cout);
+    _pacer.print(std::cout);
+    printAllocations();
+  }
+
+  if (_config.headless) {
+    // every frame in flight owns one offscreen image, nothing to acquire
+    vkResetFences(_device, 1, &frame.inFlightFence);
+
+    vkResetCommandPool(_device, frame.commandPool, 0);
+    uint64_t uploadValue = recordCommandBuffer(
+        frame.commandBuffer, _offscreen.image(_currentFrame),
+        _offscreen.view(_currentFrame),
+        {VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE,
+         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL});
+    submitFrame(frame, {}, {}, VK_NULL_HANDLE, uploadValue);
+
+    _currentFrame = (_currentFrame + 1) % _config.framesInFlight;
+    _frameNumber++;
+    return;
+  }
+
+  uint32_t imageIndex;
+  VkResult result;
+  {
+    PROFILE_SCOPE("acquireImage");
+    result = vkAcquireNextImageKHR(_device, _swapChain, UINT64_MAX,
+                                   frame.imageAvailableSemaphore,
+                                   VK_NULL_HANDLE, &imageIndex);
+  }
+  // the semaphore is left unsignaled, the frame slot is tried again with
+  // the new swapchain. A suboptimal image is still presentable
+  if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+    _swapChainOutOfDate = true;
+    return;
+  }
+  if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+    throw std::runtime_error("failed to acquire swap chain image!");
+  }
+
+  // images can be handed out of order, so an older frame may still own it
+  if (_imagesInFlight[imageIndex] != VK_NULL_HANDLE &&
+      _imagesInFlight[imageIndex] != frame.inFlightFence) {
+    vkWaitForFences(_device, 1, &_imagesInFlight[imageIndex], VK_TRUE,
+                    UINT64_MAX);
+  }
+  _imagesInFlight[imageIndex] = frame.inFlightFence;
+
+  vkResetFences(_device, 1, &frame.inFlightFence);
+
+  vkResetCommandPool(_device, frame.commandPool, 0);
+  uint64_t uploadValue = recordCommandBuffer(
+      frame.commandBuffer, _swapChainImages[imageIndex],
+      _swapChainImageViews[imageIndex],
+      {VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE,
+       VK_IMAGE_LAYOUT_PRESENT_SRC_KHR});
+
+  VkSemaphore renderFinished = _renderFinishedSemaphores[imageIndex];
+  submitFrame(frame, frame.imageAvailableSemaphore,
+              VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, renderFinished,
+              uploadValue);
+
+  VkPresentInfoKHR presentInfo{};
+  presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+  presentInfo.waitSemaphoreCount = 1;
+  presentInfo.pWaitSemaphores = &renderFinished;
+  presentInfo.swapchainCount = 1;
+  presentInfo.pSwapchains = &_swapChain;
+  presentInfo.pImageIndices = &imageIndex;
+  _pacer.attachPresentId(presentInfo, _frameNumber);
+
+  {
+    std::lock_guard<std::mutex> lock(_graphicsQueueMutex);
+    result = vkQueuePresentKHR(_presentQueue, &presentInfo);
+  }
+  // the frame was submitted either way, only the swapchain is replaced
+  if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+    _swapChainOutOfDate = true;
+  } else if (result != VK_SUCCESS) {
+    throw std::runtime_error("failed to present swap chain image!");
+  }
+
+  _currentFrame = (_currentFrame + 1) % _config.framesInFlight;
+  _frameNumber++;
+}
+
+void Engine::submitFrame(rendering::FrameData &frame, VkSemaphore wait,
+                         VkPipelineStageFlags waitStage, VkSemaphore signal,
+                         uint64_t uploadValue) {
+  // binary semaphores ignore their value, the timeline one waits for the
+  // uploads this frame acquired
+  VkSemaphore waitSemaphores[2];
+  VkPipelineStageFlags waitStages[2];
+  uint64_t waitValues[2];
+  uint32_t waitCount = 0;
+  if (wait != VK_NULL_HANDLE) {
+    waitSemaphores[waitCount] = wait;
+    waitStages[waitCount] = waitStage;
+    waitValues[waitCount++] = 0;
+  }
+  if (uploadValue != 0) {
+    waitSemaphores[waitCount] = _uploader.timeline();
+    waitStages[waitCount] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    waitValues[waitCount++] = uploadValue;
+  }
+
+  VkTimelineSemaphoreSubmitInfo timelineInfo{};
+  timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timelineInfo.waitSemaphoreValueCount = waitCount;
+  timelineInfo.pWaitSemaphoreValues = waitValues;
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.pNext = &timelineInfo;
+  submitInfo.waitSemaphoreCount = waitCount;
+  submitInfo.pWaitSemaphores = waitSemaphores;
+  submitInfo.pWaitDstStageMask = waitStages;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &frame.commandBuffer;
+  if (signal != VK_NULL_HANDLE) {
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &signal;
+  }
+
+  std::lock_guard<std::mutex> lock(_graphicsQueueMutex);
+  if (vkQueueSubmit(_graphicsQueue, 1, &submitInfo, frame.inFlightFence) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to submit draw command buffer!");
+  }
+}
+
+uint64_t Engine::recordCommandBuffer(
+    VkCommandBuffer commandBuffer, VkImage image, VkImageView view,
+    const rendering::ResourceState &finalState) {
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+    throw std::runtime_error("failed to begin recording command buffer!");
+  }
+
+  // anything queued since last frame goes out now, what the transfer queue
+  // already finished is taken over before the draws read it
+  _gpuProfiler.beginFrame(commandBuffer, _currentFrame, _frameNumber);
+
+  _uploader.flush();
+  uint64_t uploadValue;
+  {
+    profiling::GpuScope scope(_gpuProfiler, commandBuffer, "acquire");
+    uploadValue = _uploader.recordAcquires(commandBuffer);
+  }
+
+  // the acquire semaphore is waited on at color attachment output, the
+  // graph's first barrier on the image has to chain onto that stage
+  _graph.beginFrame(_currentFrame);
+  rendering::GraphImage target = _graph.importImage(
+      "target", image, view, _swapChainImageFormat, _swapChainExtent,
+      {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE,
+       VK_IMAGE_LAYOUT_UNDEFINED},
+      finalState);
+
+  float pulse = static_cast<float>(_frameNumber % 120) / 120.0f;
+  VkClearColorValue clear = {{0.0f, 0.0f, pulse, 1.0f}};
+
+  if (_gpuDrivenEnabled) {
+    addIndirectScene(target, clear);
+  } else {
+    // every draw comes from secondaries recorded on the job system
+    _graph.addPass("scene")
+        .colorAttachment(target, VK_ATTACHMENT_LOAD_OP_CLEAR, clear)
+        .renderingFlags(VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT)
+        .execute([this](VkCommandBuffer commandBuffer,
+                        rendering::RenderGraph &) {
+          const std::vector<VkCommandBuffer> &secondaries = recordDraws();
+          if (!secondaries.empty()) {
+            vkCmdExecuteCommands(commandBuffer,
+                                 static_cast<uint32_t>(secondaries.size()),
+                                 secondaries.data());
+          }
+        });
+  }
+
+  _graph.compile();
+  _graph.execute(commandBuffer, &_gpuProfiler);
+
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record command buffer!");
+  }
+  return uploadValue;
+}
+
+const std::vector<VkCommandBuffer> &Engine::recordDraws() {
+  // still compiling in the background, the frame goes out with just the clear
+  VkPipeline pipeline = _pipelines.get("triangle");
+  if (pipeline == VK_NULL_HANDLE) {
+    return noDraws;
+  }
+  VkPipelineLayout layout = _pipelines.layout("triangle");
+
+  VkCommandBufferInheritanceRenderingInfo renderingInheritance{};
+  renderingInheritance.sType =
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+  renderingInheritance.colorAttachmentCount = 1;
+  renderingInheritance.pColorAttachmentFormats = &_swapChainImageFormat;
+  renderingInheritance.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  VkCommandBufferInheritanceInfo inheritance{};
+  inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritance.pNext = &renderingInheritance;
+  // the scene scope's statistics query is active while these execute
+  inheritance.pipelineStatistics = _gpuProfiler.statisticsFlags();
+
+  VkViewport viewport{};
+  viewport.width = static_cast<float>(_swapChainExtent.width);
+  viewport.height = static_cast<float>(_swapChainExtent.height);
+  viewport.maxDepth = 1.0f;
+  VkRect2D scissor = {{0, 0}, _swapChainExtent};
+
+  // the demo scene lives in clip space, there is no camera yet
+  scene::Frustum frustum = scene::extractFrustum(glm::mat4(1.0f));
+
+  const scene::RenderInstances &instances = _renderInstances;
+
+  auto recordBatch = [&](VkCommandBuffer secondary, uint32_t begin,
+                         uint32_t end) {
+    PROFILE_SCOPE("recordBatch");
+    // secondaries inherit no dynamic state from the primary
+    vkCmdBindPipeline(secondary, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    vkCmdSetViewport(secondary, 0, 1, &viewport);
+    vkCmdSetScissor(secondary, 0, 1, &scissor);
+    // the one set every draw indexes into, bound once per batch
+    if (_bindlessEnabled) {
+      _bindless.bind(secondary, VK_PIPELINE_BIND_POINT_GRAPHICS, layout);
+    }
+
+    // culled as one run, the survivors go out as one instanced draw
+    uint32_t *visible =
+        _frameArena.local().allocateArray<uint32_t>(end - begin);
+    uint32_t visibleCount = scene::cullSpheres(
+        frustum, &instances.spheres[begin], end - begin, visible);
+    if (visibleCount == 0) {
+      return;
+    }
+
+    memory::TransientAllocation matrices = _frameRing.allocate(
+        sizeof(glm::mat4) * visibleCount, alignof(glm::mat4));
+    auto *out = static_cast<glm::mat4 *>(matrices.mapped);
+    for (uint32_t v = 0; v < visibleCount; v++) {
+      out[v] = instances.localToWorld[begin + visible[v]];
+    }
+    vkCmdBindVertexBuffers(secondary, 0, 1, &matrices.buffer,
+                           &matrices.offset);
+    vkCmdDraw(secondary, 3, visibleCount, 0, 0);
+  };
+
+  // a few batches per thread keeps every worker busy without flooding the
+  // primary with tiny secondaries
+  uint32_t batchSize = std::max(
+      minDrawBatchSize, instances.size() / ((_jobs.threadCount() + 1) * 4));
+  return _recorder.record(_jobs, instances.size(), batchSize, inheritance,
+                          recordBatch);
+}
+
+void Engine::addIndirectScene(rendering::GraphImage target,
+                              const VkClearColorValue &clear) {
+  // still compiling in the background, the frame goes out with just the clear
+  VkPipeline cull = _pipelines.get("cull");
+  VkPipeline pipeline = _pipelines.get("triangleIndirect");
+  if (cull == VK_NULL_HANDLE || pipeline == VK_NULL_HANDLE) {
+    _graph.addPass("scene").colorAttachment(target,
+                                            VK_ATTACHMENT_LOAD_OP_CLEAR, clear);
+    return;
+  }
+  VkPipelineLayout layout = _pipelines.layout("triangleIndirect");
+
+  // the demo scene lives in clip space, there is no camera yet
+  scene::Frustum frustum = scene::extractFrustum(glm::mat4(1.0f));
+  scene::GpuSceneBuffers buffers =
+      _gpuScene.addCulling(_graph, frustum, cull, _pipelines.layout("cull"));
+
+  _graph.addPass("scene")
+      .colorAttachment(target, VK_ATTACHMENT_LOAD_OP_CLEAR, clear)
+      .read(buffers.commands, rendering::BufferUsage::IndirectRead)
+      .read(buffers.count, rendering::BufferUsage::IndirectRead)
+      .read(buffers.instances, rendering::BufferUsage::StorageReadGraphics)
+      .execute([this, pipeline, layout](VkCommandBuffer commandBuffer,
+                                        rendering::RenderGraph &) {
+        VkViewport viewport{};
+        viewport.width = static_cast<float>(_swapChainExtent.width);
+        viewport.height = static_cast<float>(_swapChainExtent.height);
+        viewport.maxDepth = 1.0f;
+        VkRect2D scissor = {{0, 0}, _swapChainExtent};
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pipeline);
+        vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+        vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+        _gpuScene.draw(commandBuffer, layout);
+      });
+}
+
+void Engine::createWindow() {
+  glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+  glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+
+  _window = glfwCreateWindow(_width, _height, "Vulkan", nullptr, nullptr);
+  glfwSetWindowUserPointer(_window, this);
+  // not every platform reports a resize through the swapchain
+  glfwSetFramebufferSizeCallback(
+      _window, [](GLFWwindow *window, int width, int height) {
+        static_cast<Engine *>(glfwGetWindowUserPointer(window))
+            ->_swapChainOutOfDate = true;
+      });
+  glfwSetKeyCallback(_window, [](GLFWwindow *window, int key, int scancode,
+                                 int action, int mods) {
+    if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
+      glfwSetWindowShouldClose(window, true);
+    }
+  });
 }
 
 void Engine::createInstance() {
+  PROFILE_SCOPE("createInstance");
   if (debug::enableValidationLayers && !debug::checkValidationLayerSupport()) {
     throw std::runtime_error("validation layers requested, but not available!");
   }
@@ -66,7 +772,7 @@ void Engine::createInstance() {
   appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
   appInfo.apiVersion = VK_API_VERSION_1_3;
 
-  auto extensions = debug::getRequiredExtensions();
+  auto extensions = debug::getRequiredExtensions(_config.headless);
 
   // instance create info
   VkInstanceCreateInfo createInfo{};
@@ -117,6 +823,7 @@ void Engine::createSurface() {
 }
 
 void Engine::pickPhysicalDevice() {
+  PROFILE_SCOPE("pickPhysicalDevice");
   uint32_t deviceCount = 0;
   vkEnumeratePhysicalDevices(_instance, &deviceCount, nullptr);
 
@@ -127,24 +834,81 @@ void Engine::pickPhysicalDevice() {
   std::vector<VkPhysicalDevice> devices(deviceCount);
   vkEnumeratePhysicalDevices(_instance, &deviceCount, devices.data());
 
-  for (const auto &device : devices) {
-    if (isDeviceSuitable(device)) {
-      _physicalDevice = device;
-      break;
+  // every device is asked everything once, side by side, and selection and
+  // setup only read the answers
+  std::vector<DeviceCapabilities> candidates(deviceCount);
+  jobs::Counter counter;
+  _jobs.parallelFor(
+      deviceCount, 1,
+      [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+          candidates[i] = queryDeviceCapabilities(devices[i]);
+        }
+      },
+      counter);
+  _jobs.wait(counter);
+
+  // the highest score wins unless the config names a device
+  uint32_t chosen = UINT32_MAX;
+  uint64_t bestScore = 0;
+  for (uint32_t i = 0; i < deviceCount; i++) {
+    const DeviceCapabilities &candidate = candidates[i];
+    bool suitable = isDeviceSuitable(candidate);
+    uint64_t score = suitable ? scoreDevice(candidate) : 0;
+    bool requested = !_config.gpu.empty() &&
+                     matchesGpuName(candidate.properties, i, _config.gpu);
+
+    std::cout << "gpu " << i << ": " << candidate.properties.deviceName
+              << " (" << deviceTypeName(candidate.properties.deviceType)
+              << ", " << (candidate.deviceLocalBytes >> 20) << " MiB)";
+    if (suitable) {
+      std::cout << " score " << score;
+    } else {
+      std::cout << " not suitable";
+    }
+    std::cout << std::endl;
+
+    if (!_config.gpu.empty()) {
+      if (requested && chosen == UINT32_MAX) {
+        if (!suitable) {
+          throw std::runtime_error("requested GPU " + _config.gpu +
+                                   " is not suitable!");
+        }
+        chosen = i;
+      }
+    } else if (suitable && (chosen == UINT32_MAX || score > bestScore)) {
+      chosen = i;
+      bestScore = score;
     }
   }
 
-  if (_physicalDevice == VK_NULL_HANDLE) {
+  if (chosen == UINT32_MAX) {
+    if (!_config.gpu.empty()) {
+      throw std::runtime_error("requested GPU " + _config.gpu +
+                               " does not exist!");
+    }
     throw std::runtime_error("failed to find a suitable GPU!");
   }
+
+  _deviceCapabilities = std::move(candidates[chosen]);
+  _physicalDevice = _deviceCapabilities.device;
+  std::cout << "using gpu " << chosen << ": "
+            << _deviceCapabilities.properties.deviceName
+            << (_config.gpu.empty() ? "" : ", as requested") << std::endl;
 }
 
 void Engine::createLogicalDevice() {
-  QueueFamilyIndices indices = findQueueFamilies(_physicalDevice);
+  PROFILE_SCOPE("createLogicalDevice");
+  const QueueFamilyIndices &indices = _deviceCapabilities.queueFamilies;
 
   std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(),
-                                            indices.presentFamily.value()};
+  std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value()};
+  for (const auto &family : {indices.presentFamily, indices.transferFamily,
+                             indices.computeFamily}) {
+    if (family.has_value()) {
+      uniqueQueueFamilies.insert(family.value());
+    }
+  }
   float queuePriority = 1.0f;
   for (uint32_t queueFamily : uniqueQueueFamilies) {
     VkDeviceQueueCreateInfo queueCreateInfo{};
@@ -155,18 +919,101 @@ void Engine::createLogicalDevice() {
     queueCreateInfos.push_back(queueCreateInfo);
   }
 
+  // optional, the GPU profiler reads pipeline statistics when the device
+  // can also inherit the query into secondaries
+  const VkPhysicalDeviceFeatures &supportedFeatures =
+      _deviceCapabilities.features;
+  _pipelineStatisticsEnabled = supportedFeatures.pipelineStatisticsQuery &&
+                               supportedFeatures.inheritedQueries;
+
   VkPhysicalDeviceFeatures deviceFeatures{};
+  deviceFeatures.pipelineStatisticsQuery = _pipelineStatisticsEnabled;
+  deviceFeatures.inheritedQueries = _pipelineStatisticsEnabled;
+
+  // the frame pacer waits for the display instead of the GPU with these
+  _presentWaitEnabled = !_config.headless && _deviceCapabilities.presentWait;
+
+  // the bindless heap indexes runtime sized arrays that are updated while
+  // bound, only requested when asked for
+  bool wantBindless = _config.bindless || _config.gpuDriven;
+  _bindlessEnabled = wantBindless && _deviceCapabilities.supportsBindless();
+  if (wantBindless && !_bindlessEnabled) {
+    std::cout << "bindless disabled, descriptor indexing is not supported"
+              << std::endl;
+  }
+
+  // the culling shader indexes the heap with push constant handles and
+  // hands the instance index to the vertex shader through firstInstance
+  _gpuDrivenEnabled = _config.gpuDriven && _bindlessEnabled &&
+                      _deviceCapabilities.supportsGpuDriven();
+  if (_config.gpuDriven && !_gpuDrivenEnabled) {
+    std::cout << "gpu driven rendering disabled, indirect count is not "
+                 "supported"
+              << std::endl;
+  }
+  deviceFeatures.multiDrawIndirect = _gpuDrivenEnabled;
+  deviceFeatures.drawIndirectFirstInstance = _gpuDrivenEnabled;
+  deviceFeatures.shaderStorageBufferArrayDynamicIndexing = _gpuDrivenEnabled;
+
+  // pipelines render without VkRenderPass objects, the render graph
+  // records its barriers with vkCmdPipelineBarrier2
+  VkPhysicalDeviceVulkan13Features features13{};
+  features13.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+  features13.dynamicRendering = VK_TRUE;
+  features13.synchronization2 = VK_TRUE;
+
+  // uploads hand their results to the graphics queue through a timeline
+  VkPhysicalDeviceVulkan12Features features12{};
+  features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  features12.timelineSemaphore = VK_TRUE;
+  features12.descriptorIndexing = _bindlessEnabled;
+  features12.runtimeDescriptorArray = _bindlessEnabled;
+  features12.descriptorBindingPartiallyBound = _bindlessEnabled;
+  features12.descriptorBindingUpdateUnusedWhilePending = _bindlessEnabled;
+  features12.descriptorBindingSampledImageUpdateAfterBind = _bindlessEnabled;
+  features12.descriptorBindingStorageBufferUpdateAfterBind = _bindlessEnabled;
+  features12.shaderSampledImageArrayNonUniformIndexing = _bindlessEnabled;
+  features12.shaderStorageBufferArrayNonUniformIndexing = _bindlessEnabled;
+  features12.drawIndirectCount = _gpuDrivenEnabled;
+  features13.pNext = &features12;
+
+  VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{};
+  presentIdFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+  presentIdFeatures.presentId = VK_TRUE;
+  VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{};
+  presentWaitFeatures.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+  presentWaitFeatures.presentWait = VK_TRUE;
+  if (_presentWaitEnabled) {
+    features12.pNext = &presentIdFeatures;
+    presentIdFeatures.pNext = &presentWaitFeatures;
+  }
 
   VkDeviceCreateInfo createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+  createInfo.pNext = &features13;
   createInfo.queueCreateInfoCount =
       static_cast<uint32_t>(queueCreateInfos.size());
   createInfo.pQueueCreateInfos = queueCreateInfos.data();
   createInfo.pEnabledFeatures = &deviceFeatures;
 
+  if (!_config.headless) {
+    _enabledExtensions = deviceExtensions;
+  }
+  for (const char *extension : optionalDeviceExtensions) {
+    if (_deviceCapabilities.hasExtension(extension)) {
+      _enabledExtensions.push_back(extension);
+    }
+  }
+  if (_presentWaitEnabled) {
+    _enabledExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+    _enabledExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+  }
+
   createInfo.enabledExtensionCount =
-      static_cast<uint32_t>(deviceExtensions.size());
-  createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+      static_cast<uint32_t>(_enabledExtensions.size());
+  createInfo.ppEnabledExtensionNames = _enabledExtensions.data();
 
   if (debug::enableValidationLayers) {
     createInfo.enabledLayerCount =
@@ -182,24 +1029,69 @@ void Engine::createLogicalDevice() {
   }
 
   vkGetDeviceQueue(_device, indices.graphicsFamily.value(), 0, &_graphicsQueue);
-  vkGetDeviceQueue(_device, indices.presentFamily.value(), 0, &_presentQueue);
+  if (indices.presentFamily.has_value()) {
+    vkGetDeviceQueue(_device, indices.presentFamily.value(), 0,
+                     &_presentQueue);
+  }
+
+  _transferQueue = _graphicsQueue;
+  if (indices.transferFamily.has_value()) {
+    vkGetDeviceQueue(_device, indices.transferFamily.value(), 0,
+                     &_transferQueue);
+  }
+  _computeQueue = _graphicsQueue;
+  if (indices.computeFamily.has_value()) {
+    vkGetDeviceQueue(_device, indices.computeFamily.value(), 0,
+                     &_computeQueue);
+  }
+
+  std::cout << "queues: graphics " << indices.graphicsFamily.value()
+            << ", transfer "
+            << (indices.transferFamily ? "dedicated" : "shared")
+            << ", compute " << (indices.computeFamily ? "async" : "shared")
+            << std::endl;
+}
+
+void Engine::createUploader() {
+  const QueueFamilyIndices &indices = _deviceCapabilities.queueFamilies;
+
+  rendering::UploadQueueInfo transfer;
+  transfer.queue = _transferQueue;
+  transfer.family =
+      indices.transferFamily.value_or(indices.graphicsFamily.value());
+  if (!indices.transferFamily.has_value()) {
+    transfer.submitMutex = &_graphicsQueueMutex;
+  }
+
+  _uploader.create(_allocator, _physicalDevice, transfer,
+                   indices.graphicsFamily.value(), _config.stagingSize);
+}
+
+void Engine::createAssets() {
+  _assets.create(_allocator, _uploader, _config.assetBudget,
+                 _config.ioThreads, _config.framesInFlight,
+                 _bindlessEnabled ? &_bindless : nullptr);
+  if (!_config.assetPath.empty()) {
+    _assets.mount(_config.assetPath);
+  }
 }
 
 void Engine::createSwapChain() {
-  rendering::SwapchainSupportDetails swapChainSupport =
-      querySwapChainSupport(_physicalDevice);
+  PROFILE_SCOPE("createSwapChain");
+  // formats and present modes were asked for with the device, only the
+  // extent and transform follow the window
+  rendering::SwapchainSupportDetails &swapChainSupport =
+      _deviceCapabilities.swapChainSupport;
+  vkGetPhysicalDeviceSurfaceCapabilitiesKHR(_physicalDevice, _surface,
+                                            &swapChainSupport.capabilities);
 
   VkSurfaceFormatKHR surfaceFormat =
       chooseSwapSurfaceFormat(swapChainSupport.formats);
   VkPresentModeKHR presentMode =
-      chooseSwapPresentMode(swapChainSupport.presentModes);
+      _pacer.choosePresentMode(swapChainSupport.presentModes);
   VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
-
-  uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
-  if (swapChainSupport.capabilities.maxImageCount > 0 &&
-      imageCount > swapChainSupport.capabilities.maxImageCount) {
-    imageCount = swapChainSupport.capabilities.maxImageCount;
-  }
+  uint32_t imageCount =
+      _pacer.chooseImageCount(swapChainSupport.capabilities);
 
   VkSwapchainCreateInfoKHR createInfo{};
   createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -211,7 +1103,7 @@ void Engine::createSwapChain() {
   createInfo.imageArrayLayers = 1;
   createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-  QueueFamilyIndices indices = findQueueFamilies(_physicalDevice);
+  const QueueFamilyIndices &indices = _deviceCapabilities.queueFamilies;
   uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value(),
                                    indices.presentFamily.value()};
 
@@ -227,7 +1119,9 @@ void Engine::createSwapChain() {
   createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
   createInfo.presentMode = presentMode;
   createInfo.clipped = VK_TRUE;
-  createInfo.oldSwapchain = VK_NULL_HANDLE;
+  // lets the implementation hand resources over, the old one is retired
+  // either way and only good for presenting what was already acquired
+  createInfo.oldSwapchain = _swapChain;
 
   if (vkCreateSwapchainKHR(_device, &createInfo, nullptr, &_swapChain) !=
       VK_SUCCESS) {
@@ -241,22 +1135,383 @@ void Engine::createSwapChain() {
 
   _swapChainImageFormat = surfaceFormat.format;
   _swapChainExtent = extent;
+
+  _swapChainImageViews.resize(_swapChainImages.size());
+  for (size_t i = 0; i < _swapChainImages.size(); i++) {
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = _swapChainImages[i];
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = _swapChainImageFormat;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(_device, &viewInfo, nullptr,
+                          &_swapChainImageViews[i]) != VK_SUCCESS) {
+      throw std::runtime_error("failed to create image views!");
+    }
+  }
+
+  // per image, a present may still wait on it after its frame slot has
+  // moved on
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  _renderFinishedSemaphores.resize(_swapChainImages.size());
+  for (auto &semaphore : _renderFinishedSemaphores) {
+    if (vkCreateSemaphore(_device, &semaphoreInfo, nullptr, &semaphore) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create frame sync objects!");
+    }
+  }
+
+  _imagesInFlight.assign(_swapChainImages.size(), VK_NULL_HANDLE);
+}
+
+bool Engine::recreateSwapChain() {
+  PROFILE_SCOPE("recreateSwapChain");
+  // nothing presents an offscreen image, once the frames in flight are
+  // done with them nothing uses them at all
+  if (_config.headless) {
+    for (auto &frame : _frames) {
+      vkWaitForFences(_device, 1, &frame.inFlightFence, VK_TRUE, UINT64_MAX);
+    }
+    _offscreen.destroy();
+    createOffscreenTargets();
+    _swapChainOutOfDate = false;
+    return true;
+  }
+
+  int width = 0;
+  int height = 0;
+  glfwGetFramebufferSize(_window, &width, &height);
+  if (width == 0 || height == 0) {
+    return false;
+  }
+
+  // no wait idle, the old images are released once the frames that were
+  // recorded against them have retired
+  RetiredSwapChain retired;
+  retired.swapChain = _swapChain;
+  retired.views = std::move(_swapChainImageViews);
+  retired.renderFinishedSemaphores = std::move(_renderFinishedSemaphores);
+  retired.frameNumber = _frameNumber;
+  _retiredSwapChains.push_back(std::move(retired));
+  _swapChainImageViews.clear();
+  _renderFinishedSemaphores.clear();
+
+  // the formats are the ones cached with the device, so the image format
+  // and the pipelines built for it stay valid
+  createSwapChain();
+  _pacer.swapchainChanged(_frameNumber);
+
+  _swapChainOutOfDate = false;
+  return true;
+}
+
+void Engine::destroyRetiredSwapChains(bool all) {
+  // frame N's fence covers everything submitted before frame N. One more
+  // frame of slack covers the present, which no fence tracks
+  auto retire = [&](const RetiredSwapChain &retired) {
+    if (!all &&
+        retired.frameNumber + _config.framesInFlight > _frameNumber) {
+      return false;
+    }
+    for (VkImageView view : retired.views) {
+      vkDestroyImageView(_device, view, nullptr);
+    }
+    for (VkSemaphore semaphore : retired.renderFinishedSemaphores) {
+      vkDestroySemaphore(_device, semaphore, nullptr);
+    }
+    vkDestroySwapchainKHR(_device, retired.swapChain, nullptr);
+    return true;
+  };
+  _retiredSwapChains.erase(std::remove_if(_retiredSwapChains.begin(),
+                                          _retiredSwapChains.end(), retire),
+                           _retiredSwapChains.end());
+}
+
+void Engine::createOffscreenTargets() {
+  // RGBA8 is required for color attachments and transfers on every device
+  _offscreen.create(_allocator, VK_FORMAT_R8G8B8A8_UNORM,
+                    {_config.width, _config.height}, _config.framesInFlight);
+
+  _swapChainImageFormat = _offscreen.format();
+  _swapChainExtent = _offscreen.extent();
+}
+
+void Engine::createCommands() {
+  const QueueFamilyIndices &indices = _deviceCapabilities.queueFamilies;
+
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = indices.graphicsFamily.value();
+
+  _frames.resize(_config.framesInFlight);
+  for (auto &frame : _frames) {
+    if (vkCreateCommandPool(_device, &poolInfo, nullptr, &frame.commandPool) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create command pool!");
+    }
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = frame.commandPool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(_device, &allocInfo, &frame.commandBuffer) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate command buffers!");
+    }
+  }
+
+  // secondaries, one pool per frame for every thread that runs jobs
+  _recorder.create(_device, indices.graphicsFamily.value(),
+                   _config.framesInFlight, _jobs.threadCount() + 1);
+
+  _gpuProfiler.create(_physicalDevice, _device,
+                      indices.graphicsFamily.value(), _config.framesInFlight,
+                      _pipelineStatisticsEnabled);
+  _graph.create(_allocator, _config.framesInFlight);
+}
+
+void Engine::createPipelines() {
+  PROFILE_SCOPE("createPipelines");
+  // loaded from disk while the device was being created
+  _pipelineCache.create(_physicalDevice, _device);
+  _pipelines.init(_device, _shaderCompiler, _pipelineCache, _jobs,
+                  _config.framesInFlight);
+
+  rendering::PipelineManifest manifest;
+
+  rendering::GraphicsPipelineDesc triangle;
+  triangle.name = "triangle";
+  triangle.vertex.path = "triangle.vert";
+  triangle.vertex.stage = VK_SHADER_STAGE_VERTEX_BIT;
+  triangle.fragment.path = "triangle.frag";
+  triangle.fragment.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  // one matrix per instance out of the frame ring, a column per location
+  triangle.vertexBindings = {
+      {0, sizeof(glm::mat4), VK_VERTEX_INPUT_RATE_INSTANCE}};
+  for (uint32_t column = 0; column < 4; column++) {
+    triangle.vertexAttributes.push_back(
+        {column, 0, VK_FORMAT_R32G32B32A32_SFLOAT,
+         static_cast<uint32_t>(sizeof(glm::vec4)) * column});
+  }
+  triangle.colorFormats = {_swapChainImageFormat};
+  if (_bindlessEnabled) {
+    triangle.setLayouts = {_bindless.layout()};
+  }
+  manifest.graphics.push_back(triangle);
+
+  if (_gpuDrivenEnabled) {
+    rendering::GraphicsPipelineDesc indirect = triangle;
+    indirect.name = "triangleIndirect";
+    indirect.vertex.path = "triangleIndirect.vert";
+    indirect.vertexBindings.clear();
+    indirect.vertexAttributes.clear();
+    indirect.pushConstantSize = sizeof(uint32_t);
+    manifest.graphics.push_back(indirect);
+
+    rendering::ComputePipelineDesc cull;
+    cull.name = "cull";
+    cull.shader.path = "cull.comp";
+    cull.shader.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    cull.setLayouts = {_bindless.layout()};
+    cull.pushConstantSize = sizeof(scene::CullConstants);
+    manifest.compute.push_back(cull);
+  }
+
+  _pipelines.prewarm(manifest);
+
+  if (_config.hotReload) {
+    _shaderWatcher.create(_config.shaderDir);
+  }
+}
+
+void Engine::createScene() {
+  PROFILE_SCOPE("createScene");
+  // a square grid of spinning triangles filling the screen, each carrying
+  // a smaller one around with it
+  uint32_t rootCount = (_config.drawCount + 1) / 2;
+  uint32_t side = static_cast<uint32_t>(
+      std::ceil(std::sqrt(static_cast<float>(rootCount))));
+  float cell = 2.0f / static_cast<float>(side);
+
+  // the triangle's corners are all within 0.71 of its origin
+  scene::Bounds bounds;
+  bounds.sphere = {0.0f, 0.0f, 0.0f, 0.71f};
+
+  for (uint32_t i = 0; i < rootCount; i++) {
+    scene::Transform transform;
+    transform.position = {-1.0f + cell * (static_cast<float>(i % side) + 0.5f),
+                          -1.0f + cell * (static_cast<float>(i / side) + 0.5f),
+                          0.0f};
+    transform.scale = glm::vec3(cell * 0.6f);
+
+    scene::Spin spin;
+    spin.speed = 0.5f + static_cast<float>(i % 7) * 0.25f;
+
+    ecs::Entity root =
+        _world.create(transform, spin, bounds, scene::LocalToWorld{},
+                      scene::WorldBounds{}, scene::Renderable{});
+
+    if (2 * i + 1 < _config.drawCount) {
+      scene::Transform orbit;
+      orbit.position = {0.8f, 0.0f, 0.0f};
+      orbit.scale = glm::vec3(0.35f);
+
+      _world.create(orbit, scene::Parent{root}, bounds, scene::LocalToWorld{},
+                    scene::WorldBounds{}, scene::Renderable{});
+    }
+  }
+}
+
+void Engine::createGpuScene() {
+  PROFILE_SCOPE("createGpuScene");
+  const VkPhysicalDeviceProperties &properties =
+      _deviceCapabilities.properties;
+
+  // every instance may survive culling, and the demo scene never grows
+  uint32_t maxInstances =
+      std::min(std::max(_config.drawCount, 1u),
+               properties.limits.maxDrawIndirectCount);
+  _gpuScene.create(_allocator, _uploader, _bindless, _config.framesInFlight,
+                   maxInstances);
+
+  // the built-in triangle, its corners come from gl_VertexIndex
+  scene::MeshLod triangle;
+  triangle.indexCount = 3;
+  _gpuScene.addMesh({0, 1, 2}, {triangle});
+  _uploader.flush();
+}
+
+void Engine::createSyncObjects() {
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+  // start signaled so the first wait on every frame returns immediately
+  VkFenceCreateInfo fenceInfo{};
+  fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+
+  for (auto &frame : _frames) {
+    if (vkCreateSemaphore(_device, &semaphoreInfo, nullptr,
+                          &frame.imageAvailableSemaphore) != VK_SUCCESS ||
+        vkCreateFence(_device, &fenceInfo, nullptr, &frame.inFlightFence) !=
+            VK_SUCCESS) {
+      throw std::runtime_error("failed to create frame sync objects!");
+    }
+  }
+}
+
+bool DeviceCapabilities::hasExtension(const char *name) const {
+  for (const VkExtensionProperties &extension : extensions) {
+    if (strcmp(extension.extensionName, name) == 0) {
+      return true;
+    }
+  }
+  return false;
 }
 
-bool Engine::isDeviceSuitable(VkPhysicalDevice device) {
-  QueueFamilyIndices indices = findQueueFamilies(device);
+bool DeviceCapabilities::supportsBindless() const {
+  return features12.descriptorIndexing && features12.runtimeDescriptorArray &&
+         features12.descriptorBindingPartiallyBound &&
+         features12.descriptorBindingUpdateUnusedWhilePending &&
+         features12.descriptorBindingSampledImageUpdateAfterBind &&
+         features12.descriptorBindingStorageBufferUpdateAfterBind &&
+         features12.shaderSampledImageArrayNonUniformIndexing &&
+         features12.shaderStorageBufferArrayNonUniformIndexing;
+}
+
+bool DeviceCapabilities::supportsGpuDriven() const {
+  return supportsBindless() && features12.drawIndirectCount &&
+         features.multiDrawIndirect && features.drawIndirectFirstInstance &&
+         features.shaderStorageBufferArrayDynamicIndexing;
+}
+
+DeviceCapabilities Engine::queryDeviceCapabilities(VkPhysicalDevice device) {
+  PROFILE_SCOPE("queryDeviceCapabilities");
+  DeviceCapabilities capabilities;
+  capabilities.device = device;
+  vkGetPhysicalDeviceProperties(device, &capabilities.properties);
+  capabilities.queueFamilies = findQueueFamilies(device);
+
+  vkGetPhysicalDeviceMemoryProperties(device, &capabilities.memory);
+  for (uint32_t i = 0; i < capabilities.memory.memoryHeapCount; i++) {
+    const VkMemoryHeap &heap = capabilities.memory.memoryHeaps[i];
+    if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      capabilities.deviceLocalBytes =
+          std::max(capabilities.deviceLocalBytes, heap.size);
+    }
+  }
+
+  uint32_t extensionCount = 0;
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       nullptr);
+  capabilities.extensions.resize(extensionCount);
+  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
+                                       capabilities.extensions.data());
+
+  // the 1.2 and 1.3 structs may only be chained for devices that know them
+  VkPhysicalDeviceFeatures2 features{};
+  features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+  capabilities.features12.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+  capabilities.features13.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES;
+  VkPhysicalDevicePresentIdFeaturesKHR presentId{};
+  presentId.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+  VkPhysicalDevicePresentWaitFeaturesKHR presentWait{};
+  presentWait.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+  bool vulkan13 = capabilities.properties.apiVersion >= VK_API_VERSION_1_3;
+  bool presentWaitAvailable =
+      capabilities.hasExtension(VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+      capabilities.hasExtension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+  void **next = &features.pNext;
+  if (vulkan13) {
+    *next = &capabilities.features13;
+    capabilities.features13.pNext = &capabilities.features12;
+    next = &capabilities.features12.pNext;
+  }
+  if (presentWaitAvailable) {
+    *next = &presentId;
+    presentId.pNext = &presentWait;
+  }
+  vkGetPhysicalDeviceFeatures2(device, &features);
+
+  capabilities.features = features.features;
+  capabilities.features12.pNext = nullptr;
+  capabilities.features13.pNext = nullptr;
+  capabilities.presentWait =
+      presentWaitAvailable && presentId.presentId && presentWait.presentWait;
+
+  if (_surface != VK_NULL_HANDLE) {
+    capabilities.swapChainSupport = querySwapChainSupport(device);
+  }
+  return capabilities;
+}
 
-  bool extensionsSupported = checkDeviceExtensionSupport(device);
+bool Engine::isDeviceSuitable(const DeviceCapabilities &capabilities) {
+  if (!checkDeviceFeatureSupport(capabilities)) {
+    return false;
+  }
 
-  bool swapChainAdequate = false;
-  if (extensionsSupported) {
-    rendering::SwapchainSupportDetails swapChainSupport =
-        querySwapChainSupport(device);
-    swapChainAdequate = !swapChainSupport.formats.empty() &&
-                        !swapChainSupport.presentModes.empty();
+  if (_config.headless) {
+    return capabilities.queueFamilies.isComplete(false);
   }
 
-  return indices.isComplete() && extensionsSupported && swapChainAdequate;
+  const rendering::SwapchainSupportDetails &swapChainSupport =
+      capabilities.swapChainSupport;
+  return capabilities.queueFamilies.isComplete() &&
+         checkDeviceExtensionSupport(capabilities) &&
+         !swapChainSupport.formats.empty() &&
+         !swapChainSupport.presentModes.empty();
 }
 
 QueueFamilyIndices Engine::findQueueFamilies(VkPhysicalDevice device) {
@@ -265,49 +1520,124 @@ QueueFamilyIndices Engine::findQueueFamilies(VkPhysicalDevice device) {
   uint32_t queueFamilyCount = 0;
   vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
 
-  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  // scratch from the calling thread, devices are queried on workers
+  VkQueueFamilyProperties *queueFamilies =
+      _frameArena.local().allocateArray<VkQueueFamilyProperties>(
+          queueFamilyCount);
   vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount,
-                                           queueFamilies.data());
+                                           queueFamilies);
+
+  // every family is looked at, the dedicated ones tend to come last
+  for (uint32_t i = 0; i < queueFamilyCount; i++) {
+    VkQueueFlags flags = queueFamilies[i].queueFlags;
+    bool graphics = flags & VK_QUEUE_GRAPHICS_BIT;
+    bool compute = flags & VK_QUEUE_COMPUTE_BIT;
 
-  int i = 0;
-  for (const auto &queueFamily : queueFamilies) {
-    if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+    if (graphics && !indices.graphicsFamily.has_value()) {
       indices.graphicsFamily = i;
     }
-
-    VkBool32 presentSupport = false;
-    vkGetPhysicalDeviceSurfaceSupportKHR(device, i, _surface, &presentSupport);
-    if (presentSupport) {
-      indices.presentFamily = i;
+    // a family with neither graphics nor compute is usually the copy engine
+    if ((flags & VK_QUEUE_TRANSFER_BIT) && !graphics && !compute &&
+        !indices.transferFamily.has_value()) {
+      indices.transferFamily = i;
     }
-
-    if (indices.isComplete()) {
-      break;
+    if (compute && !graphics && !indices.computeFamily.has_value()) {
+      indices.computeFamily = i;
     }
 
-    i++;
+    if (_surface != VK_NULL_HANDLE) {
+      VkBool32 presentSupport = false;
+      vkGetPhysicalDeviceSurfaceSupportKHR(device, i, _surface,
+                                           &presentSupport);
+      // presenting from the graphics queue saves an ownership transfer
+      if (presentSupport && (!indices.presentFamily.has_value() ||
+                             indices.graphicsFamily == i)) {
+        indices.presentFamily = i;
+      }
+    }
   }
 
   return indices;
 }
 
-bool Engine::checkDeviceExtensionSupport(VkPhysicalDevice device) {
-  uint32_t extensionCount;
-  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
-                                       nullptr);
+bool Engine::checkDeviceExtensionSupport(
+    const DeviceCapabilities &capabilities) {
+  for (const char *required : deviceExtensions) {
+    if (!capabilities.hasExtension(required)) {
+      return false;
+    }
+  }
+  return true;
+}
 
-  std::vector<VkExtensionProperties> availableExtensions(extensionCount);
-  vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount,
-                                       availableExtensions.data());
+bool Engine::checkDeviceFeatureSupport(
+    const DeviceCapabilities &capabilities) {
+  // pipelines render without VkRenderPass objects, the render graph
+  // records its barriers with vkCmdPipelineBarrier2 and uploads hand their
+  // results to the graphics queue through a timeline
+  return capabilities.properties.apiVersion >= VK_API_VERSION_1_3 &&
+         capabilities.features13.dynamicRendering &&
+         capabilities.features13.synchronization2 &&
+         capabilities.features12.timelineSemaphore;
+}
 
-  std::set<std::string> requiredExtensions(deviceExtensions.begin(),
-                                           deviceExtensions.end());
+uint64_t Engine::scoreDevice(const DeviceCapabilities &capabilities) {
+  uint64_t score = 0;
+
+  // the type outweighs everything else, an integrated GPU shares the
+  // CPU's memory bandwidth however well it scores otherwise
+  switch (capabilities.properties.deviceType) {
+  case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+    score += discreteGpuScore;
+    break;
+  case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+    score += integratedGpuScore;
+    break;
+  case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+    score += virtualGpuScore;
+    break;
+  default:
+    break;
+  }
+
+  // then its own memory, a point per MiB up to the cap so a big heap
+  // can't make up for the wrong type
+  score += std::min<uint64_t>(capabilities.deviceLocalBytes >> 20,
+                              memoryScoreCap);
+
+  // queues that let uploads and compute overlap the frame
+  if (capabilities.queueFamilies.transferFamily.has_value()) {
+    score += queueFamilyScore;
+  }
+  if (capabilities.queueFamilies.computeFamily.has_value()) {
+    score += queueFamilyScore;
+  }
 
-  for (const auto &extension : availableExtensions) {
-    requiredExtensions.erase(extension.extensionName);
+  // the paths behind --bindless and --gpu-driven, and pacing on the
+  // display rather than the GPU
+  if (capabilities.supportsBindless()) {
+    score += featureScore;
   }
+  if (capabilities.supportsGpuDriven()) {
+    score += featureScore;
+  }
+  if (capabilities.presentWait) {
+    score += featureScore;
+  }
+  if (capabilities.features.pipelineStatisticsQuery &&
+      capabilities.features.inheritedQueries) {
+    score += featureScore / 4;
+  }
+  return score;
+}
 
-  return requiredExtensions.empty();
+bool Engine::isExtensionEnabled(const char *extension) const {
+  for (const char *enabled : _enabledExtensions) {
+    if (strcmp(enabled, extension) == 0) {
+      return true;
+    }
+  }
+  return false;
 }
 
 rendering::SwapchainSupportDetails
@@ -352,17 +1682,6 @@ VkSurfaceFormatKHR Engine::chooseSwapSurfaceFormat(
   return availableFormats[0];
 }
 
-VkPresentModeKHR Engine::chooseSwapPresentMode(
-    const std::vector<VkPresentModeKHR> &availablePresentModes) {
-  for (const auto &availablePresentMode : availablePresentModes) {
-    if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-      return availablePresentMode;
-    }
-  }
-
-  return VK_PRESENT_MODE_FIFO_KHR;
-}
-
 VkExtent2D
 Engine::chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities) {
   if (capabilities.currentExtent.width != UINT32_MAX) {
@@ -385,4 +1704,26 @@ Engine::chooseSwapExtent(const VkSurfaceCapabilitiesKHR &capabilities) {
   return actualExtent;
 }
 
+void Engine::captureFrame(const std::string &path) {
+  uint32_t lastFrame =
+      (_currentFrame + _config.framesInFlight - 1) % _config.framesInFlight;
+  std::vector<uint8_t> pixels = _offscreen.readback(
+      _graphicsQueue, _deviceCapabilities.queueFamilies.graphicsFamily.value(),
+      lastFrame);
+
+  std::ofstream file(path, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("failed to open capture file!");
+  }
+
+  VkExtent2D extent = _offscreen.extent();
+  file << "P6\n" << extent.width << " " << extent.height << "\n255\n";
+  for (size_t i = 0; i < pixels.size(); i += 4) {
+    file.write(reinterpret_cast<const char *>(&pixels[i]), 3);
+  }
+
+  std::cout << "captured frame " << _frameNumber << " to " << path
+            << std::endl;
+}
+
 }; // namespace engine
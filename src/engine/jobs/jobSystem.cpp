@@ -0,0 +1,238 @@
+#include "jobs/jobSystem.hpp"
+#include "profiling/cpuProfiler.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace jobs {
+
+namespace {
+
+thread_local JobSystem *t_system = nullptr;
+thread_local uint32_t t_workerIndex = 0;
+thread_local uint32_t t_random = 0x9e3779b9u;
+thread_local bool t_helpWhileWaiting = true;
+
+uint32_t nextRandom() {
+  // xorshift, only used to spread thieves across victims
+  t_random ^= t_random << 13;
+  t_random ^= t_random >> 17;
+  t_random ^= t_random << 5;
+  return t_random;
+}
+
+} // namespace
+
+JobSystem::~JobSystem() { destroy(); }
+
+void JobSystem::init(uint32_t threadCount) {
+  if (threadCount == 0) {
+    // hardware_concurrency() may be 0 when unknown, one worker then
+    threadCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+  }
+
+  _stopping = false;
+  for (uint32_t i = 0; i < threadCount; i++) {
+    _deques.push_back(std::make_unique<WorkStealingDeque<Job *>>());
+  }
+  for (uint32_t i = 0; i < threadCount; i++) {
+    _workers.emplace_back(&JobSystem::workerLoop, this, i + 1);
+  }
+
+  std::cout << "job system running " << threadCount << " workers"
+            << std::endl;
+}
+
+void JobSystem::destroy() {
+  if (_workers.empty()) {
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_sleepMutex);
+    _stopping = true;
+  }
+  _wake.notify_all();
+  for (auto &worker : _workers) {
+    worker.join();
+  }
+  _workers.clear();
+
+  // nothing may be left behind holding a pointer to a counter
+  while (tryRunOne()) {
+  }
+  _deques.clear();
+}
+
+void JobSystem::run(JobFunction job, Counter *counter) {
+  if (counter != nullptr) {
+    counter->_value.fetch_add(1, std::memory_order_relaxed);
+  }
+  schedule(_jobPool.create(Job{std::move(job), counter}));
+}
+
+void JobSystem::runAfter(Counter &dependency, JobFunction job,
+                         Counter *counter) {
+  if (counter != nullptr) {
+    counter->_value.fetch_add(1, std::memory_order_relaxed);
+  }
+  Job *parked = _jobPool.create(Job{std::move(job), counter});
+
+  {
+    std::lock_guard<std::mutex> lock(dependency._mutex);
+    if (dependency._value.load(std::memory_order_acquire) != 0) {
+      dependency._continuations.push_back(parked);
+      return;
+    }
+  }
+  schedule(parked);
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t batchSize,
+                            RangeFunction job, Counter &counter) {
+  batchSize = std::max(1u, batchSize);
+  auto shared = std::make_shared<RangeFunction>(std::move(job));
+
+  for (uint32_t begin = 0; begin < count; begin += batchSize) {
+    uint32_t end = std::min(count, begin + batchSize);
+    run([shared, begin, end]() { (*shared)(begin, end); }, &counter);
+  }
+}
+
+void JobSystem::wait(Counter &counter) {
+  while (!counter.done()) {
+    if (!t_helpWhileWaiting || !tryRunOne()) {
+      std::this_thread::yield();
+    }
+  }
+
+  // the last job may still be inside finish(), don't let the caller free
+  // the counter under it
+  std::exception_ptr error;
+  {
+    std::lock_guard<std::mutex> lock(counter._mutex);
+    error = counter._error;
+    counter._error = nullptr;
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+uint32_t JobSystem::workerIndex() { return t_workerIndex; }
+
+void JobSystem::setHelpWhileWaiting(bool help) { t_helpWhileWaiting = help; }
+
+void JobSystem::workerLoop(uint32_t index) {
+  t_system = this;
+  t_workerIndex = index;
+  t_random ^= index * 0x85ebca6bu;
+  PROFILE_THREAD("worker " + std::to_string(index));
+
+  while (true) {
+    if (tryRunOne()) {
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(_sleepMutex);
+    _sleeping.fetch_add(1);
+    _wake.wait(lock, [this]() { return _stopping || _queued.load() > 0; });
+    _sleeping.fetch_sub(1);
+    if (_stopping) {
+      return;
+    }
+  }
+}
+
+void JobSystem::schedule(Job *job) {
+  // counted before it is visible so a thief never takes the count below
+  // zero. Pairs with the sleeping count in workerLoop(), one of the two
+  // sides always sees the other's increment
+  _queued.fetch_add(1);
+
+  bool pushed = false;
+  if (t_system == this) {
+    pushed = _deques[t_workerIndex - 1]->push(job);
+  }
+  if (!pushed) {
+    std::lock_guard<std::mutex> lock(_injectionMutex);
+    _injection.push_back(job);
+  }
+
+  if (_sleeping.load() > 0) {
+    { std::lock_guard<std::mutex> lock(_sleepMutex); }
+    _wake.notify_one();
+  }
+}
+
+bool JobSystem::tryRunOne() {
+  Job *job = nullptr;
+  bool found = t_system == this && _deques[t_workerIndex - 1]->pop(job);
+
+  if (!found && _queued.load(std::memory_order_relaxed) > 0) {
+    {
+      std::lock_guard<std::mutex> lock(_injectionMutex);
+      if (!_injection.empty()) {
+        job = _injection.front();
+        _injection.pop_front();
+        found = true;
+      }
+    }
+
+    size_t victimCount = _deques.size();
+    size_t start = victimCount > 0 ? nextRandom() % victimCount : 0;
+    for (size_t i = 0; !found && i < victimCount; i++) {
+      found = _deques[(start + i) % victimCount]->steal(job);
+    }
+  }
+
+  if (!found) {
+    return false;
+  }
+  _queued.fetch_sub(1);
+  execute(job);
+  return true;
+}
+
+void JobSystem::execute(Job *job) {
+  std::exception_ptr error;
+  try {
+    PROFILE_SCOPE("job");
+    job->function();
+  } catch (...) {
+    error = std::current_exception();
+  }
+
+  if (job->counter != nullptr) {
+    finish(*job->counter, error);
+  } else if (error) {
+    // nobody waits on this job, so nobody else would ever see the error
+    try {
+      std::rethrow_exception(error);
+    } catch (const std::exception &e) {
+      std::cerr << "job failed: " << e.what() << std::endl;
+    } catch (...) {
+      std::cerr << "job failed" << std::endl;
+    }
+  }
+  _jobPool.destroy(job);
+}
+
+void JobSystem::finish(Counter &counter, std::exception_ptr error) {
+  std::vector<Job *> ready;
+  {
+    std::lock_guard<std::mutex> lock(counter._mutex);
+    if (error && !counter._error) {
+      counter._error = error;
+    }
+    if (counter._value.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      ready.swap(counter._continuations);
+    }
+  }
+
+  for (Job *job : ready) {
+    schedule(job);
+  }
+}
+
+} // namespace jobs
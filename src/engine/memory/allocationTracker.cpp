@@ -0,0 +1,70 @@
+#include "memory/allocationTracker.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace memory {
+
+namespace {
+
+std::atomic<bool> g_tracking{false};
+std::atomic<uint64_t> g_count{0};
+std::atomic<uint64_t> g_bytes{0};
+thread_local AllocationCounters t_counters;
+
+} // namespace
+
+#ifdef ENGINE_TRACK_ALLOCATIONS
+
+namespace {
+
+void *trackedAllocate(size_t size) {
+  if (g_tracking.load(std::memory_order_relaxed)) {
+    g_count.fetch_add(1, std::memory_order_relaxed);
+    g_bytes.fetch_add(size, std::memory_order_relaxed);
+    t_counters.count++;
+    t_counters.bytes += size;
+  }
+  // malloc(0) may return null, operator new may not
+  void *memory = std::malloc(size == 0 ? 1 : size);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+} // namespace
+
+bool allocationTrackingAvailable() { return true; }
+
+#else
+
+bool allocationTrackingAvailable() { return false; }
+
+#endif
+
+void trackAllocations(bool enabled) { g_tracking = enabled; }
+
+AllocationCounters allocationCounters() {
+  AllocationCounters counters;
+  counters.count = g_count.load();
+  counters.bytes = g_bytes.load();
+  return counters;
+}
+
+AllocationCounters threadAllocationCounters() { return t_counters; }
+
+} // namespace memory
+
+#ifdef ENGINE_TRACK_ALLOCATIONS
+
+// the nothrow forms call these, aligned new is left to the runtime
+void *operator new(size_t size) { return memory::trackedAllocate(size); }
+void *operator new[](size_t size) { return memory::trackedAllocate(size); }
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+void operator delete[](void *pointer) noexcept { std::free(pointer); }
+void operator delete(void *pointer, size_t) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, size_t) noexcept { std::free(pointer); }
+
+#endif
@@ -0,0 +1,479 @@
+#include "memory/allocator.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <stdexcept>
+
+namespace memory {
+
+namespace {
+
+// smallest range a block hands out, keeps free lists short for tiny buffers
+constexpr VkDeviceSize minBuddySize = 256;
+constexpr VkDeviceSize largeHeapBlockSize = 64ull * 1024 * 1024;
+constexpr VkDeviceSize smallHeapThreshold = 1024ull * 1024 * 1024;
+
+VkDeviceSize roundDownToPowerOfTwo(VkDeviceSize value) {
+  VkDeviceSize result = 1;
+  while (result * 2 <= value) {
+    result *= 2;
+  }
+  return result;
+}
+
+} // namespace
+
+BuddyBlock::BuddyBlock(VkDeviceMemory memory, VkDeviceSize size,
+                       VkDeviceSize minSize, void *mapped)
+    : _memory(memory), _size(size), _minSize(minSize), _freeBytes(size),
+      _mapped(mapped), _maxOrder(0) {
+  while (orderSize(_maxOrder) < size) {
+    _maxOrder++;
+  }
+  _freeLists.resize(_maxOrder + 1);
+  _freeLists[_maxOrder].insert(0);
+}
+
+bool BuddyBlock::allocate(VkDeviceSize size, VkDeviceSize alignment,
+                          VkDeviceSize &offset, uint8_t &order) {
+  // every range of a given order is aligned to its own size, so asking for
+  // at least `alignment` bytes also satisfies the alignment
+  VkDeviceSize needed = std::max({size, alignment, _minSize});
+  uint8_t wanted = 0;
+  while (orderSize(wanted) < needed) {
+    wanted++;
+  }
+  if (wanted > _maxOrder) {
+    return false;
+  }
+
+  uint8_t current = wanted;
+  while (current <= _maxOrder && _freeLists[current].empty()) {
+    current++;
+  }
+  if (current > _maxOrder) {
+    return false;
+  }
+
+  offset = *_freeLists[current].begin();
+  _freeLists[current].erase(_freeLists[current].begin());
+
+  // split down, keeping the lower half and freeing the upper buddy
+  while (current > wanted) {
+    current--;
+    _freeLists[current].insert(offset + orderSize(current));
+  }
+
+  order = wanted;
+  _freeBytes -= orderSize(wanted);
+  return true;
+}
+
+void BuddyBlock::free(VkDeviceSize offset, uint8_t order) {
+  _freeBytes += orderSize(order);
+
+  while (order < _maxOrder) {
+    VkDeviceSize buddy = offset ^ orderSize(order);
+    auto it = _freeLists[order].find(buddy);
+    if (it == _freeLists[order].end()) {
+      break;
+    }
+    _freeLists[order].erase(it);
+    offset = std::min(offset, buddy);
+    order++;
+  }
+
+  _freeLists[order].insert(offset);
+}
+
+VkDeviceSize BuddyBlock::largestFreeRange() const {
+  for (int order = _maxOrder; order >= 0; order--) {
+    if (!_freeLists[order].empty()) {
+      return orderSize(static_cast<uint8_t>(order));
+    }
+  }
+  return 0;
+}
+
+Allocator::~Allocator() { destroy(); }
+
+void Allocator::init(VkPhysicalDevice physicalDevice, VkDevice device,
+                     bool memoryBudgetSupported) {
+  _physicalDevice = physicalDevice;
+  _device = device;
+  _memoryBudgetSupported = memoryBudgetSupported;
+
+  vkGetPhysicalDeviceMemoryProperties(_physicalDevice, &_memoryProperties);
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(_physicalDevice, &properties);
+  _bufferImageGranularity = properties.limits.bufferImageGranularity;
+  _maxAllocationCount = properties.limits.maxMemoryAllocationCount;
+
+  _heaps.resize(_memoryProperties.memoryHeapCount);
+  for (uint32_t i = 0; i < _memoryProperties.memoryHeapCount; i++) {
+    _heaps[i].size = _memoryProperties.memoryHeaps[i].size;
+    // without the budget extension leave headroom for other processes
+    _heaps[i].budget = _heaps[i].size * 8 / 10;
+  }
+  _pools.resize(_memoryProperties.memoryTypeCount);
+
+  updateBudget();
+}
+
+void Allocator::destroy() {
+  if (_device == VK_NULL_HANDLE) {
+    return;
+  }
+
+  for (uint32_t type = 0; type < _pools.size(); type++) {
+    for (auto &block : _pools[type].blocks) {
+      if (block) {
+        freeDeviceMemory(type, block->memory(), block->size());
+      }
+    }
+  }
+  _pools.clear();
+  _heaps.clear();
+  _device = VK_NULL_HANDLE;
+}
+
+Allocation Allocator::allocate(const VkMemoryRequirements &requirements,
+                               MemoryUsage usage) {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  Allocation allocation{};
+  allocation.memoryType = findMemoryType(requirements.memoryTypeBits, usage);
+  allocation.size = requirements.size;
+
+  HeapStats &heap =
+      _heaps[_memoryProperties.memoryTypes[allocation.memoryType].heapIndex];
+
+  VkDeviceSize blockSize = blockSizeFor(allocation.memoryType);
+  if (requirements.size > blockSize / 2) {
+    allocation.dedicated = true;
+    allocation.memory = allocateDeviceMemory(
+        allocation.memoryType, requirements.size, &allocation.mapped);
+    _dedicatedCount++;
+    _allocationCount++;
+    heap.usedBytes += allocation.size;
+    return allocation;
+  }
+
+  Pool &pool = _pools[allocation.memoryType];
+  auto tryBlock = [&](uint32_t index) {
+    BuddyBlock &block = *pool.blocks[index];
+    if (!block.allocate(requirements.size, requirements.alignment,
+                        allocation.offset, allocation.order)) {
+      return false;
+    }
+    allocation.memory = block.memory();
+    allocation.block = index;
+    if (block.mapped() != nullptr) {
+      allocation.mapped =
+          static_cast<char *>(block.mapped()) + allocation.offset;
+    }
+    return true;
+  };
+
+  for (uint32_t i = 0; i < pool.blocks.size(); i++) {
+    if (pool.blocks[i] && tryBlock(i)) {
+      _allocationCount++;
+      heap.usedBytes += allocation.size;
+      return allocation;
+    }
+  }
+
+  // reuse a slot of a released block so existing block indices stay valid
+  uint32_t index = static_cast<uint32_t>(
+      std::find(pool.blocks.begin(), pool.blocks.end(), nullptr) -
+      pool.blocks.begin());
+  if (index == pool.blocks.size()) {
+    pool.blocks.emplace_back();
+  }
+
+  void *mapped = nullptr;
+  VkDeviceMemory memory =
+      allocateDeviceMemory(allocation.memoryType, blockSize, &mapped);
+  // buddies never straddle a granularity page, so linear and optimal
+  // resources can share a block
+  pool.blocks[index] = std::make_unique<BuddyBlock>(
+      memory, blockSize, std::max(minBuddySize, _bufferImageGranularity),
+      mapped);
+
+  if (!tryBlock(index)) {
+    throw std::runtime_error("failed to sub-allocate device memory!");
+  }
+  _allocationCount++;
+  heap.usedBytes += allocation.size;
+  return allocation;
+}
+
+void Allocator::free(Allocation &allocation) {
+  if (allocation.memory == VK_NULL_HANDLE) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  _heaps[_memoryProperties.memoryTypes[allocation.memoryType].heapIndex]
+      .usedBytes -= allocation.size;
+
+  if (allocation.dedicated) {
+    freeDeviceMemory(allocation.memoryType, allocation.memory,
+                     allocation.size);
+    _dedicatedCount--;
+  } else {
+    Pool &pool = _pools[allocation.memoryType];
+    BuddyBlock &block = *pool.blocks[allocation.block];
+    block.free(allocation.offset, allocation.order);
+
+    // give empty blocks back to the driver, but keep one around so a
+    // resource that is created and destroyed every frame does not thrash
+    if (block.empty()) {
+      size_t live = std::count_if(pool.blocks.begin(), pool.blocks.end(),
+                                  [](const auto &b) { return b != nullptr; });
+      if (live > 1) {
+        freeDeviceMemory(allocation.memoryType, block.memory(), block.size());
+        pool.blocks[allocation.block].reset();
+      }
+    }
+  }
+
+  _allocationCount--;
+  allocation = {};
+}
+
+Buffer Allocator::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                               MemoryUsage memoryUsage) {
+  Buffer buffer;
+
+  VkBufferCreateInfo bufferInfo{};
+  bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  bufferInfo.size = size;
+  bufferInfo.usage = usage;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+  if (vkCreateBuffer(_device, &bufferInfo, nullptr, &buffer.buffer) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create buffer!");
+  }
+
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(_device, buffer.buffer, &requirements);
+
+  buffer.allocation = allocate(requirements, memoryUsage);
+  vkBindBufferMemory(_device, buffer.buffer, buffer.allocation.memory,
+                     buffer.allocation.offset);
+
+  return buffer;
+}
+
+void Allocator::destroyBuffer(Buffer &buffer) {
+  if (buffer.buffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(_device, buffer.buffer, nullptr);
+  }
+  free(buffer.allocation);
+  buffer.buffer = VK_NULL_HANDLE;
+}
+
+Image Allocator::createImage(const VkImageCreateInfo &imageInfo,
+                             MemoryUsage memoryUsage) {
+  Image image;
+
+  if (vkCreateImage(_device, &imageInfo, nullptr, &image.image) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create image!");
+  }
+
+  VkMemoryRequirements requirements;
+  vkGetImageMemoryRequirements(_device, image.image, &requirements);
+
+  image.allocation = allocate(requirements, memoryUsage);
+  vkBindImageMemory(_device, image.image, image.allocation.memory,
+                    image.allocation.offset);
+
+  return image;
+}
+
+void Allocator::destroyImage(Image &image) {
+  if (image.image != VK_NULL_HANDLE) {
+    vkDestroyImage(_device, image.image, nullptr);
+  }
+  free(image.allocation);
+  image.image = VK_NULL_HANDLE;
+}
+
+void Allocator::updateBudget() {
+  if (!_memoryBudgetSupported) {
+    return;
+  }
+
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{};
+  budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+  VkPhysicalDeviceMemoryProperties2 properties{};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+  properties.pNext = &budget;
+
+  vkGetPhysicalDeviceMemoryProperties2(_physicalDevice, &properties);
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  for (uint32_t i = 0; i < _heaps.size(); i++) {
+    _heaps[i].budget = budget.heapBudget[i];
+    _heaps[i].usage = budget.heapUsage[i];
+  }
+}
+
+AllocatorStats Allocator::stats() {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  AllocatorStats stats;
+  stats.deviceAllocationCount = _deviceAllocationCount;
+  stats.dedicatedCount = _dedicatedCount;
+  stats.allocationCount = _allocationCount;
+  stats.heaps = _heaps;
+
+  VkDeviceSize freeInBlocks = 0;
+  for (const auto &pool : _pools) {
+    for (const auto &block : pool.blocks) {
+      if (!block) {
+        continue;
+      }
+      stats.blockCount++;
+      freeInBlocks += block->freeBytes();
+      stats.largestFreeRange =
+          std::max(stats.largestFreeRange, block->largestFreeRange());
+    }
+  }
+
+  for (const auto &heap : _heaps) {
+    stats.reservedBytes += heap.reservedBytes;
+    stats.usedBytes += heap.usedBytes;
+  }
+
+  if (freeInBlocks > 0) {
+    stats.fragmentation =
+        1.0f - static_cast<float>(stats.largestFreeRange) /
+                   static_cast<float>(freeInBlocks);
+  }
+
+  return stats;
+}
+
+void Allocator::printStats(std::ostream &out) {
+  AllocatorStats s = stats();
+  constexpr double mib = 1024.0 * 1024.0;
+
+  out << "device memory: " << s.allocationCount << " allocations in "
+      << s.blockCount << " blocks + " << s.dedicatedCount << " dedicated ("
+      << s.deviceAllocationCount << " vkAllocateMemory), " << std::fixed
+      << std::setprecision(1) << s.usedBytes / mib << "/"
+      << s.reservedBytes / mib << " MiB used, fragmentation "
+      << s.fragmentation * 100.0f << "%" << std::endl;
+
+  for (size_t i = 0; i < s.heaps.size(); i++) {
+    const HeapStats &heap = s.heaps[i];
+    out << "  heap " << i << ": " << heap.reservedBytes / mib
+        << " MiB reserved, " << heap.usage / mib << "/" << heap.budget / mib
+        << " MiB of budget" << std::endl;
+  }
+}
+
+uint32_t Allocator::findMemoryType(uint32_t typeFilter, MemoryUsage usage) {
+  VkMemoryPropertyFlags required = 0;
+  VkMemoryPropertyFlags preferred = 0;
+  switch (usage) {
+  case MemoryUsage::GpuOnly:
+    required = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    break;
+  case MemoryUsage::CpuToGpu:
+    required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+               VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    break;
+  case MemoryUsage::GpuToCpu:
+    required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+               VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+    break;
+  }
+
+  for (VkMemoryPropertyFlags wanted : {required | preferred, required}) {
+    for (uint32_t i = 0; i < _memoryProperties.memoryTypeCount; i++) {
+      if ((typeFilter & (1 << i)) &&
+          (_memoryProperties.memoryTypes[i].propertyFlags & wanted) ==
+              wanted) {
+        return i;
+      }
+    }
+  }
+
+  throw std::runtime_error("failed to find suitable memory type!");
+}
+
+VkDeviceSize Allocator::blockSizeFor(uint32_t memoryType) {
+  uint32_t heap = _memoryProperties.memoryTypes[memoryType].heapIndex;
+  VkDeviceSize heapSize = _memoryProperties.memoryHeaps[heap].size;
+
+  // small heaps (integrated GPUs, the host visible BAR) get smaller blocks
+  // so a single block does not claim a large share of them
+  if (heapSize <= smallHeapThreshold) {
+    return std::max<VkDeviceSize>(roundDownToPowerOfTwo(heapSize / 8),
+                                  1024 * 1024);
+  }
+  return largeHeapBlockSize;
+}
+
+VkDeviceMemory Allocator::allocateDeviceMemory(uint32_t memoryType,
+                                               VkDeviceSize size,
+                                               void **mapped) {
+  uint32_t heap = _memoryProperties.memoryTypes[memoryType].heapIndex;
+  HeapStats &stats = _heaps[heap];
+
+  if (stats.usage + size > stats.budget) {
+    throw std::runtime_error("device memory budget exceeded!");
+  }
+  if (_deviceAllocationCount >= _maxAllocationCount) {
+    throw std::runtime_error("too many device memory allocations!");
+  }
+
+  VkMemoryAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  allocInfo.allocationSize = size;
+  allocInfo.memoryTypeIndex = memoryType;
+
+  VkDeviceMemory memory;
+  if (vkAllocateMemory(_device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate device memory!");
+  }
+
+  *mapped = nullptr;
+  if (_memoryProperties.memoryTypes[memoryType].propertyFlags &
+      VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+    if (vkMapMemory(_device, memory, 0, VK_WHOLE_SIZE, 0, mapped) !=
+        VK_SUCCESS) {
+      vkFreeMemory(_device, memory, nullptr);
+      throw std::runtime_error("failed to map device memory!");
+    }
+  }
+
+  _deviceAllocationCount++;
+  stats.reservedBytes += size;
+  // tracked locally until the next updateBudget() replaces it
+  stats.usage += size;
+  return memory;
+}
+
+void Allocator::freeDeviceMemory(uint32_t memoryType, VkDeviceMemory memory,
+                                 VkDeviceSize size) {
+  uint32_t heap = _memoryProperties.memoryTypes[memoryType].heapIndex;
+  HeapStats &stats = _heaps[heap];
+
+  vkFreeMemory(_device, memory, nullptr);
+
+  _deviceAllocationCount--;
+  stats.reservedBytes -= size;
+  stats.usage -= std::min(stats.usage, size);
+}
+
+} // namespace memory
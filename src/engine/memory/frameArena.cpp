@@ -0,0 +1,112 @@
+#include "memory/frameArena.hpp"
+#include "jobs/jobSystem.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace memory {
+
+namespace {
+
+size_t alignUp(size_t value, size_t alignment) {
+  return (value + alignment - 1) & ~(alignment - 1);
+}
+
+} // namespace
+
+LinearArena::LinearArena(size_t blockSize) : _blockSize(blockSize) {}
+
+void *LinearArena::allocate(size_t size, size_t alignment) {
+  // blocks come from new[], which aligns to max_align_t, so aligning the
+  // offset aligns the pointer
+  while (_current < _blocks.size()) {
+    Block &block = _blocks[_current];
+    size_t offset = alignUp(_offset, alignment);
+    if (offset + size <= block.size) {
+      _offset = offset + size;
+      return block.data.get() + offset;
+    }
+    _usedInEarlierBlocks += _offset;
+    _current++;
+    _offset = 0;
+  }
+
+  // only while growing, a rewound arena reuses what it already has
+  Block block;
+  block.size = std::max(_blockSize, size + alignment);
+  block.data = std::make_unique<std::byte[]>(block.size);
+  _blocks.push_back(std::move(block));
+
+  size_t offset =
+      alignUp(reinterpret_cast<uintptr_t>(_blocks.back().data.get()),
+              alignment) -
+      reinterpret_cast<uintptr_t>(_blocks.back().data.get());
+  _offset = offset + size;
+  return _blocks.back().data.get() + offset;
+}
+
+void LinearArena::reset() {
+  _current = 0;
+  _offset = 0;
+  _usedInEarlierBlocks = 0;
+}
+
+size_t LinearArena::used() const { return _usedInEarlierBlocks + _offset; }
+
+size_t LinearArena::capacity() const {
+  size_t total = 0;
+  for (const Block &block : _blocks) {
+    total += block.size;
+  }
+  return total;
+}
+
+void FrameArena::create(uint32_t frameCount, uint32_t threadCount,
+                        size_t blockSize) {
+  _frameCount = frameCount;
+  _threadCount = threadCount;
+  _frameIndex = 0;
+  _arenas.clear();
+  for (uint32_t i = 0; i < frameCount * threadCount; i++) {
+    _arenas.push_back(std::make_unique<LinearArena>(blockSize));
+  }
+}
+
+void FrameArena::destroy() {
+  _arenas.clear();
+  _frameCount = 0;
+  _threadCount = 0;
+}
+
+void FrameArena::beginFrame(uint32_t frameIndex) {
+  _frameIndex = frameIndex;
+  for (uint32_t i = 0; i < _threadCount; i++) {
+    _arenas[frameIndex * _threadCount + i]->reset();
+  }
+}
+
+LinearArena &FrameArena::local() {
+  uint32_t thread = jobs::JobSystem::workerIndex();
+  if (thread >= _threadCount) {
+    throw std::runtime_error("frame arena used from an unknown thread!");
+  }
+  return *_arenas[_frameIndex * _threadCount + thread];
+}
+
+size_t FrameArena::usedThisFrame() const {
+  size_t total = 0;
+  for (uint32_t i = 0; i < _threadCount; i++) {
+    total += _arenas[_frameIndex * _threadCount + i]->used();
+  }
+  return total;
+}
+
+size_t FrameArena::capacity() const {
+  size_t total = 0;
+  for (const auto &arena : _arenas) {
+    total += arena->capacity();
+  }
+  return total;
+}
+
+} // namespace memory
@@ -0,0 +1,48 @@
+#include "memory/ringBuffer.hpp"
+
+#include <stdexcept>
+
+namespace memory {
+
+RingBuffer::~RingBuffer() { destroy(); }
+
+void RingBuffer::create(Allocator &allocator, VkDeviceSize bytesPerFrame,
+                        uint32_t frameCount, VkBufferUsageFlags usage) {
+  _allocator = &allocator;
+  _frameSize = bytesPerFrame;
+  _buffer = allocator.createBuffer(bytesPerFrame * frameCount, usage,
+                                   MemoryUsage::CpuToGpu);
+  beginFrame(0);
+}
+
+void RingBuffer::destroy() {
+  if (_allocator != nullptr) {
+    _allocator->destroyBuffer(_buffer);
+    _allocator = nullptr;
+  }
+}
+
+void RingBuffer::beginFrame(uint32_t frameIndex) {
+  _frameBase = _frameSize * frameIndex;
+  _head.store(_frameBase);
+}
+
+TransientAllocation RingBuffer::allocate(VkDeviceSize size,
+                                         VkDeviceSize alignment) {
+  VkDeviceSize offset = _head.load();
+  VkDeviceSize aligned;
+  do {
+    aligned = (offset + alignment - 1) & ~(alignment - 1);
+    if (aligned + size > _frameBase + _frameSize) {
+      throw std::runtime_error("per-frame ring buffer exhausted!");
+    }
+  } while (!_head.compare_exchange_weak(offset, aligned + size));
+
+  TransientAllocation allocation;
+  allocation.buffer = _buffer.buffer;
+  allocation.offset = aligned;
+  allocation.mapped = static_cast<char *>(_buffer.allocation.mapped) + aligned;
+  return allocation;
+}
+
+} // namespace memory
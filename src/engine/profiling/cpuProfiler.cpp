@@ -0,0 +1,192 @@
+#include "profiling/cpuProfiler.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace profiling {
+
+namespace {
+
+struct CpuEvent {
+  const char *name;
+  uint64_t begin;
+  uint64_t end;
+};
+
+// a thread fills its chunks in order and never moves an event once it is
+// published, so exporting only has to read up to the published count
+constexpr uint32_t chunkSize = 4096;
+constexpr uint32_t maxChunks = 256;
+
+struct Chunk {
+  CpuEvent events[chunkSize];
+};
+
+struct ThreadBuffer {
+  uint32_t id = 0;
+  // guarded by the registry mutex
+  std::string name;
+
+  std::atomic<Chunk *> chunks[maxChunks] = {};
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> dropped{0};
+
+  ~ThreadBuffer() {
+    for (auto &chunk : chunks) {
+      delete chunk.load();
+    }
+  }
+};
+
+struct Registry {
+  std::atomic<bool> enabled{false};
+  uint64_t epoch = cpuTimestamp();
+
+  std::mutex mutex;
+  // buffers outlive their threads so a trace can still be written after
+  // the job system and I/O threads have been joined
+  std::vector<std::unique_ptr<ThreadBuffer>> threads;
+};
+
+Registry &registry() {
+  static Registry instance;
+  return instance;
+}
+
+thread_local ThreadBuffer *t_buffer = nullptr;
+
+ThreadBuffer &threadBuffer() {
+  if (t_buffer == nullptr) {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.threads.push_back(std::make_unique<ThreadBuffer>());
+    t_buffer = reg.threads.back().get();
+    t_buffer->id = static_cast<uint32_t>(reg.threads.size());
+  }
+  return *t_buffer;
+}
+
+void writeEscaped(std::ostream &out, const std::string &text) {
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      char escaped[8];
+      std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+      out << escaped;
+    } else {
+      out << c;
+    }
+  }
+}
+
+} // namespace
+
+void enableCpuProfiling(bool enabled) {
+  registry().enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool cpuProfilingEnabled() {
+  return registry().enabled.load(std::memory_order_relaxed);
+}
+
+uint64_t cpuTimestamp() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+void recordCpuEvent(const char *name, uint64_t begin, uint64_t end) {
+  ThreadBuffer &buffer = threadBuffer();
+  uint64_t index = buffer.count.load(std::memory_order_relaxed);
+
+  uint64_t chunkIndex = index / chunkSize;
+  if (chunkIndex >= maxChunks) {
+    buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  Chunk *chunk = buffer.chunks[chunkIndex].load(std::memory_order_relaxed);
+  if (chunk == nullptr) {
+    chunk = new Chunk;
+    buffer.chunks[chunkIndex].store(chunk, std::memory_order_release);
+  }
+
+  chunk->events[index % chunkSize] = {name, begin, end};
+  buffer.count.store(index + 1, std::memory_order_release);
+}
+
+void setThreadName(const std::string &name) {
+  ThreadBuffer &buffer = threadBuffer();
+  std::lock_guard<std::mutex> lock(registry().mutex);
+  buffer.name = name;
+}
+
+void writeChromeTrace(const std::string &path) {
+  std::ofstream file(path);
+  if (!file) {
+    throw std::runtime_error("failed to open trace file " + path + "!");
+  }
+
+  Registry &reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+
+  // microseconds with nanosecond fractions, relative to profiler start
+  auto microseconds = [&](uint64_t nanoseconds) {
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.3f",
+                  static_cast<double>(nanoseconds) / 1000.0);
+    return std::string(text);
+  };
+
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  uint64_t eventCount = 0;
+  uint64_t droppedCount = 0;
+
+  for (const auto &buffer : reg.threads) {
+    file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\","
+         << "\"pid\":1,\"tid\":" << buffer->id << ",\"args\":{\"name\":\"";
+    writeEscaped(file, buffer->name.empty()
+                           ? "thread " + std::to_string(buffer->id)
+                           : buffer->name);
+    file << "\"}}";
+    first = false;
+
+    uint64_t count = buffer->count.load(std::memory_order_acquire);
+    for (uint64_t i = 0; i < count; i++) {
+      const Chunk *chunk =
+          buffer->chunks[i / chunkSize].load(std::memory_order_acquire);
+      const CpuEvent &event = chunk->events[i % chunkSize];
+
+      file << ",\n{\"name\":\"";
+      writeEscaped(file, event.name);
+      file << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->id
+           << ",\"ts\":" << microseconds(event.begin - reg.epoch)
+           << ",\"dur\":" << microseconds(event.end - event.begin) << "}";
+    }
+    eventCount += count;
+    droppedCount += buffer->dropped.load(std::memory_order_relaxed);
+  }
+  file << "\n]}\n";
+
+  if (!file) {
+    throw std::runtime_error("failed to write trace file " + path + "!");
+  }
+
+  std::cout << "wrote " << eventCount << " cpu events to " << path;
+  if (droppedCount > 0) {
+    std::cout << ", " << droppedCount << " dropped";
+  }
+  std::cout << std::endl;
+}
+
+} // namespace profiling
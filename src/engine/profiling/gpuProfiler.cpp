@@ -0,0 +1,265 @@
+#include "profiling/gpuProfiler.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <utility>
+
+namespace profiling {
+
+namespace {
+
+// in PipelineStatistic order, which is also the order Vulkan writes the
+// enabled counters in
+constexpr VkQueryPipelineStatisticFlags statisticsQueryFlags =
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+    VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+const char *statisticNames[pipelineStatisticCount] = {
+    "vertices", "primitives", "vs", "clipped", "fs", "cs"};
+
+} // namespace
+
+GpuProfiler::~GpuProfiler() { destroy(); }
+
+void GpuProfiler::create(VkPhysicalDevice physicalDevice, VkDevice device,
+                         uint32_t queueFamily, uint32_t frameCount,
+                         bool pipelineStatistics, uint32_t maxScopes) {
+  _device = device;
+  _maxScopes = maxScopes;
+
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount,
+                                           nullptr);
+  std::vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount,
+                                           families.data());
+  uint32_t validBits = families[queueFamily].timestampValidBits;
+
+  if (validBits == 0) {
+    std::cout << "gpu profiler disabled, queue family " << queueFamily
+              << " has no timestamps" << std::endl;
+    return;
+  }
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  _timestampPeriod = properties.limits.timestampPeriod;
+  _timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+  _enabled = true;
+  _statisticsEnabled = pipelineStatistics;
+
+  _frames.resize(frameCount);
+  for (Frame &frame : _frames) {
+    VkQueryPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    poolInfo.queryCount = maxScopes * 2;
+
+    if (vkCreateQueryPool(_device, &poolInfo, nullptr, &frame.timestamps) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create timestamp query pool!");
+    }
+
+    if (_statisticsEnabled) {
+      poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+      poolInfo.queryCount = maxScopes;
+      poolInfo.pipelineStatistics = statisticsQueryFlags;
+
+      if (vkCreateQueryPool(_device, &poolInfo, nullptr,
+                            &frame.statistics) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create statistics query pool!");
+      }
+    }
+    frame.scopes.reserve(maxScopes);
+  }
+
+  // a value and its availability for both ends of every scope
+  _timestampValues.resize(maxScopes * 4);
+  _statisticsValues.resize(maxScopes * (pipelineStatisticCount + 1));
+  _result.scopes.reserve(maxScopes);
+  _collected.scopes.reserve(maxScopes);
+  _stack.reserve(maxScopes);
+}
+
+void GpuProfiler::destroy() {
+  for (Frame &frame : _frames) {
+    vkDestroyQueryPool(_device, frame.timestamps, nullptr);
+    if (frame.statistics != VK_NULL_HANDLE) {
+      vkDestroyQueryPool(_device, frame.statistics, nullptr);
+    }
+  }
+  _frames.clear();
+  _current = nullptr;
+  _enabled = false;
+}
+
+void GpuProfiler::beginFrame(VkCommandBuffer commandBuffer,
+                             uint32_t frameIndex, uint64_t frameNumber) {
+  if (!_enabled) {
+    return;
+  }
+
+  Frame &frame = _frames[frameIndex];
+  collect(frame);
+
+  frame.scopes.clear();
+  frame.statisticsCount = 0;
+  frame.frameNumber = frameNumber;
+  _current = &frame;
+  _stack.clear();
+  _statisticsScope = UINT32_MAX;
+
+  vkCmdResetQueryPool(commandBuffer, frame.timestamps, 0, _maxScopes * 2);
+  if (frame.statistics != VK_NULL_HANDLE) {
+    vkCmdResetQueryPool(commandBuffer, frame.statistics, 0, _maxScopes);
+  }
+}
+
+uint32_t GpuProfiler::beginScope(VkCommandBuffer commandBuffer,
+                                 const char *name) {
+  if (!_enabled || _current == nullptr ||
+      _current->scopes.size() == _maxScopes) {
+    return UINT32_MAX;
+  }
+
+  Frame &frame = *_current;
+  uint32_t index = static_cast<uint32_t>(frame.scopes.size());
+
+  Scope scope;
+  scope.name = name;
+  scope.parent = _stack.empty() ? UINT32_MAX : _stack.back();
+  scope.depth = static_cast<uint32_t>(_stack.size());
+  scope.statisticsQuery = UINT32_MAX;
+  frame.scopes.push_back(scope);
+  _stack.push_back(index);
+
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                      frame.timestamps, index * 2);
+
+  if (_statisticsEnabled && _statisticsScope == UINT32_MAX) {
+    frame.scopes[index].statisticsQuery = frame.statisticsCount++;
+    _statisticsScope = index;
+    vkCmdBeginQuery(commandBuffer, frame.statistics,
+                    frame.scopes[index].statisticsQuery, 0);
+  }
+  return index;
+}
+
+void GpuProfiler::endScope(VkCommandBuffer commandBuffer, uint32_t scope) {
+  if (scope == UINT32_MAX) {
+    return;
+  }
+
+  Frame &frame = *_current;
+  if (_stack.empty() || _stack.back() != scope) {
+    throw std::runtime_error("gpu profiler scopes ended out of order!");
+  }
+  _stack.pop_back();
+
+  if (_statisticsScope == scope) {
+    vkCmdEndQuery(commandBuffer, frame.statistics,
+                  frame.scopes[scope].statisticsQuery);
+    _statisticsScope = UINT32_MAX;
+  }
+  vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                      frame.timestamps, scope * 2 + 1);
+}
+
+VkQueryPipelineStatisticFlags GpuProfiler::statisticsFlags() const {
+  return _statisticsEnabled ? statisticsQueryFlags : 0;
+}
+
+void GpuProfiler::collect(Frame &frame) {
+  if (frame.scopes.empty()) {
+    return;
+  }
+
+  // the frame's fence has signaled so the results are there, asking for
+  // availability instead of waiting keeps a lost query from ever blocking
+  uint32_t queryCount = static_cast<uint32_t>(frame.scopes.size()) * 2;
+  const std::vector<uint64_t> &timestamps = _timestampValues;
+  VkResult result = vkGetQueryPoolResults(
+      _device, frame.timestamps, 0, queryCount,
+      queryCount * 2 * sizeof(uint64_t), _timestampValues.data(),
+      2 * sizeof(uint64_t),
+      VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+  if (result != VK_SUCCESS && result != VK_NOT_READY) {
+    return;
+  }
+
+  constexpr uint32_t statisticsStride = pipelineStatisticCount + 1;
+  const std::vector<uint64_t> &statistics = _statisticsValues;
+  bool statisticsRead = false;
+  if (frame.statisticsCount > 0) {
+    result = vkGetQueryPoolResults(
+        _device, frame.statistics, 0, frame.statisticsCount,
+        frame.statisticsCount * statisticsStride * sizeof(uint64_t),
+        _statisticsValues.data(),
+        statisticsStride * sizeof(uint64_t),
+        VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    statisticsRead = result == VK_SUCCESS || result == VK_NOT_READY;
+  }
+
+  GpuFrameResult &frameResult = _collected;
+  frameResult.frameNumber = frame.frameNumber;
+  frameResult.scopes.clear();
+
+  uint64_t first = UINT64_MAX;
+  uint64_t last = 0;
+  for (size_t i = 0; i < frame.scopes.size(); i++) {
+    const Scope &scope = frame.scopes[i];
+    // each query is a value followed by its availability
+    const uint64_t *begin = &timestamps[i * 4];
+    const uint64_t *end = &timestamps[i * 4 + 2];
+    if (begin[1] == 0 || end[1] == 0) {
+      return;
+    }
+
+    GpuScopeResult &scopeResult = frameResult.scopes.emplace_back();
+    scopeResult.name = scope.name;
+    scopeResult.parent = scope.parent;
+    scopeResult.depth = scope.depth;
+    // the mask takes care of counters that wrapped in between
+    uint64_t ticks = (end[0] - begin[0]) & _timestampMask;
+    scopeResult.milliseconds = ticks * _timestampPeriod / 1e6;
+
+    first = std::min(first, begin[0]);
+    last = std::max(last, begin[0] + ticks);
+
+    if (statisticsRead && scope.statisticsQuery != UINT32_MAX) {
+      const uint64_t *values =
+          &statistics[scope.statisticsQuery * statisticsStride];
+      scopeResult.hasStatistics = values[pipelineStatisticCount] != 0;
+      std::copy(values, values + pipelineStatisticCount,
+                scopeResult.statistics);
+    }
+  }
+
+  frameResult.milliseconds = (last - first) * _timestampPeriod / 1e6;
+  std::swap(_result, _collected);
+}
+
+void GpuProfiler::print(std::ostream &out) const {
+  out << "gpu frame " << _result.frameNumber << ": " << std::fixed
+      << std::setprecision(3) << _result.milliseconds << " ms" << std::endl;
+
+  for (const GpuScopeResult &scope : _result.scopes) {
+    out << std::string(2 + scope.depth * 2, ' ') << scope.name << " "
+        << scope.milliseconds << " ms";
+    if (scope.hasStatistics) {
+      for (uint32_t i = 0; i < pipelineStatisticCount; i++) {
+        out << " " << statisticNames[i] << "=" << scope.statistics[i];
+      }
+    }
+    out << std::endl;
+  }
+  out << std::defaultfloat;
+}
+
+} // namespace profiling
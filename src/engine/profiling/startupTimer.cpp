@@ -0,0 +1,60 @@
+#include "profiling/startupTimer.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+namespace profiling {
+
+namespace {
+
+double millisecondsBetween(StartupTimer::Clock::time_point begin,
+                           StartupTimer::Clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - begin).count();
+}
+
+} // namespace
+
+void StartupTimer::start() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _start = Clock::now();
+  _finished = false;
+  _phases.clear();
+}
+
+void StartupTimer::record(const char *name, Clock::time_point begin,
+                          Clock::time_point end) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _phases.push_back({name, millisecondsBetween(_start, begin),
+                     millisecondsBetween(begin, end)});
+}
+
+void StartupTimer::finish() {
+  if (_finished) {
+    return;
+  }
+  _end = Clock::now();
+  _finished = true;
+}
+
+double StartupTimer::totalMilliseconds() const {
+  return millisecondsBetween(_start, _finished ? _end : Clock::now());
+}
+
+void StartupTimer::print(std::ostream &out) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  std::vector<Phase> phases = _phases;
+  std::sort(phases.begin(), phases.end(), [](const Phase &a, const Phase &b) {
+    return a.beginMilliseconds < b.beginMilliseconds;
+  });
+
+  out << std::fixed << std::setprecision(1) << "startup: "
+      << totalMilliseconds() << " ms to the first frame" << std::endl;
+  for (const Phase &phase : phases) {
+    out << "  " << std::left << std::setw(20) << phase.name << std::right
+        << std::setw(8) << phase.beginMilliseconds << " ms +"
+        << std::setw(8) << phase.milliseconds << " ms" << std::endl;
+  }
+  out << std::defaultfloat;
+}
+
+} // namespace profiling
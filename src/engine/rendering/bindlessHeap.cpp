@@ -0,0 +1,265 @@
+#include "rendering/bindlessHeap.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace rendering {
+
+namespace {
+
+constexpr uint32_t bindingCount =
+    static_cast<uint32_t>(BindlessBinding::Count);
+
+constexpr VkDescriptorType descriptorTypes[bindingCount] = {
+    VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+    VK_DESCRIPTOR_TYPE_SAMPLER,
+};
+
+uint32_t index(BindlessBinding binding) {
+  return static_cast<uint32_t>(binding);
+}
+
+} // namespace
+
+BindlessHeap::~BindlessHeap() { destroy(); }
+
+void BindlessHeap::create(VkPhysicalDevice physicalDevice, VkDevice device,
+                          uint32_t framesInFlight,
+                          const BindlessLimits &limits) {
+  _device = device;
+  _framesInFlight = framesInFlight;
+
+  VkPhysicalDeviceVulkan12Properties properties12{};
+  properties12.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+
+  VkPhysicalDeviceProperties2 properties{};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext = &properties12;
+  vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+  // every binding is visible to all stages, so the per stage limits apply
+  // to the whole array
+  uint32_t capacities[bindingCount] = {
+      std::min({limits.sampledImages,
+                properties12.maxDescriptorSetUpdateAfterBindSampledImages,
+                properties12
+                    .maxPerStageDescriptorUpdateAfterBindSampledImages}),
+      std::min({limits.storageBuffers,
+                properties12.maxDescriptorSetUpdateAfterBindStorageBuffers,
+                properties12
+                    .maxPerStageDescriptorUpdateAfterBindStorageBuffers}),
+      std::min({limits.samplers,
+                properties12.maxDescriptorSetUpdateAfterBindSamplers,
+                properties12.maxPerStageDescriptorUpdateAfterBindSamplers}),
+  };
+
+  VkDescriptorSetLayoutBinding bindings[bindingCount]{};
+  VkDescriptorBindingFlags bindingFlags[bindingCount];
+  VkDescriptorPoolSize poolSizes[bindingCount];
+  for (uint32_t i = 0; i < bindingCount; i++) {
+    _slots[i].capacity = capacities[i];
+
+    bindings[i].binding = i;
+    bindings[i].descriptorType = descriptorTypes[i];
+    bindings[i].descriptorCount = capacities[i];
+    bindings[i].stageFlags = VK_SHADER_STAGE_ALL;
+
+    // slots nobody indexes may hold anything, and may be rewritten while
+    // frames that do not use them are in flight
+    bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT |
+                      VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                      VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+    poolSizes[i].type = descriptorTypes[i];
+    poolSizes[i].descriptorCount = capacities[i];
+  }
+
+  VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{};
+  flagsInfo.sType =
+      VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+  flagsInfo.bindingCount = bindingCount;
+  flagsInfo.pBindingFlags = bindingFlags;
+
+  VkDescriptorSetLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  layoutInfo.pNext = &flagsInfo;
+  layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+  layoutInfo.bindingCount = bindingCount;
+  layoutInfo.pBindings = bindings;
+
+  if (vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &_layout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create bindless set layout!");
+  }
+
+  VkDescriptorPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+  poolInfo.maxSets = 1;
+  poolInfo.poolSizeCount = bindingCount;
+  poolInfo.pPoolSizes = poolSizes;
+
+  if (vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_pool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create bindless descriptor pool!");
+  }
+
+  VkDescriptorSetAllocateInfo allocInfo{};
+  allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocInfo.descriptorPool = _pool;
+  allocInfo.descriptorSetCount = 1;
+  allocInfo.pSetLayouts = &_layout;
+
+  if (vkAllocateDescriptorSets(_device, &allocInfo, &_set) != VK_SUCCESS) {
+    throw std::runtime_error("failed to allocate bindless descriptor set!");
+  }
+
+  VkSamplerCreateInfo samplerInfo{};
+  samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+  samplerInfo.magFilter = VK_FILTER_LINEAR;
+  samplerInfo.minFilter = VK_FILTER_LINEAR;
+  samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+  samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+  samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+  if (vkCreateSampler(_device, &samplerInfo, nullptr, &_defaultSampler) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create default sampler!");
+  }
+  addSampler(_defaultSampler);
+
+  std::cout << "bindless heap: " << capacities[0] << " images, "
+            << capacities[1] << " storage buffers, " << capacities[2]
+            << " samplers" << std::endl;
+}
+
+void BindlessHeap::destroy() {
+  if (_set == VK_NULL_HANDLE) {
+    return;
+  }
+
+  vkDestroySampler(_device, _defaultSampler, nullptr);
+  // frees the set along with it
+  vkDestroyDescriptorPool(_device, _pool, nullptr);
+  vkDestroyDescriptorSetLayout(_device, _layout, nullptr);
+  _defaultSampler = VK_NULL_HANDLE;
+  _pool = VK_NULL_HANDLE;
+  _layout = VK_NULL_HANDLE;
+  _set = VK_NULL_HANDLE;
+
+  for (Slots &slots : _slots) {
+    slots = {};
+  }
+}
+
+uint32_t BindlessHeap::addImage(VkImageView view, VkImageLayout layout) {
+  VkDescriptorImageInfo imageInfo{};
+  imageInfo.imageView = view;
+  imageInfo.imageLayout = layout;
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  uint32_t handle = allocate(BindlessBinding::SampledImages);
+  write(BindlessBinding::SampledImages, handle, &imageInfo, nullptr);
+  return handle;
+}
+
+uint32_t BindlessHeap::addStorageBuffer(VkBuffer buffer, VkDeviceSize offset,
+                                        VkDeviceSize range) {
+  VkDescriptorBufferInfo bufferInfo{};
+  bufferInfo.buffer = buffer;
+  bufferInfo.offset = offset;
+  bufferInfo.range = range;
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  uint32_t handle = allocate(BindlessBinding::StorageBuffers);
+  write(BindlessBinding::StorageBuffers, handle, nullptr, &bufferInfo);
+  return handle;
+}
+
+uint32_t BindlessHeap::addSampler(VkSampler sampler) {
+  VkDescriptorImageInfo imageInfo{};
+  imageInfo.sampler = sampler;
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  uint32_t handle = allocate(BindlessBinding::Samplers);
+  write(BindlessBinding::Samplers, handle, &imageInfo, nullptr);
+  return handle;
+}
+
+void BindlessHeap::remove(BindlessBinding binding, uint32_t handle) {
+  if (handle == invalidHandle) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  _slots[index(binding)].retired.emplace_back(_frame, handle);
+}
+
+void BindlessHeap::beginFrame(uint64_t frameNumber) {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _frame = frameNumber;
+
+  // a slot removed during frame N may still be read by the frames in
+  // flight at that point, all of which have retired by N + framesInFlight
+  for (Slots &slots : _slots) {
+    while (!slots.retired.empty() &&
+           slots.retired.front().first + _framesInFlight <= frameNumber) {
+      slots.free.push_back(slots.retired.front().second);
+      slots.retired.pop_front();
+    }
+  }
+}
+
+void BindlessHeap::bind(VkCommandBuffer commandBuffer,
+                        VkPipelineBindPoint bindPoint,
+                        VkPipelineLayout layout, uint32_t set) const {
+  vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, set, 1, &_set, 0,
+                          nullptr);
+}
+
+uint32_t BindlessHeap::capacity(BindlessBinding binding) const {
+  return _slots[index(binding)].capacity;
+}
+
+uint32_t BindlessHeap::count(BindlessBinding binding) const {
+  std::lock_guard<std::mutex> lock(_mutex);
+  const Slots &slots = _slots[index(binding)];
+  return slots.highWater - static_cast<uint32_t>(slots.free.size()) -
+         static_cast<uint32_t>(slots.retired.size());
+}
+
+uint32_t BindlessHeap::allocate(BindlessBinding binding) {
+  Slots &slots = _slots[index(binding)];
+  if (!slots.free.empty()) {
+    uint32_t handle = slots.free.back();
+    slots.free.pop_back();
+    return handle;
+  }
+  if (slots.highWater == slots.capacity) {
+    throw std::runtime_error("bindless heap is out of descriptors!");
+  }
+  return slots.highWater++;
+}
+
+void BindlessHeap::write(BindlessBinding binding, uint32_t handle,
+                         const VkDescriptorImageInfo *imageInfo,
+                         const VkDescriptorBufferInfo *bufferInfo) {
+  VkWriteDescriptorSet write{};
+  write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+  write.dstSet = _set;
+  write.dstBinding = index(binding);
+  write.dstArrayElement = handle;
+  write.descriptorCount = 1;
+  write.descriptorType = descriptorTypes[index(binding)];
+  write.pImageInfo = imageInfo;
+  write.pBufferInfo = bufferInfo;
+
+  vkUpdateDescriptorSets(_device, 1, &write, 0, nullptr);
+}
+
+} // namespace rendering
@@ -0,0 +1,220 @@
+#include "rendering/framePacer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+namespace rendering {
+
+namespace {
+
+// a present that never completes, e.g. on a swapchain that just went out
+// of date, must not hang the loop
+constexpr uint64_t presentWaitTimeout = 100'000'000;
+
+constexpr float powerSavingFrameRate = 30.0f;
+
+const char *presentModeName(VkPresentModeKHR mode) {
+  switch (mode) {
+  case VK_PRESENT_MODE_IMMEDIATE_KHR:
+    return "immediate";
+  case VK_PRESENT_MODE_MAILBOX_KHR:
+    return "mailbox";
+  case VK_PRESENT_MODE_FIFO_KHR:
+    return "fifo";
+  case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+    return "fifo relaxed";
+  default:
+    return "unknown";
+  }
+}
+
+} // namespace
+
+const char *pacingModeName(PacingMode mode) {
+  switch (mode) {
+  case PacingMode::LowLatency:
+    return "low latency";
+  case PacingMode::Steady:
+    return "steady";
+  case PacingMode::PowerSaving:
+    return "power saving";
+  }
+  return "unknown";
+}
+
+void FramePacer::create(VkDevice device, PacingMode mode,
+                        uint32_t framesInFlight, float frameRateLimit,
+                        bool presentWait) {
+  _device = device;
+  _mode = mode;
+  _framesAhead = mode == PacingMode::Steady ? framesInFlight : 1;
+
+  if (presentWait) {
+    _waitForPresent = reinterpret_cast<PFN_vkWaitForPresentKHR>(
+        vkGetDeviceProcAddr(device, "vkWaitForPresentKHR"));
+  }
+
+  if (frameRateLimit == 0.0f && mode == PacingMode::PowerSaving) {
+    frameRateLimit = powerSavingFrameRate;
+  }
+  if (frameRateLimit > 0.0f) {
+    _frameInterval =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / frameRateLimit));
+  }
+
+  _history.assign(historySize, 0.0);
+  _historyNext = 0;
+  _started = false;
+
+  std::cout << "frame pacing: " << pacingModeName(mode) << ", "
+            << _framesAhead << " frames ahead"
+            << (presentWaitEnabled() ? " of the display" : " of the gpu");
+  if (frameRateLimit > 0.0f) {
+    std::cout << ", limited to " << frameRateLimit << " fps";
+  }
+  std::cout << std::endl;
+}
+
+VkPresentModeKHR FramePacer::choosePresentMode(
+    const std::vector<VkPresentModeKHR> &available) const {
+  auto supported = [&](VkPresentModeKHR mode) {
+    return std::find(available.begin(), available.end(), mode) !=
+           available.end();
+  };
+
+  VkPresentModeKHR mode = VK_PRESENT_MODE_FIFO_KHR;
+  // fifo is the only mode every device has, and the only one that never
+  // drops or tears frames
+  if (_mode == PacingMode::LowLatency) {
+    if (supported(VK_PRESENT_MODE_MAILBOX_KHR)) {
+      mode = VK_PRESENT_MODE_MAILBOX_KHR;
+    } else if (supported(VK_PRESENT_MODE_IMMEDIATE_KHR)) {
+      mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+    }
+  }
+
+  std::cout << "present mode: " << presentModeName(mode) << std::endl;
+  return mode;
+}
+
+uint32_t FramePacer::chooseImageCount(
+    const VkSurfaceCapabilitiesKHR &capabilities) const {
+  // mailbox needs a spare image to replace, fifo one to render into while
+  // another waits for vblank. Power saving makes do with the minimum
+  uint32_t imageCount = capabilities.minImageCount;
+  if (_mode != PacingMode::PowerSaving) {
+    imageCount++;
+  }
+  if (capabilities.maxImageCount > 0) {
+    imageCount = std::min(imageCount, capabilities.maxImageCount);
+  }
+  return imageCount;
+}
+
+void FramePacer::swapchainChanged(uint64_t frameNumber) {
+  _firstPresentId = frameNumber + 1;
+}
+
+void FramePacer::attachPresentId(VkPresentInfoKHR &presentInfo,
+                                 uint64_t frameNumber) {
+  if (!presentWaitEnabled()) {
+    return;
+  }
+
+  // frame N presents with id N + 1, 0 means no id
+  _presentIdValue = frameNumber + 1;
+  _presentId = {};
+  _presentId.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+  _presentId.pNext = presentInfo.pNext;
+  _presentId.swapchainCount = 1;
+  _presentId.pPresentIds = &_presentIdValue;
+  presentInfo.pNext = &_presentId;
+}
+
+bool FramePacer::waitForPresent(VkSwapchainKHR swapchain,
+                                uint64_t frameNumber) {
+  if (!presentWaitEnabled() || swapchain == VK_NULL_HANDLE) {
+    return false;
+  }
+  if (frameNumber < _framesAhead) {
+    return true;
+  }
+
+  uint64_t presentId = frameNumber - _framesAhead + 1;
+  if (presentId < _firstPresentId) {
+    return true;
+  }
+  // out of date and timeouts are left to the next acquire and present
+  _waitForPresent(_device, swapchain, presentId, presentWaitTimeout);
+  return true;
+}
+
+void FramePacer::beginFrame() {
+  using clock = std::chrono::steady_clock;
+
+  if (_frameInterval.count() > 0 && _started) {
+    clock::time_point now = clock::now();
+    if (now < _nextFrame) {
+      std::this_thread::sleep_until(_nextFrame);
+    }
+    // a frame that ran over starts a new cadence instead of rushing the
+    // ones after it to catch up
+    _nextFrame = std::max(_nextFrame, now) + _frameInterval;
+  }
+
+  clock::time_point now = clock::now();
+  if (_started) {
+    _history[_historyNext % historySize] =
+        std::chrono::duration<double, std::milli>(now - _lastFrame).count();
+    _historyNext++;
+  } else {
+    _nextFrame = now + _frameInterval;
+    _started = true;
+  }
+  _lastFrame = now;
+}
+
+FrameTimeStats FramePacer::stats() const {
+  FrameTimeStats stats;
+  stats.frameCount = std::min(_historyNext, historySize);
+  if (stats.frameCount == 0) {
+    return stats;
+  }
+
+  std::vector<double> times(_history.begin(),
+                            _history.begin() + stats.frameCount);
+  double sum = 0.0;
+  for (double time : times) {
+    sum += time;
+  }
+  stats.meanMilliseconds = sum / stats.frameCount;
+
+  double variance = 0.0;
+  for (double time : times) {
+    double delta = time - stats.meanMilliseconds;
+    variance += delta * delta;
+  }
+  stats.stdDevMilliseconds = std::sqrt(variance / stats.frameCount);
+
+  std::sort(times.begin(), times.end());
+  stats.p99Milliseconds = times[(times.size() - 1) * 99 / 100];
+  stats.maxMilliseconds = times.back();
+  return stats;
+}
+
+void FramePacer::print(std::ostream &out) const {
+  FrameTimeStats frameTimes = stats();
+  out << "cpu frames: " << std::fixed << std::setprecision(3)
+      << frameTimes.meanMilliseconds << " ms mean, "
+      << frameTimes.stdDevMilliseconds << " ms stddev, "
+      << frameTimes.p99Milliseconds << " ms p99, "
+      << frameTimes.maxMilliseconds << " ms max over "
+      << frameTimes.frameCount << " frames" << std::endl;
+  out << std::defaultfloat;
+}
+
+} // namespace rendering
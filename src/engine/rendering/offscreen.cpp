@@ -0,0 +1,143 @@
+#include "rendering/offscreen.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace rendering {
+
+OffscreenTarget::~OffscreenTarget() {
+  if (_allocator != nullptr) {
+    destroy();
+  }
+}
+
+void OffscreenTarget::create(memory::Allocator &allocator, VkFormat format,
+                             VkExtent2D extent, uint32_t imageCount) {
+  _allocator = &allocator;
+  _device = allocator.device();
+  _format = format;
+  _extent = extent;
+
+  VkImageCreateInfo imageInfo{};
+  imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = format;
+  imageInfo.extent = {extent.width, extent.height, 1};
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT |
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+  _images.resize(imageCount);
+  _views.resize(imageCount);
+  for (uint32_t i = 0; i < imageCount; i++) {
+    _images[i] =
+        allocator.createImage(imageInfo, memory::MemoryUsage::GpuOnly);
+
+    VkImageViewCreateInfo viewInfo{};
+    viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewInfo.image = _images[i].image;
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewInfo.subresourceRange.levelCount = 1;
+    viewInfo.subresourceRange.layerCount = 1;
+
+    if (vkCreateImageView(_device, &viewInfo, nullptr, &_views[i]) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create offscreen image view!");
+    }
+  }
+}
+
+void OffscreenTarget::destroy() {
+  for (auto view : _views) {
+    vkDestroyImageView(_device, view, nullptr);
+  }
+  for (auto &image : _images) {
+    _allocator->destroyImage(image);
+  }
+  _views.clear();
+  _images.clear();
+}
+
+std::vector<uint8_t> OffscreenTarget::readback(VkQueue queue,
+                                               uint32_t queueFamily,
+                                               uint32_t index) {
+  // only 8-bit four channel formats are used for offscreen targets
+  VkDeviceSize size =
+      static_cast<VkDeviceSize>(_extent.width) * _extent.height * 4;
+
+  memory::Buffer buffer = _allocator->createBuffer(
+      size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, memory::MemoryUsage::GpuToCpu);
+
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = queueFamily;
+
+  VkCommandPool commandPool;
+  if (vkCreateCommandPool(_device, &poolInfo, nullptr, &commandPool) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create command pool!");
+  }
+
+  VkCommandBufferAllocateInfo cmdInfo{};
+  cmdInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  cmdInfo.commandPool = commandPool;
+  cmdInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  cmdInfo.commandBufferCount = 1;
+
+  VkCommandBuffer commandBuffer;
+  vkAllocateCommandBuffers(_device, &cmdInfo, &commandBuffer);
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+  VkBufferImageCopy region{};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent = {_extent.width, _extent.height, 1};
+  vkCmdCopyImageToBuffer(commandBuffer, _images[index].image,
+                         VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer.buffer, 1,
+                         &region);
+
+  VkBufferMemoryBarrier toHost{};
+  toHost.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+  toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toHost.buffer = buffer.buffer;
+  toHost.size = VK_WHOLE_SIZE;
+  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &toHost,
+                       0, nullptr);
+
+  vkEndCommandBuffer(commandBuffer);
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &commandBuffer;
+  vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+  vkQueueWaitIdle(queue);
+
+  // GpuToCpu memory is coherent and persistently mapped
+  std::vector<uint8_t> pixels(size);
+  memcpy(pixels.data(), buffer.allocation.mapped, static_cast<size_t>(size));
+
+  vkDestroyCommandPool(_device, commandPool, nullptr);
+  _allocator->destroyBuffer(buffer);
+
+  return pixels;
+}
+
+} // namespace rendering
@@ -0,0 +1,100 @@
+#include "rendering/parallelRecorder.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace rendering {
+
+ParallelRecorder::~ParallelRecorder() { destroy(); }
+
+void ParallelRecorder::create(VkDevice device, uint32_t queueFamily,
+                              uint32_t frameCount, uint32_t threadCount) {
+  _device = device;
+  _threadCount = threadCount;
+  _pools.resize(static_cast<size_t>(frameCount) * threadCount);
+
+  VkCommandPoolCreateInfo poolInfo{};
+  poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  poolInfo.queueFamilyIndex = queueFamily;
+
+  for (auto &threadPool : _pools) {
+    if (vkCreateCommandPool(_device, &poolInfo, nullptr, &threadPool.pool) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create command pool!");
+    }
+  }
+}
+
+void ParallelRecorder::destroy() {
+  for (auto &threadPool : _pools) {
+    vkDestroyCommandPool(_device, threadPool.pool, nullptr);
+  }
+  _pools.clear();
+}
+
+void ParallelRecorder::beginFrame(uint32_t frameIndex) {
+  _frameIndex = frameIndex;
+  for (uint32_t i = 0; i < _threadCount; i++) {
+    ThreadPool &threadPool = _pools[frameIndex * _threadCount + i];
+    // buffers stay allocated, a reset pool hands them back in initial state
+    vkResetCommandPool(_device, threadPool.pool, 0);
+    threadPool.used = 0;
+  }
+}
+
+const std::vector<VkCommandBuffer> &
+ParallelRecorder::record(jobs::JobSystem &jobs, uint32_t count,
+                         uint32_t batchSize,
+                         const VkCommandBufferInheritanceInfo &inheritance,
+                         const RecordFunction &recordFunction) {
+  batchSize = std::max(1u, batchSize);
+  _secondaries.resize((count + batchSize - 1) / batchSize);
+
+  auto recordBatch = [&](uint32_t begin, uint32_t end) {
+    uint32_t thread = jobs::JobSystem::workerIndex();
+    ThreadPool &threadPool = _pools[_frameIndex * _threadCount + thread];
+    VkCommandBuffer commandBuffer = nextBuffer(threadPool);
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                      VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritance;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+      throw std::runtime_error("failed to begin recording command buffer!");
+    }
+    recordFunction(commandBuffer, begin, end);
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to record command buffer!");
+    }
+
+    _secondaries[begin / batchSize] = commandBuffer;
+  };
+
+  jobs::Counter counter;
+  jobs.parallelFor(count, batchSize, recordBatch, counter);
+  jobs.wait(counter);
+  return _secondaries;
+}
+
+VkCommandBuffer ParallelRecorder::nextBuffer(ThreadPool &threadPool) {
+  if (threadPool.used == threadPool.buffers.size()) {
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = threadPool.pool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    allocInfo.commandBufferCount = 1;
+
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(_device, &allocInfo, &commandBuffer) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate command buffers!");
+    }
+    threadPool.buffers.push_back(commandBuffer);
+  }
+  return threadPool.buffers[threadPool.used++];
+}
+
+} // namespace rendering
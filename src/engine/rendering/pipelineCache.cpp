@@ -0,0 +1,162 @@
+#include "rendering/pipelineCache.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace rendering {
+
+namespace {
+
+constexpr uint32_t pipelineCacheMagic = 0x43504b56; // "VKPC"
+constexpr uint32_t pipelineCacheVersion = 1;
+// far more than any driver writes, anything larger is a corrupt header
+constexpr uint64_t maxPipelineCacheSize = 256ull * 1024 * 1024;
+
+uint64_t hashData(const std::vector<char> &data) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (char byte : data) {
+    hash ^= static_cast<uint8_t>(byte);
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+} // namespace
+
+PipelineCache::~PipelineCache() { destroy(); }
+
+void PipelineCache::load(std::string path) {
+  _path = std::move(path);
+  _fileData.clear();
+
+  std::ifstream file(_path, std::ios::binary);
+  if (!file) {
+    return;
+  }
+
+  std::error_code error;
+  uintmax_t fileSize = std::filesystem::file_size(_path, error);
+
+  file.read(reinterpret_cast<char *>(&_fileHeader), sizeof(_fileHeader));
+  // save() writes the header and exactly dataSize bytes, a truncated or
+  // corrupt file is dropped before anything is allocated for it
+  bool valid = file && !error && _fileHeader.magic == pipelineCacheMagic &&
+               _fileHeader.version == pipelineCacheVersion &&
+               _fileHeader.dataSize <= maxPipelineCacheSize &&
+               fileSize == sizeof(_fileHeader) + _fileHeader.dataSize;
+  if (valid) {
+    _fileData.resize(_fileHeader.dataSize);
+    file.read(_fileData.data(), static_cast<std::streamsize>(_fileData.size()));
+    valid = file && hashData(_fileData) == _fileHeader.dataHash;
+  }
+
+  if (!valid) {
+    std::cout << "discarding stale pipeline cache " << _path << std::endl;
+    _fileData.clear();
+  }
+}
+
+void PipelineCache::create(VkPhysicalDevice physicalDevice, VkDevice device) {
+  _physicalDevice = physicalDevice;
+  _device = device;
+
+  // the driver validates its own header as well, but a cache built by a
+  // different driver is at best useless, so drop it before it gets there
+  if (!_fileData.empty()) {
+    Header expected = expectedHeader();
+    bool valid =
+        _fileHeader.vendorID == expected.vendorID &&
+        _fileHeader.deviceID == expected.deviceID &&
+        _fileHeader.driverVersion == expected.driverVersion &&
+        memcmp(_fileHeader.deviceUUID, expected.deviceUUID, VK_UUID_SIZE) ==
+            0 &&
+        memcmp(_fileHeader.pipelineCacheUUID, expected.pipelineCacheUUID,
+               VK_UUID_SIZE) == 0;
+    if (!valid) {
+      std::cout << "discarding stale pipeline cache " << _path << std::endl;
+      _fileData.clear();
+    }
+  }
+
+  VkPipelineCacheCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  createInfo.initialDataSize = _fileData.size();
+  createInfo.pInitialData = _fileData.empty() ? nullptr : _fileData.data();
+
+  if (vkCreatePipelineCache(_device, &createInfo, nullptr, &_cache) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline cache!");
+  }
+  _loadedFromDisk = !_fileData.empty();
+  _fileData.clear();
+  _fileData.shrink_to_fit();
+}
+
+void PipelineCache::save() {
+  if (_cache == VK_NULL_HANDLE) {
+    return;
+  }
+
+  size_t size = 0;
+  vkGetPipelineCacheData(_device, _cache, &size, nullptr);
+  std::vector<char> data(size);
+  if (vkGetPipelineCacheData(_device, _cache, &size, data.data()) !=
+      VK_SUCCESS) {
+    return;
+  }
+  data.resize(size);
+
+  Header header = expectedHeader();
+  header.dataSize = data.size();
+  header.dataHash = hashData(data);
+
+  std::error_code error;
+  std::filesystem::create_directories(
+      std::filesystem::path(_path).parent_path(), error);
+
+  // write then rename, an interrupted save must not leave a torn file
+  std::string temporary = _path + ".tmp";
+  {
+    std::ofstream file(temporary, std::ios::binary);
+    if (!file) {
+      return;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(data.data(), static_cast<std::streamsize>(data.size()));
+  }
+  std::filesystem::rename(temporary, _path, error);
+}
+
+void PipelineCache::destroy() {
+  if (_cache != VK_NULL_HANDLE) {
+    vkDestroyPipelineCache(_device, _cache, nullptr);
+    _cache = VK_NULL_HANDLE;
+  }
+}
+
+PipelineCache::Header PipelineCache::expectedHeader() {
+  VkPhysicalDeviceIDProperties idProperties{};
+  idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+
+  VkPhysicalDeviceProperties2 properties{};
+  properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+  properties.pNext = &idProperties;
+  vkGetPhysicalDeviceProperties2(_physicalDevice, &properties);
+
+  Header header{};
+  header.magic = pipelineCacheMagic;
+  header.version = pipelineCacheVersion;
+  header.vendorID = properties.properties.vendorID;
+  header.deviceID = properties.properties.deviceID;
+  header.driverVersion = properties.properties.driverVersion;
+  memcpy(header.deviceUUID, idProperties.deviceUUID, VK_UUID_SIZE);
+  memcpy(header.pipelineCacheUUID, properties.properties.pipelineCacheUUID,
+         VK_UUID_SIZE);
+  return header;
+}
+
+} // namespace rendering
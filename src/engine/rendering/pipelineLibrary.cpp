@@ -0,0 +1,403 @@
+#include "rendering/pipelineLibrary.hpp"
+#include "profiling/cpuProfiler.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace rendering {
+
+PipelineLibrary::~PipelineLibrary() { destroy(); }
+
+void PipelineLibrary::init(VkDevice device, ShaderCompiler &shaderCompiler,
+                           PipelineCache &pipelineCache,
+                           jobs::JobSystem &jobs, uint32_t framesInFlight) {
+  _device = device;
+  _shaderCompiler = &shaderCompiler;
+  _pipelineCache = &pipelineCache;
+  _jobs = &jobs;
+  _framesInFlight = framesInFlight;
+}
+
+void PipelineLibrary::destroy() {
+  // builds already started write into the entries, let them land first
+  for (auto &[name, entry] : _entries) {
+    _jobs->wait(entry->built);
+    _jobs->wait(entry->rebuilt);
+  }
+
+  for (auto &[name, entry] : _entries) {
+    if (entry->pipeline != VK_NULL_HANDLE) {
+      vkDestroyPipeline(_device, entry->pipeline, nullptr);
+    }
+    if (entry->replacement != VK_NULL_HANDLE) {
+      vkDestroyPipeline(_device, entry->replacement, nullptr);
+    }
+    vkDestroyPipelineLayout(_device, entry->layout, nullptr);
+  }
+  _entries.clear();
+
+  for (const RetiredPipeline &retired : _retired) {
+    vkDestroyPipeline(_device, retired.pipeline, nullptr);
+  }
+  _retired.clear();
+  _reloading = false;
+}
+
+void PipelineLibrary::prewarm(const PipelineManifest &manifest) {
+  std::vector<Entry *> queued;
+
+  for (const auto &desc : manifest.graphics) {
+    if (_entries.count(desc.name) != 0) {
+      continue;
+    }
+    Entry &entry = addEntry(desc.name, desc.setLayouts, desc.pushConstantSize,
+                            VK_SHADER_STAGE_VERTEX_BIT |
+                                VK_SHADER_STAGE_FRAGMENT_BIT);
+    entry.graphics = desc;
+    queued.push_back(&entry);
+  }
+
+  for (const auto &desc : manifest.compute) {
+    if (_entries.count(desc.name) != 0) {
+      continue;
+    }
+    Entry &entry = addEntry(desc.name, desc.setLayouts, desc.pushConstantSize,
+                            VK_SHADER_STAGE_COMPUTE_BIT);
+    entry.compute = desc;
+    entry.isCompute = true;
+    queued.push_back(&entry);
+  }
+
+  for (Entry *entry : queued) {
+    _jobs->run([this, entry]() { build(*entry); }, &entry->built);
+  }
+}
+
+void PipelineLibrary::reload() {
+  for (auto &[name, entry] : _entries) {
+    // whatever is building now may have read the files before the change,
+    // and a rebuild not swapped in yet is compared against old keys
+    if (!entry->built.done() || !entry->rebuilt.done() ||
+        entry->replacement != VK_NULL_HANDLE) {
+      entry->stale = true;
+      continue;
+    }
+    Entry *queued = entry.get();
+    _jobs->run([this, queued]() { rebuild(*queued); }, &queued->rebuilt);
+  }
+  _reloading = true;
+}
+
+void PipelineLibrary::update(uint64_t frameNumber) {
+  if (!_reloading && _retired.empty()) {
+    return;
+  }
+
+  bool pending = false;
+  for (auto &[name, entry] : _entries) {
+    if (!entry->built.done() || !entry->rebuilt.done()) {
+      pending = true;
+      continue;
+    }
+
+    // nothing recorded from here on sees the old pipeline, frames already
+    // submitted keep drawing with it
+    if (entry->replacement != VK_NULL_HANDLE) {
+      VkPipeline old = entry->pipeline.exchange(entry->replacement,
+                                                std::memory_order_acq_rel);
+      if (old != VK_NULL_HANDLE) {
+        _retired.push_back({old, frameNumber});
+      }
+      entry->keys = std::move(entry->replacementKeys);
+      entry->replacement = VK_NULL_HANDLE;
+      std::cout << "reloaded pipeline " << name << std::endl;
+    }
+
+    if (entry->stale) {
+      entry->stale = false;
+      pending = true;
+      Entry *queued = entry.get();
+      _jobs->run([this, queued]() { rebuild(*queued); }, &queued->rebuilt);
+    }
+  }
+  _reloading = pending;
+
+  // the last frame to use it is frameNumber - 1, its fence has been waited
+  // on by the time frameNumber - 1 + framesInFlight starts
+  auto destroyed = [&](const RetiredPipeline &retired) {
+    if (retired.frameNumber + _framesInFlight - 1 > frameNumber) {
+      return false;
+    }
+    vkDestroyPipeline(_device, retired.pipeline, nullptr);
+    return true;
+  };
+  _retired.erase(std::remove_if(_retired.begin(), _retired.end(), destroyed),
+                 _retired.end());
+}
+
+VkPipeline PipelineLibrary::get(const std::string &name) const {
+  auto it = _entries.find(name);
+  if (it == _entries.end()) {
+    return VK_NULL_HANDLE;
+  }
+  return it->second->pipeline.load(std::memory_order_acquire);
+}
+
+VkPipelineLayout PipelineLibrary::layout(const std::string &name) const {
+  auto it = _entries.find(name);
+  return it == _entries.end() ? VK_NULL_HANDLE : it->second->layout;
+}
+
+VkPipeline PipelineLibrary::wait(const std::string &name) {
+  auto it = _entries.find(name);
+  if (it == _entries.end()) {
+    throw std::runtime_error("pipeline " + name + " was never declared!");
+  }
+
+  // helps out with the job queue rather than sleeping
+  Entry &entry = *it->second;
+  _jobs->wait(entry.built);
+  return entry.pipeline;
+}
+
+bool PipelineLibrary::idle() const {
+  for (const auto &[name, entry] : _entries) {
+    if (!entry->built.done()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+PipelineLibrary::Entry &
+PipelineLibrary::addEntry(const std::string &name,
+                          const std::vector<VkDescriptorSetLayout> &setLayouts,
+                          uint32_t pushConstantSize,
+                          VkShaderStageFlags stages) {
+  auto entry = std::make_unique<Entry>();
+
+  VkPushConstantRange pushConstants{};
+  pushConstants.stageFlags = stages;
+  pushConstants.size = pushConstantSize;
+
+  // layouts are cheap, create them up front so they are usable for binding
+  // descriptors before the pipeline itself is ready
+  VkPipelineLayoutCreateInfo layoutInfo{};
+  layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+  layoutInfo.pSetLayouts = setLayouts.data();
+  layoutInfo.pushConstantRangeCount = pushConstantSize > 0 ? 1 : 0;
+  layoutInfo.pPushConstantRanges = &pushConstants;
+
+  if (vkCreatePipelineLayout(_device, &layoutInfo, nullptr, &entry->layout) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create pipeline layout!");
+  }
+
+  Entry &result = *entry;
+  _entries.emplace(name, std::move(entry));
+  return result;
+}
+
+void PipelineLibrary::build(Entry &entry) {
+  PROFILE_SCOPE("buildPipeline");
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  try {
+    pipeline = buildPipeline(entry, entry.keys);
+  } catch (const std::exception &e) {
+    // a broken pipeline should not take the engine down, it is simply
+    // never drawn with
+    std::cerr << e.what() << std::endl;
+  }
+
+  entry.pipeline.store(pipeline, std::memory_order_release);
+}
+
+void PipelineLibrary::rebuild(Entry &entry) {
+  PROFILE_SCOPE("rebuildPipeline");
+  try {
+    // most saves touch one file, everything else hashes the same
+    if (shaderKeys(entry) == entry.keys) {
+      return;
+    }
+    entry.replacement = buildPipeline(entry, entry.replacementKeys);
+  } catch (const std::exception &e) {
+    // keeps drawing with the last pipeline that worked until the shader
+    // is fixed
+    std::cerr << e.what() << std::endl;
+  }
+}
+
+std::vector<uint64_t> PipelineLibrary::shaderKeys(const Entry &entry) {
+  if (entry.isCompute) {
+    return {_shaderCompiler->key(entry.compute.shader)};
+  }
+  return {_shaderCompiler->key(entry.graphics.vertex),
+          _shaderCompiler->key(entry.graphics.fragment)};
+}
+
+VkPipeline PipelineLibrary::buildPipeline(const Entry &entry,
+                                          std::vector<uint64_t> &keys) {
+  return entry.isCompute
+             ? buildCompute(entry.compute, entry.layout, keys)
+             : buildGraphics(entry.graphics, entry.layout, keys);
+}
+
+VkPipeline PipelineLibrary::buildGraphics(const GraphicsPipelineDesc &desc,
+                                          VkPipelineLayout layout,
+                                          std::vector<uint64_t> &keys) {
+  std::vector<ShaderBinary> binaries =
+      _shaderCompiler->compileAll({desc.vertex, desc.fragment});
+  VkShaderModule vertModule =
+      _shaderCompiler->createModule(_device, binaries[0]);
+  VkShaderModule fragModule =
+      _shaderCompiler->createModule(_device, binaries[1]);
+
+  VkPipelineShaderStageCreateInfo stages[2]{};
+  stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+  stages[0].module = vertModule;
+  stages[0].pName = desc.vertex.entryPoint.c_str();
+  stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  stages[1].module = fragModule;
+  stages[1].pName = desc.fragment.entryPoint.c_str();
+
+  VkPipelineVertexInputStateCreateInfo vertexInput{};
+  vertexInput.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertexInput.vertexBindingDescriptionCount =
+      static_cast<uint32_t>(desc.vertexBindings.size());
+  vertexInput.pVertexBindingDescriptions = desc.vertexBindings.data();
+  vertexInput.vertexAttributeDescriptionCount =
+      static_cast<uint32_t>(desc.vertexAttributes.size());
+  vertexInput.pVertexAttributeDescriptions = desc.vertexAttributes.data();
+
+  VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+  inputAssembly.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  inputAssembly.topology = desc.topology;
+
+  // viewport and scissor are dynamic so a resize does not rebuild pipelines
+  VkPipelineViewportStateCreateInfo viewportState{};
+  viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewportState.viewportCount = 1;
+  viewportState.scissorCount = 1;
+
+  VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                    VK_DYNAMIC_STATE_SCISSOR};
+  VkPipelineDynamicStateCreateInfo dynamicState{};
+  dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamicState.dynamicStateCount = 2;
+  dynamicState.pDynamicStates = dynamicStates;
+
+  VkPipelineRasterizationStateCreateInfo rasterizer{};
+  rasterizer.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterizer.cullMode = desc.cullMode;
+  rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  rasterizer.lineWidth = 1.0f;
+
+  VkPipelineMultisampleStateCreateInfo multisampling{};
+  multisampling.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  VkPipelineDepthStencilStateCreateInfo depthStencil{};
+  depthStencil.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+  depthStencil.depthTestEnable = desc.depthTest;
+  depthStencil.depthWriteEnable = desc.depthWrite;
+  depthStencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+  VkPipelineColorBlendAttachmentState blendAttachment{};
+  blendAttachment.colorWriteMask =
+      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  blendAttachment.blendEnable = desc.blend;
+  blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+  blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+  blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+  blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+  blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+  blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+  std::vector<VkPipelineColorBlendAttachmentState> blendAttachments(
+      desc.colorFormats.size(), blendAttachment);
+
+  VkPipelineColorBlendStateCreateInfo colorBlending{};
+  colorBlending.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  colorBlending.attachmentCount =
+      static_cast<uint32_t>(blendAttachments.size());
+  colorBlending.pAttachments = blendAttachments.data();
+
+  VkPipelineRenderingCreateInfo renderingInfo{};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+  renderingInfo.colorAttachmentCount =
+      static_cast<uint32_t>(desc.colorFormats.size());
+  renderingInfo.pColorAttachmentFormats = desc.colorFormats.data();
+  renderingInfo.depthAttachmentFormat = desc.depthFormat;
+
+  VkGraphicsPipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  pipelineInfo.pNext = &renderingInfo;
+  pipelineInfo.stageCount = 2;
+  pipelineInfo.pStages = stages;
+  pipelineInfo.pVertexInputState = &vertexInput;
+  pipelineInfo.pInputAssemblyState = &inputAssembly;
+  pipelineInfo.pViewportState = &viewportState;
+  pipelineInfo.pRasterizationState = &rasterizer;
+  pipelineInfo.pMultisampleState = &multisampling;
+  pipelineInfo.pDepthStencilState = &depthStencil;
+  pipelineInfo.pColorBlendState = &colorBlending;
+  pipelineInfo.pDynamicState = &dynamicState;
+  pipelineInfo.layout = layout;
+
+  VkPipeline pipeline;
+  VkResult result =
+      vkCreateGraphicsPipelines(_device, _pipelineCache->handle(), 1,
+                                &pipelineInfo, nullptr, &pipeline);
+
+  vkDestroyShaderModule(_device, fragModule, nullptr);
+  vkDestroyShaderModule(_device, vertModule, nullptr);
+
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("failed to create graphics pipeline " +
+                             desc.name + "!");
+  }
+  keys = {binaries[0].key, binaries[1].key};
+  return pipeline;
+}
+
+VkPipeline PipelineLibrary::buildCompute(const ComputePipelineDesc &desc,
+                                         VkPipelineLayout layout,
+                                         std::vector<uint64_t> &keys) {
+  ShaderBinary binary = _shaderCompiler->compile(desc.shader);
+  VkShaderModule module = _shaderCompiler->createModule(_device, binary);
+
+  VkComputePipelineCreateInfo pipelineInfo{};
+  pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  pipelineInfo.stage.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineInfo.stage.module = module;
+  pipelineInfo.stage.pName = desc.shader.entryPoint.c_str();
+  pipelineInfo.layout = layout;
+
+  VkPipeline pipeline;
+  VkResult result = vkCreateComputePipelines(
+      _device, _pipelineCache->handle(), 1, &pipelineInfo, nullptr, &pipeline);
+
+  vkDestroyShaderModule(_device, module, nullptr);
+
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("failed to create compute pipeline " +
+                             desc.name + "!");
+  }
+  keys = {binary.key};
+  return pipeline;
+}
+
+} // namespace rendering
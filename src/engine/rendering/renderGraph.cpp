@@ -0,0 +1,940 @@
+#include "rendering/renderGraph.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+namespace rendering {
+
+namespace {
+
+constexpr VkAccessFlags2 writeAccessMask =
+    VK_ACCESS_2_SHADER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT |
+    VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+    VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_HOST_WRITE_BIT |
+    VK_ACCESS_2_MEMORY_WRITE_BIT;
+
+constexpr VkPipelineStageFlags2 fragmentTestStages =
+    VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT |
+    VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT;
+
+ResourceState imageState(ImageUsage usage) {
+  switch (usage) {
+  case ImageUsage::ColorAttachment:
+    return {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT |
+                VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  case ImageUsage::DepthAttachment:
+    return {fragmentTestStages,
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL};
+  case ImageUsage::DepthRead:
+    return {fragmentTestStages | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+            VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT |
+                VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL};
+  case ImageUsage::SampledFragment:
+    return {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+            VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  case ImageUsage::SampledCompute:
+    return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+  case ImageUsage::StorageRead:
+    return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_STORAGE_READ_BIT, VK_IMAGE_LAYOUT_GENERAL};
+  case ImageUsage::StorageWrite:
+    return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+                VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            VK_IMAGE_LAYOUT_GENERAL};
+  case ImageUsage::TransferSrc:
+    return {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+            VK_ACCESS_2_TRANSFER_READ_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL};
+  case ImageUsage::TransferDst:
+    return {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+            VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL};
+  }
+  return {};
+}
+
+VkImageUsageFlags imageUsageFlags(ImageUsage usage) {
+  switch (usage) {
+  case ImageUsage::ColorAttachment:
+    return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  case ImageUsage::DepthAttachment:
+    return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+  case ImageUsage::DepthRead:
+    return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT |
+           VK_IMAGE_USAGE_SAMPLED_BIT;
+  case ImageUsage::SampledFragment:
+  case ImageUsage::SampledCompute:
+    return VK_IMAGE_USAGE_SAMPLED_BIT;
+  case ImageUsage::StorageRead:
+  case ImageUsage::StorageWrite:
+    return VK_IMAGE_USAGE_STORAGE_BIT;
+  case ImageUsage::TransferSrc:
+    return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  case ImageUsage::TransferDst:
+    return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+  }
+  return 0;
+}
+
+ResourceState bufferState(BufferUsage usage) {
+  constexpr VkImageLayout none = VK_IMAGE_LAYOUT_UNDEFINED;
+  constexpr VkPipelineStageFlags2 graphicsShaders =
+      VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT |
+      VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT;
+
+  switch (usage) {
+  case BufferUsage::IndirectRead:
+    return {VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT,
+            VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT, none};
+  case BufferUsage::VertexRead:
+    return {VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT,
+            VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT, none};
+  case BufferUsage::IndexRead:
+    return {VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT,
+            none};
+  case BufferUsage::UniformRead:
+    return {graphicsShaders | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_UNIFORM_READ_BIT, none};
+  case BufferUsage::StorageReadGraphics:
+    return {graphicsShaders, VK_ACCESS_2_SHADER_STORAGE_READ_BIT, none};
+  case BufferUsage::StorageReadCompute:
+    return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_STORAGE_READ_BIT, none};
+  case BufferUsage::StorageWriteCompute:
+    return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+            VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+                VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            none};
+  case BufferUsage::TransferSrc:
+    return {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+            VK_ACCESS_2_TRANSFER_READ_BIT, none};
+  case BufferUsage::TransferDst:
+    return {VK_PIPELINE_STAGE_2_ALL_TRANSFER_BIT,
+            VK_ACCESS_2_TRANSFER_WRITE_BIT, none};
+  }
+  return {};
+}
+
+bool isDepthFormat(VkFormat format) {
+  return format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_D32_SFLOAT ||
+         format == VK_FORMAT_D16_UNORM_S8_UINT ||
+         format == VK_FORMAT_D24_UNORM_S8_UINT ||
+         format == VK_FORMAT_D32_SFLOAT_S8_UINT;
+}
+
+VkImageAspectFlags barrierAspect(VkFormat format) {
+  if (!isDepthFormat(format)) {
+    return VK_IMAGE_ASPECT_COLOR_BIT;
+  }
+  // without separateDepthStencilLayouts both aspects transition together
+  if (format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_D32_SFLOAT) {
+    return VK_IMAGE_ASPECT_DEPTH_BIT;
+  }
+  return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+}
+
+void hashValue(uint64_t &hash, uint64_t value) {
+  for (int i = 0; i < 8; i++) {
+    hash ^= (value >> (i * 8)) & 0xff;
+    hash *= 0x100000001b3ull;
+  }
+}
+
+std::string mebibytes(VkDeviceSize bytes) {
+  char text[32];
+  std::snprintf(text, sizeof(text), "%.1f MiB",
+                static_cast<double>(bytes) / (1024.0 * 1024.0));
+  return text;
+}
+
+} // namespace
+
+GraphPass &GraphPass::read(GraphImage image, ImageUsage usage) {
+  _images.push_back({image.index, usage, false});
+  return *this;
+}
+
+GraphPass &GraphPass::write(GraphImage image, ImageUsage usage) {
+  _images.push_back({image.index, usage, true});
+  return *this;
+}
+
+GraphPass &GraphPass::read(GraphBuffer buffer, BufferUsage usage) {
+  _buffers.push_back({buffer.index, usage, false});
+  return *this;
+}
+
+GraphPass &GraphPass::write(GraphBuffer buffer, BufferUsage usage) {
+  _buffers.push_back({buffer.index, usage, true});
+  return *this;
+}
+
+GraphPass &GraphPass::colorAttachment(GraphImage image,
+                                      VkAttachmentLoadOp loadOp,
+                                      VkClearColorValue clear) {
+  VkClearValue value{};
+  value.color = clear;
+  _colorAttachments.push_back({image.index, loadOp, value});
+
+  // loading keeps what earlier passes wrote, so it also reads the image
+  write(image, ImageUsage::ColorAttachment);
+  if (loadOp == VK_ATTACHMENT_LOAD_OP_LOAD) {
+    read(image, ImageUsage::ColorAttachment);
+  }
+  return *this;
+}
+
+GraphPass &GraphPass::depthAttachment(GraphImage image,
+                                      VkAttachmentLoadOp loadOp,
+                                      float clearDepth) {
+  VkClearValue value{};
+  value.depthStencil = {clearDepth, 0};
+  _depthAttachment = {image.index, loadOp, value};
+
+  write(image, ImageUsage::DepthAttachment);
+  if (loadOp == VK_ATTACHMENT_LOAD_OP_LOAD) {
+    read(image, ImageUsage::DepthAttachment);
+  }
+  return *this;
+}
+
+GraphPass &GraphPass::renderingFlags(VkRenderingFlags flags) {
+  _renderingFlags = flags;
+  return *this;
+}
+
+GraphPass &GraphPass::sideEffects() {
+  _sideEffects = true;
+  return *this;
+}
+
+void GraphPass::reset(const char *name, memory::LinearArena &arena) {
+  releaseFunction();
+  _name = name;
+  _images.clear();
+  _buffers.clear();
+  _colorAttachments.clear();
+  _depthAttachment = {UINT32_MAX, VK_ATTACHMENT_LOAD_OP_DONT_CARE, {}};
+  _renderingFlags = 0;
+  _sideEffects = false;
+  _arena = &arena;
+}
+
+void GraphPass::releaseFunction() {
+  // the memory itself goes with the next reset of the arena
+  if (_function.destroy != nullptr) {
+    _function.destroy(_function.object);
+  }
+  _function = {};
+}
+
+RenderGraph::~RenderGraph() { destroy(); }
+
+void RenderGraph::create(memory::Allocator &allocator, uint32_t frameCount) {
+  _allocator = &allocator;
+  _device = allocator.device();
+  _frames.resize(frameCount);
+}
+
+void RenderGraph::destroy() {
+  for (FrameResources &frame : _frames) {
+    releaseFrame(frame);
+  }
+  _frames.clear();
+  _frame = nullptr;
+
+  resetPasses();
+  _passes.clear();
+  _images.clear();
+  _buffers.clear();
+  _compiled = false;
+}
+
+void RenderGraph::beginFrame(uint32_t frameIndex) {
+  _frame = &_frames[frameIndex];
+
+  resetPasses();
+  _images.clear();
+  _buffers.clear();
+  _compiled = false;
+}
+
+void RenderGraph::resetPasses() {
+  for (size_t i = 0; i < _passCount; i++) {
+    _passes[i].releaseFunction();
+  }
+  _passCount = 0;
+  _functionArena.reset();
+}
+
+GraphImage RenderGraph::importImage(const char *name, VkImage image,
+                                    VkImageView view, VkFormat format,
+                                    VkExtent2D extent,
+                                    const ResourceState &initial,
+                                    const ResourceState &final) {
+  ImageResource &resource = _images.emplace_back();
+  resource.name = name;
+  resource.image = image;
+  resource.view = view;
+  resource.format = format;
+  resource.extent = extent;
+  resource.initial = initial;
+  resource.final = final;
+  return {static_cast<uint32_t>(_images.size() - 1)};
+}
+
+GraphBuffer RenderGraph::importBuffer(const char *name, VkBuffer buffer,
+                                      const ResourceState &initial,
+                                      const ResourceState &final) {
+  BufferResource &resource = _buffers.emplace_back();
+  resource.name = name;
+  resource.buffer = buffer;
+  resource.initial = initial;
+  resource.final = final;
+  return {static_cast<uint32_t>(_buffers.size() - 1)};
+}
+
+GraphImage RenderGraph::createImage(const char *name,
+                                    const TransientImageDesc &desc) {
+  ImageResource &resource = _images.emplace_back();
+  resource.name = name;
+  resource.format = desc.format;
+  resource.extent = desc.extent;
+  resource.samples = desc.samples;
+  resource.transient = true;
+  return {static_cast<uint32_t>(_images.size() - 1)};
+}
+
+GraphPass &RenderGraph::addPass(const char *name) {
+  if (_passCount == _passes.size()) {
+    _passes.emplace_back();
+  }
+  GraphPass &pass = _passes[_passCount++];
+  pass.reset(name, _functionArena);
+  return pass;
+}
+
+void RenderGraph::compile() {
+  if (_frame == nullptr) {
+    throw std::runtime_error("render graph compiled outside of a frame!");
+  }
+
+  cullPasses();
+  collectUses();
+  allocateTransients();
+  buildBarriers();
+  _compiled = true;
+}
+
+void RenderGraph::cullPasses() {
+  // walking backwards, a pass survives when it writes something that is
+  // imported or read by a later surviving pass. A write never hides an
+  // earlier one, passes rarely overwrite all of a resource. Buffers are
+  // all imported so any write to one keeps its pass
+  std::vector<bool> &neededImages = _neededImages;
+  std::vector<bool> &neededBuffers = _neededBuffers;
+  neededImages.assign(_images.size(), false);
+  neededBuffers.assign(_buffers.size(), true);
+  for (size_t i = 0; i < _images.size(); i++) {
+    neededImages[i] = !_images[i].transient;
+  }
+
+  _order.clear();
+  for (size_t i = _passCount; i-- > 0;) {
+    const GraphPass &pass = _passes[i];
+
+    bool alive = pass._sideEffects;
+    for (const auto &access : pass._images) {
+      if (access.image >= _images.size()) {
+        throw std::runtime_error(std::string("render graph pass ") +
+                                 pass._name + " uses an unknown image!");
+      }
+      alive = alive || (access.write && neededImages[access.image]);
+    }
+    for (const auto &access : pass._buffers) {
+      if (access.buffer >= _buffers.size()) {
+        throw std::runtime_error(std::string("render graph pass ") +
+                                 pass._name + " uses an unknown buffer!");
+      }
+      alive = alive || (access.write && neededBuffers[access.buffer]);
+    }
+    if (!alive) {
+      continue;
+    }
+
+    _order.push_back(static_cast<uint32_t>(i));
+    for (const auto &access : pass._images) {
+      if (!access.write) {
+        neededImages[access.image] = true;
+      }
+    }
+  }
+  std::reverse(_order.begin(), _order.end());
+}
+
+void RenderGraph::collectUses() {
+  for (ImageResource &image : _images) {
+    image.usage = 0;
+    image.firstPass = UINT32_MAX;
+    image.lastPass = 0;
+  }
+
+  _uses.resize(_order.size());
+  for (uint32_t position = 0; position < _order.size(); position++) {
+    const GraphPass &pass = _passes[_order[position]];
+    std::vector<Use> &uses = _uses[position];
+    uses.clear();
+
+    // one use per resource, so a pass gets at most one barrier for each
+    auto merge = [&](bool image, uint32_t index, const ResourceState &state,
+                     bool write) {
+      for (Use &use : uses) {
+        if (use.image != image || use.index != index) {
+          continue;
+        }
+        if (use.state.layout != state.layout) {
+          throw std::runtime_error(std::string("render graph pass ") +
+                                   pass._name + " uses image " +
+                                   _images[index].name +
+                                   " in two layouts!");
+        }
+        use.state.stages |= state.stages;
+        use.state.access |= state.access;
+        use.write = use.write || write;
+        return;
+      }
+      uses.push_back({image, index, state, write});
+    };
+
+    for (const auto &access : pass._images) {
+      merge(true, access.image, imageState(access.usage), access.write);
+
+      ImageResource &image = _images[access.image];
+      if (image.transient) {
+        image.usage |= imageUsageFlags(access.usage);
+        image.firstPass = std::min(image.firstPass, position);
+        image.lastPass = std::max(image.lastPass, position);
+      }
+    }
+    for (const auto &access : pass._buffers) {
+      merge(false, access.buffer, bufferState(access.usage), access.write);
+    }
+  }
+}
+
+uint64_t RenderGraph::transientSignature() const {
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (const ImageResource &image : _images) {
+    hashValue(hash, image.transient);
+    if (!image.transient) {
+      continue;
+    }
+    hashValue(hash, image.format);
+    hashValue(hash, image.extent.width);
+    hashValue(hash, image.extent.height);
+    hashValue(hash, image.samples);
+    hashValue(hash, image.usage);
+    hashValue(hash, image.firstPass);
+    hashValue(hash, image.lastPass);
+  }
+  return hash;
+}
+
+void RenderGraph::allocateTransients() {
+  FrameResources &frame = *_frame;
+  uint64_t signature = transientSignature();
+
+  // the same transients with the same lifetimes as the last time this
+  // frame slot came round, which is nearly every frame
+  if (!frame.built || frame.signature != signature) {
+    // the slot's fence has been waited on, nothing uses these anymore
+    releaseFrame(frame);
+    frame.signature = signature;
+    frame.built = true;
+    frame.images.assign(_images.size(), VK_NULL_HANDLE);
+    frame.views.assign(_images.size(), VK_NULL_HANDLE);
+    frame.imageBlocks.assign(_images.size(), UINT32_MAX);
+
+    std::vector<uint32_t> transients;
+    std::vector<VkMemoryRequirements> requirements(_images.size());
+    for (uint32_t i = 0; i < _images.size(); i++) {
+      const ImageResource &image = _images[i];
+      if (!image.transient || image.firstPass == UINT32_MAX) {
+        continue;
+      }
+
+      VkImageCreateInfo imageInfo{};
+      imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+      imageInfo.imageType = VK_IMAGE_TYPE_2D;
+      imageInfo.format = image.format;
+      imageInfo.extent = {image.extent.width, image.extent.height, 1};
+      imageInfo.mipLevels = 1;
+      imageInfo.arrayLayers = 1;
+      imageInfo.samples = image.samples;
+      imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+      imageInfo.usage = image.usage;
+      imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+      imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+      if (vkCreateImage(_device, &imageInfo, nullptr, &frame.images[i]) !=
+          VK_SUCCESS) {
+        throw std::runtime_error(std::string("failed to create render "
+                                             "graph image ") +
+                                 image.name + "!");
+      }
+      vkGetImageMemoryRequirements(_device, frame.images[i],
+                                   &requirements[i]);
+      transients.push_back(i);
+    }
+
+    // largest first, each image goes into the first block whose images
+    // are all dead before it starts or born after it ends
+    std::stable_sort(transients.begin(), transients.end(),
+                     [&](uint32_t a, uint32_t b) {
+                       return requirements[a].size > requirements[b].size;
+                     });
+
+    struct Block {
+      VkMemoryRequirements requirements;
+      std::vector<uint32_t> images;
+    };
+    std::vector<Block> blocks;
+    frame.unaliasedBytes = 0;
+
+    for (uint32_t index : transients) {
+      const ImageResource &image = _images[index];
+      const VkMemoryRequirements &required = requirements[index];
+      frame.unaliasedBytes += required.size;
+
+      Block *target = nullptr;
+      for (Block &block : blocks) {
+        if ((block.requirements.memoryTypeBits & required.memoryTypeBits) ==
+            0) {
+          continue;
+        }
+        bool overlaps = false;
+        for (uint32_t other : block.images) {
+          overlaps = overlaps || (image.firstPass <= _images[other].lastPass &&
+                                  _images[other].firstPass <= image.lastPass);
+        }
+        if (!overlaps) {
+          target = &block;
+          break;
+        }
+      }
+
+      if (target == nullptr) {
+        target = &blocks.emplace_back();
+        target->requirements = required;
+      } else {
+        target->requirements.size =
+            std::max(target->requirements.size, required.size);
+        target->requirements.alignment =
+            std::max(target->requirements.alignment, required.alignment);
+        target->requirements.memoryTypeBits &= required.memoryTypeBits;
+      }
+      frame.imageBlocks[index] =
+          static_cast<uint32_t>(target - blocks.data());
+      target->images.push_back(index);
+    }
+
+    frame.aliasedBytes = 0;
+    for (const Block &block : blocks) {
+      memory::Allocation allocation = _allocator->allocate(
+          block.requirements, memory::MemoryUsage::GpuOnly);
+      frame.blocks.push_back(allocation);
+      frame.aliasedBytes += block.requirements.size;
+
+      for (uint32_t index : block.images) {
+        if (vkBindImageMemory(_device, frame.images[index], allocation.memory,
+                              allocation.offset) != VK_SUCCESS) {
+          throw std::runtime_error("failed to bind render graph image!");
+        }
+      }
+    }
+
+    for (uint32_t index : transients) {
+      const ImageResource &image = _images[index];
+
+      VkImageViewCreateInfo viewInfo{};
+      viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+      viewInfo.image = frame.images[index];
+      viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+      viewInfo.format = image.format;
+      viewInfo.subresourceRange.aspectMask = isDepthFormat(image.format)
+                                                 ? VK_IMAGE_ASPECT_DEPTH_BIT
+                                                 : VK_IMAGE_ASPECT_COLOR_BIT;
+      viewInfo.subresourceRange.levelCount = 1;
+      viewInfo.subresourceRange.layerCount = 1;
+
+      if (vkCreateImageView(_device, &viewInfo, nullptr,
+                            &frame.views[index]) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create render graph image view!");
+      }
+    }
+  }
+
+  for (uint32_t i = 0; i < _images.size(); i++) {
+    if (_images[i].transient) {
+      _images[i].image = frame.images[i];
+      _images[i].view = frame.views[i];
+      _images[i].block = frame.imageBlocks[i];
+    }
+  }
+}
+
+void RenderGraph::releaseFrame(FrameResources &frame) {
+  for (VkImageView view : frame.views) {
+    if (view != VK_NULL_HANDLE) {
+      vkDestroyImageView(_device, view, nullptr);
+    }
+  }
+  for (VkImage image : frame.images) {
+    if (image != VK_NULL_HANDLE) {
+      vkDestroyImage(_device, image, nullptr);
+    }
+  }
+  for (memory::Allocation &allocation : frame.blocks) {
+    _allocator->free(allocation);
+  }
+
+  frame.views.clear();
+  frame.images.clear();
+  frame.imageBlocks.clear();
+  frame.blocks.clear();
+  frame.built = false;
+}
+
+void RenderGraph::buildBarriers() {
+  std::vector<Tracker> &imageTrackers = _imageTrackers;
+  std::vector<Tracker> &bufferTrackers = _bufferTrackers;
+  imageTrackers.assign(_images.size(), Tracker{});
+  bufferTrackers.assign(_buffers.size(), Tracker{});
+
+  // the initial state is what the first use has to wait for, like the
+  // stage a swapchain image's acquire semaphore is waited on in
+  for (size_t i = 0; i < _images.size(); i++) {
+    const ResourceState &initial = _images[i].initial;
+    imageTrackers[i].layout = initial.layout;
+    imageTrackers[i].writeStages = initial.stages;
+    imageTrackers[i].writeAccess = initial.access & writeAccessMask;
+  }
+  for (size_t i = 0; i < _buffers.size(); i++) {
+    const ResourceState &initial = _buffers[i].initial;
+    bufferTrackers[i].writeStages = initial.stages;
+    bufferTrackers[i].writeAccess = initial.access & writeAccessMask;
+  }
+
+  // the transient last placed in each block
+  std::vector<uint32_t> &blockOwners = _blockOwners;
+  blockOwners.assign(_frame->blocks.size(), UINT32_MAX);
+
+  _passBarriers.resize(_order.size());
+  for (uint32_t position = 0; position < _order.size(); position++) {
+    Barriers &barriers = _passBarriers[position];
+    barriers.images.clear();
+    barriers.buffers.clear();
+
+    for (const Use &use : _uses[position]) {
+      VkPipelineStageFlags2 srcStages;
+      VkAccessFlags2 srcAccess;
+
+      if (!use.image) {
+        Tracker &tracker = bufferTrackers[use.index];
+        if (transition(tracker, use.state, use.write, srcStages, srcAccess)) {
+          addBufferBarrier(barriers, _buffers[use.index], use.state,
+                           srcStages, srcAccess);
+        }
+        continue;
+      }
+
+      const ImageResource &image = _images[use.index];
+      Tracker &tracker = imageTrackers[use.index];
+
+      if (image.transient && image.firstPass == position) {
+        if (!use.write) {
+          throw std::runtime_error(std::string("render graph image ") +
+                                   image.name +
+                                   " is read before it is written!");
+        }
+        // an aliased image starts where the previous one in its memory
+        // left off, its first use waits for everything done to that one
+        uint32_t &owner = blockOwners[image.block];
+        if (owner != UINT32_MAX) {
+          const Tracker &previous = imageTrackers[owner];
+          tracker.writeStages = previous.writeStages | previous.readStages;
+          tracker.writeAccess = previous.writeAccess;
+        }
+        owner = use.index;
+      }
+
+      VkImageLayout oldLayout = tracker.layout;
+      if (transition(tracker, use.state, use.write, srcStages, srcAccess)) {
+        addImageBarrier(barriers, image, oldLayout, use.state, srcStages,
+                        srcAccess);
+      }
+    }
+  }
+
+  // imported resources are handed back in the state they were promised in
+  _finalBarriers.images.clear();
+  _finalBarriers.buffers.clear();
+  for (size_t i = 0; i < _images.size(); i++) {
+    const ImageResource &image = _images[i];
+    if (image.transient) {
+      continue;
+    }
+
+    VkPipelineStageFlags2 srcStages;
+    VkAccessFlags2 srcAccess;
+    VkImageLayout oldLayout = imageTrackers[i].layout;
+    if (transition(imageTrackers[i], image.final, false, srcStages,
+                   srcAccess)) {
+      addImageBarrier(_finalBarriers, image, oldLayout, image.final,
+                      srcStages, srcAccess);
+    }
+  }
+  for (size_t i = 0; i < _buffers.size(); i++) {
+    VkPipelineStageFlags2 srcStages;
+    VkAccessFlags2 srcAccess;
+    if (transition(bufferTrackers[i], _buffers[i].final, false, srcStages,
+                   srcAccess)) {
+      addBufferBarrier(_finalBarriers, _buffers[i], _buffers[i].final,
+                       srcStages, srcAccess);
+    }
+  }
+}
+
+bool RenderGraph::transition(Tracker &tracker, const ResourceState &state,
+                             bool write, VkPipelineStageFlags2 &srcStages,
+                             VkAccessFlags2 &srcAccess) const {
+  bool layoutChange = tracker.layout != state.layout;
+
+  if (write || layoutChange) {
+    // waits for the last write and every read since, a layout transition
+    // is a write as well
+    srcStages = tracker.writeStages | tracker.readStages;
+    srcAccess = tracker.writeAccess;
+    bool needed = srcStages != VK_PIPELINE_STAGE_2_NONE || layoutChange;
+
+    tracker.layout = state.layout;
+    tracker.writeStages = state.stages;
+    tracker.writeAccess = write ? state.access & writeAccessMask
+                                : VK_ACCESS_2_NONE;
+    tracker.readStages = VK_PIPELINE_STAGE_2_NONE;
+    // the barrier made a transition visible to its own reader, a write is
+    // not visible to anyone yet
+    tracker.visibleStages = write ? VK_PIPELINE_STAGE_2_NONE : state.stages;
+    tracker.visibleAccess = write ? VK_ACCESS_2_NONE : state.access;
+    return needed;
+  }
+
+  // a read only waits when the last write is not yet visible to it, so
+  // readers after the first one usually need nothing
+  tracker.readStages |= state.stages;
+  if (tracker.writeStages == VK_PIPELINE_STAGE_2_NONE ||
+      ((state.stages & ~tracker.visibleStages) == 0 &&
+       (state.access & ~tracker.visibleAccess) == 0)) {
+    return false;
+  }
+
+  srcStages = tracker.writeStages;
+  srcAccess = tracker.writeAccess;
+  tracker.visibleStages |= state.stages;
+  tracker.visibleAccess |= state.access;
+  return true;
+}
+
+void RenderGraph::addImageBarrier(Barriers &barriers,
+                                  const ImageResource &image,
+                                  VkImageLayout oldLayout,
+                                  const ResourceState &state,
+                                  VkPipelineStageFlags2 srcStages,
+                                  VkAccessFlags2 srcAccess) const {
+  VkImageMemoryBarrier2 barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+  barrier.srcStageMask = srcStages;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstStageMask = state.stages;
+  barrier.dstAccessMask = state.access;
+  barrier.oldLayout = oldLayout;
+  barrier.newLayout = state.layout;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image.image;
+  barrier.subresourceRange.aspectMask = barrierAspect(image.format);
+  barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+  barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+  barriers.images.push_back(barrier);
+}
+
+void RenderGraph::addBufferBarrier(Barriers &barriers,
+                                   const BufferResource &buffer,
+                                   const ResourceState &state,
+                                   VkPipelineStageFlags2 srcStages,
+                                   VkAccessFlags2 srcAccess) const {
+  VkBufferMemoryBarrier2 barrier{};
+  barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+  barrier.srcStageMask = srcStages;
+  barrier.srcAccessMask = srcAccess;
+  barrier.dstStageMask = state.stages;
+  barrier.dstAccessMask = state.access;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.buffer = buffer.buffer;
+  barrier.size = VK_WHOLE_SIZE;
+  barriers.buffers.push_back(barrier);
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer,
+                                 const Barriers &barriers) const {
+  if (barriers.images.empty() && barriers.buffers.empty()) {
+    return;
+  }
+
+  VkDependencyInfo dependency{};
+  dependency.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+  dependency.bufferMemoryBarrierCount =
+      static_cast<uint32_t>(barriers.buffers.size());
+  dependency.pBufferMemoryBarriers = barriers.buffers.data();
+  dependency.imageMemoryBarrierCount =
+      static_cast<uint32_t>(barriers.images.size());
+  dependency.pImageMemoryBarriers = barriers.images.data();
+  vkCmdPipelineBarrier2(commandBuffer, &dependency);
+}
+
+void RenderGraph::beginRendering(VkCommandBuffer commandBuffer,
+                                 const GraphPass &pass,
+                                 uint32_t position) {
+  // nothing reads a transient after its last pass, so it is not stored
+  auto storeOp = [&](const ImageResource &image) {
+    return image.transient && image.lastPass == position
+               ? VK_ATTACHMENT_STORE_OP_DONT_CARE
+               : VK_ATTACHMENT_STORE_OP_STORE;
+  };
+
+  std::vector<VkRenderingAttachmentInfo> &colorAttachments =
+      _colorAttachmentInfos;
+  colorAttachments.clear();
+  VkExtent2D extent{};
+
+  for (const auto &attachment : pass._colorAttachments) {
+    const ImageResource &image = _images[attachment.image];
+    extent = image.extent;
+
+    VkRenderingAttachmentInfo &info = colorAttachments.emplace_back();
+    info = {};
+    info.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    info.imageView = image.view;
+    info.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+    info.loadOp = attachment.loadOp;
+    info.storeOp = storeOp(image);
+    info.clearValue = attachment.clear;
+  }
+
+  VkRenderingAttachmentInfo depthAttachment{};
+  bool hasDepth = pass._depthAttachment.image != UINT32_MAX;
+  if (hasDepth) {
+    const ImageResource &image = _images[pass._depthAttachment.image];
+    extent = image.extent;
+
+    depthAttachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+    depthAttachment.imageView = image.view;
+    depthAttachment.imageLayout =
+        VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+    depthAttachment.loadOp = pass._depthAttachment.loadOp;
+    depthAttachment.storeOp = storeOp(image);
+    depthAttachment.clearValue = pass._depthAttachment.clear;
+  }
+
+  VkRenderingInfo renderingInfo{};
+  renderingInfo.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+  renderingInfo.flags = pass._renderingFlags;
+  renderingInfo.renderArea = {{0, 0}, extent};
+  renderingInfo.layerCount = 1;
+  renderingInfo.colorAttachmentCount =
+      static_cast<uint32_t>(colorAttachments.size());
+  renderingInfo.pColorAttachments = colorAttachments.data();
+  renderingInfo.pDepthAttachment = hasDepth ? &depthAttachment : nullptr;
+
+  vkCmdBeginRendering(commandBuffer, &renderingInfo);
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer,
+                          profiling::GpuProfiler *profiler) {
+  if (!_compiled) {
+    throw std::runtime_error("render graph executed before compile!");
+  }
+
+  for (uint32_t position = 0; position < _order.size(); position++) {
+    const GraphPass &pass = _passes[_order[position]];
+    recordBarriers(commandBuffer, _passBarriers[position]);
+
+    uint32_t scope = UINT32_MAX;
+    if (profiler != nullptr) {
+      scope = profiler->beginScope(commandBuffer, pass._name);
+    }
+
+    bool rendering = !pass._colorAttachments.empty() ||
+                     pass._depthAttachment.image != UINT32_MAX;
+    if (rendering) {
+      beginRendering(commandBuffer, pass, position);
+    }
+    if (pass._function.invoke != nullptr) {
+      pass._function.invoke(pass._function.object, commandBuffer, *this);
+    }
+    if (rendering) {
+      vkCmdEndRendering(commandBuffer);
+    }
+
+    if (profiler != nullptr) {
+      profiler->endScope(commandBuffer, scope);
+    }
+  }
+
+  recordBarriers(commandBuffer, _finalBarriers);
+}
+
+VkImage RenderGraph::image(GraphImage image) const {
+  return _images[image.index].image;
+}
+
+VkImageView RenderGraph::view(GraphImage image) const {
+  return _images[image.index].view;
+}
+
+VkFormat RenderGraph::format(GraphImage image) const {
+  return _images[image.index].format;
+}
+
+VkExtent2D RenderGraph::extent(GraphImage image) const {
+  return _images[image.index].extent;
+}
+
+VkBuffer RenderGraph::buffer(GraphBuffer buffer) const {
+  return _buffers[buffer.index].buffer;
+}
+
+void RenderGraph::print(std::ostream &out) const {
+  if (_frame == nullptr || _frame->blocks.empty()) {
+    return;
+  }
+  out << "render graph: " << _frame->blocks.size() << " transient blocks, "
+      << mebibytes(_frame->aliasedBytes) << " instead of "
+      << mebibytes(_frame->unaliasedBytes) << std::endl;
+}
+
+} // namespace rendering
@@ -0,0 +1,382 @@
+#include "rendering/shaderCompiler.hpp"
+#include "profiling/cpuProfiler.hpp"
+
+#include <shaderc/shaderc.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+// which shaderc, glslang and SPIRV-Tools the binary was built against, set
+// by the build
+#ifndef ENGINE_SHADER_COMPILER_ID
+#define ENGINE_SHADER_COMPILER_ID "unknown"
+#endif
+
+namespace fs = std::filesystem;
+
+namespace rendering {
+
+namespace {
+
+// bump whenever the cache file layout or the compile options change shape
+constexpr uint32_t shaderCacheVersion = 2;
+constexpr uint32_t shaderCacheMagic = 0x43565053; // "SPVC"
+
+// part of every cache key, a binary built for another target is a miss
+constexpr shaderc_target_env targetEnvironment = shaderc_target_env_vulkan;
+constexpr shaderc_env_version targetEnvironmentVersion =
+    shaderc_env_version_vulkan_1_3;
+constexpr shaderc_spirv_version targetSpirvVersion =
+    shaderc_spirv_version_1_6;
+
+struct CacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t key;
+  uint64_t wordCount;
+};
+
+constexpr uint64_t fnvOffsetBasis = 0xcbf29ce484222325ull;
+
+void hashBytes(uint64_t &hash, const void *data, size_t size) {
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  for (size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+}
+
+void hashString(uint64_t &hash, const std::string &value) {
+  // length prefix keeps ("ab", "c") and ("a", "bc") apart
+  uint64_t size = value.size();
+  hashBytes(hash, &size, sizeof(size));
+  hashBytes(hash, value.data(), value.size());
+}
+
+std::string readFile(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    throw std::runtime_error("failed to open file " + path + "!");
+  }
+  std::stringstream buffer;
+  buffer << file.rdbuf();
+  return buffer.str();
+}
+
+// relative includes are looked up next to the including file first, then
+// in the shader directory like a system include
+std::string resolveInclude(const std::string &shaderDir,
+                           const std::string &requested,
+                           const std::string &requesting) {
+  fs::path relative = fs::path(requesting).parent_path() / requested;
+  if (fs::exists(relative)) {
+    return relative.lexically_normal().string();
+  }
+  return (fs::path(shaderDir) / requested).lexically_normal().string();
+}
+
+shaderc_shader_kind shaderKind(VkShaderStageFlagBits stage) {
+  switch (stage) {
+  case VK_SHADER_STAGE_VERTEX_BIT:
+    return shaderc_vertex_shader;
+  case VK_SHADER_STAGE_FRAGMENT_BIT:
+    return shaderc_fragment_shader;
+  case VK_SHADER_STAGE_COMPUTE_BIT:
+    return shaderc_compute_shader;
+  case VK_SHADER_STAGE_GEOMETRY_BIT:
+    return shaderc_geometry_shader;
+  case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:
+    return shaderc_tess_control_shader;
+  case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT:
+    return shaderc_tess_evaluation_shader;
+  default:
+    return shaderc_glsl_infer_from_source;
+  }
+}
+
+class Includer : public shaderc::CompileOptions::IncluderInterface {
+public:
+  explicit Includer(std::string shaderDir)
+      : _shaderDir(std::move(shaderDir)) {}
+
+  shaderc_include_result *GetInclude(const char *requestedSource,
+                                     shaderc_include_type type,
+                                     const char *requestingSource,
+                                     size_t includeDepth) override {
+    auto *include = new IncludeData;
+    include->name = resolveInclude(_shaderDir, requestedSource,
+                                   requestingSource);
+    try {
+      include->content = readFile(include->name);
+    } catch (const std::exception &e) {
+      // an empty name tells shaderc the include failed, content is the error
+      include->content = e.what();
+      include->name.clear();
+    }
+
+    include->result.source_name = include->name.c_str();
+    include->result.source_name_length = include->name.size();
+    include->result.content = include->content.c_str();
+    include->result.content_length = include->content.size();
+    include->result.user_data = include;
+    return &include->result;
+  }
+
+  void ReleaseInclude(shaderc_include_result *data) override {
+    delete static_cast<IncludeData *>(data->user_data);
+  }
+
+private:
+  struct IncludeData {
+    std::string name;
+    std::string content;
+    shaderc_include_result result;
+  };
+
+  std::string _shaderDir;
+};
+
+} // namespace
+
+ShaderCompiler::ShaderCompiler(std::string shaderDir, std::string cacheDir,
+                               bool optimize, jobs::JobSystem *jobs)
+    : _shaderDir(std::move(shaderDir)), _cacheDir(std::move(cacheDir)),
+      _optimize(optimize), _jobs(jobs) {
+  std::error_code error;
+  fs::create_directories(_cacheDir, error);
+}
+
+ShaderBinary ShaderCompiler::compile(const ShaderSource &source) {
+  return compileAll({source}).front();
+}
+
+std::vector<ShaderBinary>
+ShaderCompiler::compileAll(const std::vector<ShaderSource> &sources) {
+  std::vector<ShaderBinary> binaries(sources.size());
+  std::vector<std::string> texts(sources.size());
+  std::vector<size_t> misses;
+
+  for (size_t i = 0; i < sources.size(); i++) {
+    binaries[i].key = computeKey(sources[i], texts[i]);
+    if (loadCached(binaries[i].key, binaries[i].spirv)) {
+      binaries[i].fromCache = true;
+    } else {
+      misses.push_back(i);
+    }
+  }
+
+  if (misses.empty()) {
+    return binaries;
+  }
+
+  auto compileMisses = [&](uint32_t begin, uint32_t end) {
+    for (uint32_t miss = begin; miss < end; miss++) {
+      PROFILE_SCOPE("compileShader");
+      size_t i = misses[miss];
+      binaries[i].spirv = compileGlsl(sources[i], texts[i]);
+      storeCached(binaries[i].key, binaries[i].spirv);
+    }
+  };
+
+  uint32_t missCount = static_cast<uint32_t>(misses.size());
+  if (_jobs != nullptr) {
+    // wait() keeps this thread busy with other jobs and rethrows the first
+    // compile error
+    jobs::Counter counter;
+    _jobs->parallelFor(missCount, 1, compileMisses, counter);
+    _jobs->wait(counter);
+  } else {
+    compileMisses(0, missCount);
+  }
+
+  std::cout << "compiled " << misses.size() << " shaders, "
+            << sources.size() - misses.size() << " from cache" << std::endl;
+  return binaries;
+}
+
+VkShaderModule ShaderCompiler::createModule(VkDevice device,
+                                            const ShaderBinary &binary) {
+  VkShaderModuleCreateInfo createInfo{};
+  createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  createInfo.codeSize = binary.spirv.size() * sizeof(uint32_t);
+  createInfo.pCode = binary.spirv.data();
+
+  VkShaderModule shaderModule;
+  if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create shader module!");
+  }
+  return shaderModule;
+}
+
+uint64_t ShaderCompiler::key(const ShaderSource &source) {
+  std::string text;
+  return computeKey(source, text);
+}
+
+uint64_t ShaderCompiler::computeKey(const ShaderSource &source,
+                                    std::string &text) {
+  std::string path = (fs::path(_shaderDir) / source.path).string();
+  text = readFile(path);
+
+  uint64_t hash = fnvOffsetBasis;
+  hashBytes(hash, &shaderCacheVersion, sizeof(shaderCacheVersion));
+
+  // a compiler update can change the SPIR-V it emits for the same source
+  hashString(hash, ENGINE_SHADER_COMPILER_ID);
+  hashBytes(hash, &targetEnvironment, sizeof(targetEnvironment));
+  hashBytes(hash, &targetEnvironmentVersion,
+            sizeof(targetEnvironmentVersion));
+  hashBytes(hash, &targetSpirvVersion, sizeof(targetSpirvVersion));
+  hashString(hash, text);
+
+  std::vector<std::string> visited = {path};
+  hashIncludes(path, text, hash, visited);
+
+  // define order does not change the output, so do not let it miss the cache
+  auto defines = source.defines;
+  std::sort(defines.begin(), defines.end());
+  for (const auto &[name, value] : defines) {
+    hashString(hash, name);
+    hashString(hash, value);
+  }
+
+  uint32_t stage = source.stage;
+  hashBytes(hash, &stage, sizeof(stage));
+  hashString(hash, source.entryPoint);
+  hashBytes(hash, &_optimize, sizeof(_optimize));
+
+  return hash;
+}
+
+void ShaderCompiler::hashIncludes(const std::string &path,
+                                  const std::string &text, uint64_t &hash,
+                                  std::vector<std::string> &visited) {
+  std::istringstream lines(text);
+  std::string line;
+  while (std::getline(lines, line)) {
+    size_t directive = line.find("#include");
+    if (directive == std::string::npos ||
+        line.find_first_not_of(" \t") != directive) {
+      continue;
+    }
+
+    size_t open = line.find_first_of("\"<", directive);
+    size_t close = line.find_first_of("\">", open + 1);
+    if (open == std::string::npos || close == std::string::npos) {
+      continue;
+    }
+
+    std::string include = resolveInclude(
+        _shaderDir, line.substr(open + 1, close - open - 1), path);
+    if (std::find(visited.begin(), visited.end(), include) != visited.end()) {
+      continue;
+    }
+    visited.push_back(include);
+
+    // a missing include is reported by shaderc, it still has to change the key
+    std::string content;
+    try {
+      content = readFile(include);
+    } catch (const std::exception &) {
+    }
+    hashString(hash, include);
+    hashString(hash, content);
+    hashIncludes(include, content, hash, visited);
+  }
+}
+
+std::string ShaderCompiler::cachePath(uint64_t key) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.spv",
+           static_cast<unsigned long long>(key));
+  return (fs::path(_cacheDir) / name).string();
+}
+
+bool ShaderCompiler::loadCached(uint64_t key, std::vector<uint32_t> &spirv) {
+  std::ifstream file(cachePath(key), std::ios::binary);
+  if (!file) {
+    return false;
+  }
+
+  CacheHeader header;
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)) ||
+      header.magic != shaderCacheMagic ||
+      header.version != shaderCacheVersion || header.key != key) {
+    return false;
+  }
+
+  spirv.resize(header.wordCount);
+  return static_cast<bool>(
+      file.read(reinterpret_cast<char *>(spirv.data()),
+                static_cast<std::streamsize>(spirv.size() * sizeof(uint32_t))));
+}
+
+void ShaderCompiler::storeCached(uint64_t key,
+                                 const std::vector<uint32_t> &spirv) {
+  // write then rename, so a reader never sees a partially written file.
+  // The suffix is random, other processes may share the cache directory
+  thread_local std::mt19937_64 random(std::random_device{}());
+  std::string path = cachePath(key);
+  std::string temporary = path + "." + std::to_string(random());
+
+  {
+    std::ofstream file(temporary, std::ios::binary);
+    if (!file) {
+      return;
+    }
+
+    CacheHeader header{shaderCacheMagic, shaderCacheVersion, key,
+                       spirv.size()};
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char *>(spirv.data()),
+               static_cast<std::streamsize>(spirv.size() * sizeof(uint32_t)));
+  }
+
+  std::error_code error;
+  fs::rename(temporary, path, error);
+  if (error) {
+    fs::remove(temporary, error);
+  }
+}
+
+std::vector<uint32_t> ShaderCompiler::compileGlsl(const ShaderSource &source,
+                                                  const std::string &text) {
+  // compilers are cheap to create and not shared between worker threads
+  shaderc::Compiler compiler;
+  shaderc::CompileOptions options;
+
+  options.SetTargetEnvironment(targetEnvironment, targetEnvironmentVersion);
+  options.SetTargetSpirv(targetSpirvVersion);
+  options.SetOptimizationLevel(_optimize
+                                   ? shaderc_optimization_level_performance
+                                   : shaderc_optimization_level_zero);
+  if (!_optimize) {
+    options.SetGenerateDebugInfo();
+  }
+  for (const auto &[name, value] : source.defines) {
+    options.AddMacroDefinition(name, value);
+  }
+  options.SetIncluder(std::make_unique<Includer>(_shaderDir));
+
+  std::string path = (fs::path(_shaderDir) / source.path).string();
+  shaderc::SpvCompilationResult result = compiler.CompileGlslToSpv(
+      text, shaderKind(source.stage), path.c_str(), source.entryPoint.c_str(),
+      options);
+
+  if (result.GetCompilationStatus() != shaderc_compilation_status_success) {
+    throw std::runtime_error("failed to compile shader " + source.path +
+                             "!\n" + result.GetErrorMessage());
+  }
+
+  return {result.cbegin(), result.cend()};
+}
+
+} // namespace rendering
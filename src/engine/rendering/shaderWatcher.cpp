@@ -0,0 +1,130 @@
+#include "rendering/shaderWatcher.hpp"
+
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace rendering {
+
+namespace {
+
+// how long the directory has to stay quiet before a change is reported
+constexpr std::chrono::milliseconds settleTime{100};
+
+#ifdef __linux__
+// written in place, saved through a rename, or added and removed
+constexpr uint32_t watchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM |
+                               IN_CREATE | IN_DELETE | IN_ONLYDIR;
+#endif
+
+} // namespace
+
+ShaderWatcher::~ShaderWatcher() { destroy(); }
+
+void ShaderWatcher::create(const std::string &shaderDir) {
+#ifdef __linux__
+  _fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (_fd < 0) {
+    throw std::runtime_error("failed to create shader watcher!");
+  }
+
+  watchDirectory(shaderDir);
+  std::error_code error;
+  for (const auto &entry :
+       fs::recursive_directory_iterator(shaderDir, error)) {
+    if (entry.is_directory()) {
+      watchDirectory(entry.path().string());
+    }
+  }
+
+  _changed = false;
+  std::cout << "watching " << _directories.size()
+            << " shader directories for changes" << std::endl;
+#else
+  (void)shaderDir;
+  std::cout << "shader hot reload needs inotify, shaders are not watched"
+            << std::endl;
+#endif
+}
+
+void ShaderWatcher::destroy() {
+#ifdef __linux__
+  if (_fd >= 0) {
+    // closing the descriptor drops every watch with it
+    close(_fd);
+  }
+#endif
+  _fd = -1;
+  _directories.clear();
+}
+
+bool ShaderWatcher::poll() {
+#ifdef __linux__
+  if (_fd < 0) {
+    return false;
+  }
+
+  alignas(inotify_event) char buffer[4096];
+  while (true) {
+    ssize_t size = read(_fd, buffer, sizeof(buffer));
+    if (size <= 0) {
+      // EAGAIN once drained, anything else is not worth stopping a frame
+      break;
+    }
+
+    for (ssize_t offset = 0; offset < size;) {
+      const auto *event =
+          reinterpret_cast<const inotify_event *>(buffer + offset);
+      offset += sizeof(inotify_event) + event->len;
+
+      if (event->mask & IN_IGNORED) {
+        _directories.erase(event->wd);
+        continue;
+      }
+      if ((event->mask & IN_ISDIR) && (event->mask & IN_CREATE)) {
+        auto it = _directories.find(event->wd);
+        if (it != _directories.end() && event->len > 0) {
+          watchDirectory((fs::path(it->second) / event->name).string());
+        }
+      }
+      // anything else counts, including an overflowed queue that lost
+      // the events themselves
+      _changed = true;
+      _lastChange = std::chrono::steady_clock::now();
+    }
+  }
+
+  if (!_changed ||
+      std::chrono::steady_clock::now() - _lastChange < settleTime) {
+    return false;
+  }
+  _changed = false;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void ShaderWatcher::watchDirectory(const std::string &path) {
+#ifdef __linux__
+  int watch = inotify_add_watch(_fd, path.c_str(), watchMask);
+  if (watch < 0) {
+    std::cerr << "failed to watch shader directory " << path << std::endl;
+    return;
+  }
+  _directories[watch] = path;
+#else
+  (void)path;
+#endif
+}
+
+} // namespace rendering
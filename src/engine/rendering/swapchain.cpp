@@ -60,7 +60,7 @@ Swapchain::chooseSwapPresentMode(VkPresentModeKHR presentMode) {
 }
 
 VkExtent2D Swapchain::chooseSwapExtent(GLFWwindow *window) {
-  VkSurfaceCapabilitiesKHR capabilities;
+  const VkSurfaceCapabilitiesKHR &capabilities = _details.capabilities;
   if (capabilities.currentExtent.width != UINT32_MAX) {
     return capabilities.currentExtent;
   }
@@ -82,7 +82,8 @@ VkExtent2D Swapchain::chooseSwapExtent(GLFWwindow *window) {
 }
 
 void Swapchain::create(VkDevice &device, GLFWwindow *window,
-                       engine::QueueFamilyIndices indices) {
+                       engine::QueueFamilyIndices indices,
+                       VkSwapchainKHR oldSwapchain) {
   VkSurfaceFormatKHR format = chooseSwapSurfaceFormat(
       VK_FORMAT_B8G8R8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR);
   VkPresentModeKHR presentMode =
@@ -120,7 +121,7 @@ void Swapchain::create(VkDevice &device, GLFWwindow *window,
   createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
   createInfo.presentMode = presentMode;
   createInfo.clipped = VK_TRUE;
-  createInfo.oldSwapchain = VK_NULL_HANDLE;
+  createInfo.oldSwapchain = oldSwapchain;
 
   if (vkCreateSwapchainKHR(device, &createInfo, nullptr, &_swapchain) !=
       VK_SUCCESS) {
@@ -0,0 +1,487 @@
+#include "rendering/uploader.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+namespace rendering {
+
+namespace {
+
+// everything that may read uploaded data on the graphics queue
+constexpr VkPipelineStageFlags consumerStages =
+    VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+    VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT |
+    VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+constexpr VkAccessFlags bufferConsumerAccess =
+    VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT |
+    VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT |
+    VK_ACCESS_SHADER_READ_BIT;
+
+} // namespace
+
+Uploader::~Uploader() { destroy(); }
+
+void Uploader::create(memory::Allocator &allocator,
+                      VkPhysicalDevice physicalDevice,
+                      const UploadQueueInfo &transfer,
+                      uint32_t graphicsFamily, VkDeviceSize stagingSize) {
+  _allocator = &allocator;
+  _device = allocator.device();
+  _queue = transfer.queue;
+  _submitMutex = transfer.submitMutex;
+  _transferFamily = transfer.family;
+  _graphicsFamily = graphicsFamily;
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+  _alignment = std::max<VkDeviceSize>(
+      16, properties.limits.optimalBufferCopyOffsetAlignment);
+
+  _stagingSize = stagingSize;
+  _staging = allocator.createBuffer(stagingSize,
+                                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                    memory::MemoryUsage::CpuToGpu);
+
+  VkSemaphoreTypeCreateInfo typeInfo{};
+  typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+  typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  typeInfo.initialValue = 0;
+
+  VkSemaphoreCreateInfo semaphoreInfo{};
+  semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  semaphoreInfo.pNext = &typeInfo;
+
+  if (vkCreateSemaphore(_device, &semaphoreInfo, nullptr, &_timeline) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to create timeline semaphore!");
+  }
+}
+
+void Uploader::destroy() {
+  if (_allocator == nullptr) {
+    return;
+  }
+
+  // the batches still reference the staging ring
+  waitIdle();
+
+  auto destroyBatch = [this](std::unique_ptr<Batch> &batch) {
+    if (batch) {
+      vkDestroyCommandPool(_device, batch->pool, nullptr);
+    }
+  };
+  destroyBatch(_recording);
+  for (auto &batch : _inFlight) {
+    destroyBatch(batch);
+  }
+  for (auto &batch : _freeBatches) {
+    destroyBatch(batch);
+  }
+  _recording.reset();
+  _inFlight.clear();
+  _freeBatches.clear();
+
+  vkDestroySemaphore(_device, _timeline, nullptr);
+  _allocator->destroyBuffer(_staging);
+  _allocator = nullptr;
+}
+
+uint64_t Uploader::uploadBuffer(VkBuffer buffer, VkDeviceSize offset,
+                                const void *data, VkDeviceSize size) {
+  if (size == 0) {
+    throw std::runtime_error("buffer upload is empty!");
+  }
+  std::unique_lock<std::mutex> lock(_mutex);
+
+  // big buffers go through in pieces so they never need the whole ring
+  VkDeviceSize pieceSize = _stagingSize / 4;
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  for (VkDeviceSize done = 0; done < size;) {
+    VkDeviceSize piece = std::min(pieceSize, size - done);
+    VkDeviceSize stagingOffset = allocateStaging(lock, piece);
+    std::memcpy(static_cast<uint8_t *>(_staging.allocation.mapped) +
+                    stagingOffset,
+                bytes + done, piece);
+
+    VkBufferCopy copy{};
+    copy.srcOffset = stagingOffset;
+    copy.dstOffset = offset + done;
+    copy.size = piece;
+    vkCmdCopyBuffer(recordingBatch().commandBuffer, _staging.buffer, buffer,
+                    1, &copy);
+    done += piece;
+  }
+
+  Batch &batch = recordingBatch();
+  VkBufferMemoryBarrier release{};
+  release.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+  release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  release.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  release.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  release.buffer = buffer;
+  release.offset = offset;
+  release.size = size;
+
+  if (ownershipTransfer()) {
+    // the release half, the acquire half runs on the graphics queue
+    release.srcQueueFamilyIndex = _transferFamily;
+    release.dstQueueFamilyIndex = _graphicsFamily;
+
+    VkBufferMemoryBarrier acquire = release;
+    acquire.srcAccessMask = 0;
+    acquire.dstAccessMask = bufferConsumerAccess;
+    batch.bufferAcquires.push_back(acquire);
+  }
+
+  vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1,
+                       &release, 0, nullptr);
+  return _nextValue;
+}
+
+uint64_t Uploader::uploadImage(VkImage image,
+                               const VkImageSubresourceRange &range,
+                               const std::vector<VkBufferImageCopy> &regions,
+                               const void *data, VkDeviceSize size) {
+  if (regions.empty()) {
+    throw std::runtime_error("image upload has no regions!");
+  }
+  std::unique_lock<std::mutex> lock(_mutex);
+
+  Batch &batch = recordingBatch();
+
+  VkImageMemoryBarrier toTransfer{};
+  toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  toTransfer.srcAccessMask = 0;
+  toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  toTransfer.image = image;
+  toTransfer.subresourceRange = range;
+
+  vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &toTransfer);
+
+  // a region's bytes run up to the next region's, so consecutive regions
+  // are staged together until a piece is full. Only a single mip has to
+  // fit in the ring
+  std::vector<VkBufferImageCopy> copies = regions;
+  std::sort(copies.begin(), copies.end(),
+            [](const VkBufferImageCopy &a, const VkBufferImageCopy &b) {
+              return a.bufferOffset < b.bufferOffset;
+            });
+  auto regionEnd = [&](size_t i) {
+    return i + 1 < copies.size() ? copies[i + 1].bufferOffset : size;
+  };
+
+  VkDeviceSize pieceSize = _stagingSize / 4;
+  const auto *bytes = static_cast<const uint8_t *>(data);
+  for (size_t first = 0; first < copies.size();) {
+    VkDeviceSize begin = copies[first].bufferOffset;
+    size_t last = first + 1;
+    while (last < copies.size() && regionEnd(last) - begin <= pieceSize) {
+      last++;
+    }
+    VkDeviceSize piece = regionEnd(last - 1) - begin;
+    if (piece > _stagingSize || regionEnd(last - 1) > size) {
+      throw std::runtime_error("image region does not fit the staging ring!");
+    }
+
+    VkDeviceSize stagingOffset = allocateStaging(lock, piece);
+    std::memcpy(static_cast<uint8_t *>(_staging.allocation.mapped) +
+                    stagingOffset,
+                bytes + begin, piece);
+    for (size_t i = first; i < last; i++) {
+      copies[i].bufferOffset += stagingOffset - begin;
+    }
+    // an earlier piece may have flushed the batch the transition is in,
+    // barriers order everything later on the queue
+    vkCmdCopyBufferToImage(recordingBatch().commandBuffer, _staging.buffer,
+                           image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                           static_cast<uint32_t>(last - first),
+                           copies.data() + first);
+    first = last;
+  }
+
+  // the layout change happens in the release, and is repeated identically
+  // by the acquire as the spec requires
+  Batch &releaseBatch = recordingBatch();
+  VkImageMemoryBarrier release = toTransfer;
+  release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  release.dstAccessMask = 0;
+  release.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  release.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+  if (ownershipTransfer()) {
+    release.srcQueueFamilyIndex = _transferFamily;
+    release.dstQueueFamilyIndex = _graphicsFamily;
+
+    VkImageMemoryBarrier acquire = release;
+    acquire.srcAccessMask = 0;
+    acquire.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    releaseBatch.imageAcquires.push_back(acquire);
+  }
+
+  vkCmdPipelineBarrier(releaseBatch.commandBuffer,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0,
+                       nullptr, 1, &release);
+  return _nextValue;
+}
+
+uint64_t Uploader::uploadImage(VkImage image, VkExtent3D extent,
+                               const void *data, VkDeviceSize size) {
+  VkImageSubresourceRange range{};
+  range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  range.levelCount = 1;
+  range.layerCount = 1;
+
+  VkBufferImageCopy region{};
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent = extent;
+
+  return uploadImage(image, range, {region}, data, size);
+}
+
+uint64_t Uploader::currentTicket() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  return _nextValue;
+}
+
+void Uploader::flush() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  flushLocked();
+}
+
+void Uploader::waitIdle() {
+  uint64_t last;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    last = _nextValue - 1;
+  }
+  if (last == 0) {
+    return;
+  }
+
+  VkSemaphoreWaitInfo waitInfo{};
+  waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+  waitInfo.semaphoreCount = 1;
+  waitInfo.pSemaphores = &_timeline;
+  waitInfo.pValues = &last;
+  vkWaitSemaphores(_device, &waitInfo, UINT64_MAX);
+}
+
+uint64_t Uploader::recordAcquires(VkCommandBuffer commandBuffer) {
+  std::lock_guard<std::mutex> lock(_mutex);
+
+  uint64_t completed;
+  vkGetSemaphoreCounterValue(_device, _timeline, &completed);
+
+  // only batches the transfer queue already finished, so the graphics
+  // queue never ends up waiting on a copy
+  std::vector<VkBufferMemoryBarrier> bufferAcquires;
+  std::vector<VkImageMemoryBarrier> imageAcquires;
+  uint64_t acquired = _acquiredValue.load();
+  while (!_inFlight.empty() && _inFlight.front()->value <= completed) {
+    std::unique_ptr<Batch> batch = std::move(_inFlight.front());
+    _inFlight.pop_front();
+
+    bufferAcquires.insert(bufferAcquires.end(), batch->bufferAcquires.begin(),
+                          batch->bufferAcquires.end());
+    imageAcquires.insert(imageAcquires.end(), batch->imageAcquires.begin(),
+                         batch->imageAcquires.end());
+    acquired = batch->value;
+    _tail = std::max(_tail, batch->ringEnd);
+
+    batch->bufferAcquires.clear();
+    batch->imageAcquires.clear();
+    _freeBatches.push_back(std::move(batch));
+  }
+
+  if (!bufferAcquires.empty() || !imageAcquires.empty()) {
+    vkCmdPipelineBarrier(
+        commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, consumerStages, 0,
+        0, nullptr, static_cast<uint32_t>(bufferAcquires.size()),
+        bufferAcquires.data(), static_cast<uint32_t>(imageAcquires.size()),
+        imageAcquires.data());
+  }
+
+  if (acquired == _acquiredValue.load()) {
+    return 0;
+  }
+  _acquiredValue = acquired;
+  return acquired;
+}
+
+VkDeviceSize Uploader::allocateStaging(std::unique_lock<std::mutex> &lock,
+                                       VkDeviceSize size) {
+  size = (size + _alignment - 1) & ~(_alignment - 1);
+  if (size > _stagingSize) {
+    throw std::runtime_error("upload is larger than the staging ring!");
+  }
+
+  auto reserve = [&](VkDeviceSize &offset) {
+    // nothing staged is still in use, start over at the beginning of the
+    // ring so the padding below never counts against an empty one
+    if (_head == _tail && _head % _stagingSize != 0) {
+      _head += _stagingSize - _head % _stagingSize;
+      _tail = _head;
+    }
+
+    // never let an allocation straddle the end of the ring
+    uint64_t position = _head;
+    offset = position % _stagingSize;
+    if (offset + size > _stagingSize) {
+      position += _stagingSize - offset;
+      offset = 0;
+    }
+    if (position + size - _tail > _stagingSize) {
+      return false;
+    }
+    _head = position + size;
+    return true;
+  };
+
+  VkDeviceSize offset;
+  while (!reserve(offset)) {
+    uint64_t completed = retireFinished();
+    if (reserve(offset)) {
+      break;
+    }
+
+    // out of room, push our own work out and wait for the oldest batch
+    // still running. Finished ones only wait for their acquire, their
+    // staging memory was handed back above
+    if (_recording) {
+      flushLocked();
+    }
+    auto running = std::find_if(
+        _inFlight.begin(), _inFlight.end(),
+        [&](const std::unique_ptr<Batch> &batch) {
+          return batch->value > completed;
+        });
+    if (running == _inFlight.end()) {
+      continue;
+    }
+
+    uint64_t value = (*running)->value;
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &_timeline;
+    waitInfo.pValues = &value;
+
+    lock.unlock();
+    vkWaitSemaphores(_device, &waitInfo, UINT64_MAX);
+    lock.lock();
+  }
+  return offset;
+}
+
+Uploader::Batch &Uploader::recordingBatch() {
+  if (_recording) {
+    return *_recording;
+  }
+
+  if (!_freeBatches.empty()) {
+    _recording = std::move(_freeBatches.back());
+    _freeBatches.pop_back();
+    vkResetCommandPool(_device, _recording->pool, 0);
+  } else {
+    _recording = std::make_unique<Batch>();
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = _transferFamily;
+
+    if (vkCreateCommandPool(_device, &poolInfo, nullptr, &_recording->pool) !=
+        VK_SUCCESS) {
+      throw std::runtime_error("failed to create command pool!");
+    }
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.commandPool = _recording->pool;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+
+    if (vkAllocateCommandBuffers(_device, &allocInfo,
+                                 &_recording->commandBuffer) != VK_SUCCESS) {
+      throw std::runtime_error("failed to allocate command buffers!");
+    }
+  }
+
+  VkCommandBufferBeginInfo beginInfo{};
+  beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+  if (vkBeginCommandBuffer(_recording->commandBuffer, &beginInfo) !=
+      VK_SUCCESS) {
+    throw std::runtime_error("failed to begin recording command buffer!");
+  }
+  return *_recording;
+}
+
+void Uploader::flushLocked() {
+  if (!_recording) {
+    return;
+  }
+
+  Batch &batch = *_recording;
+  if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS) {
+    throw std::runtime_error("failed to record command buffer!");
+  }
+  batch.value = _nextValue++;
+  batch.ringEnd = _head;
+
+  VkTimelineSemaphoreSubmitInfo timelineInfo{};
+  timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+  timelineInfo.signalSemaphoreValueCount = 1;
+  timelineInfo.pSignalSemaphoreValues = &batch.value;
+
+  VkSubmitInfo submitInfo{};
+  submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submitInfo.pNext = &timelineInfo;
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &batch.commandBuffer;
+  submitInfo.signalSemaphoreCount = 1;
+  submitInfo.pSignalSemaphores = &_timeline;
+
+  VkResult result;
+  if (_submitMutex != nullptr) {
+    std::lock_guard<std::mutex> queueLock(*_submitMutex);
+    result = vkQueueSubmit(_queue, 1, &submitInfo, VK_NULL_HANDLE);
+  } else {
+    result = vkQueueSubmit(_queue, 1, &submitInfo, VK_NULL_HANDLE);
+  }
+  if (result != VK_SUCCESS) {
+    throw std::runtime_error("failed to submit upload command buffer!");
+  }
+
+  _inFlight.push_back(std::move(_recording));
+}
+
+uint64_t Uploader::retireFinished() {
+  uint64_t completed;
+  vkGetSemaphoreCounterValue(_device, _timeline, &completed);
+
+  // batches still waiting for their acquire keep their barriers, only the
+  // staging memory they used is handed back
+  for (auto &batch : _inFlight) {
+    if (batch->value > completed) {
+      break;
+    }
+    _tail = std::max(_tail, batch->ringEnd);
+  }
+  return completed;
+}
+
+} // namespace rendering
@@ -0,0 +1,144 @@
+#include "scene/culling.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#define SCENE_CULL_SSE
+#include <immintrin.h>
+#endif
+
+namespace scene {
+
+namespace {
+
+bool sphereVisible(const Frustum &frustum, const glm::vec4 &sphere) {
+  for (const glm::vec4 &plane : frustum.planes) {
+    float distance = plane.x * sphere.x + plane.y * sphere.y +
+                     plane.z * sphere.z + plane.w;
+    if (distance < -sphere.w) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// appends i + lane for every set bit of `mask` without branching on it
+inline uint32_t compact(uint32_t mask, uint32_t lanes, uint32_t i,
+                        uint32_t *visible, uint32_t visibleCount) {
+  for (uint32_t lane = 0; lane < lanes; lane++) {
+    visible[visibleCount] = i + lane;
+    visibleCount += (mask >> lane) & 1u;
+  }
+  return visibleCount;
+}
+
+} // namespace
+
+Frustum extractFrustum(const glm::mat4 &viewProjection) {
+  // glm is column major, row r of the matrix is m[0][r] .. m[3][r]
+  auto row = [&](int r) {
+    return glm::vec4(viewProjection[0][r], viewProjection[1][r],
+                     viewProjection[2][r], viewProjection[3][r]);
+  };
+
+  Frustum frustum;
+  frustum.planes[0] = row(3) + row(0); // left
+  frustum.planes[1] = row(3) - row(0); // right
+  frustum.planes[2] = row(3) + row(1); // bottom
+  frustum.planes[3] = row(3) - row(1); // top
+  frustum.planes[4] = row(2);          // near, z >= 0
+  frustum.planes[5] = row(3) - row(2); // far
+
+  for (glm::vec4 &plane : frustum.planes) {
+    plane = plane / glm::length(glm::vec3(plane));
+  }
+  return frustum;
+}
+
+uint32_t cullSpheres(const Frustum &frustum, const glm::vec4 *spheres,
+                     uint32_t count, uint32_t *visible) {
+  uint32_t visibleCount = 0;
+  uint32_t i = 0;
+
+#if defined(__AVX__)
+  {
+    __m256 planes[6][4];
+    for (int p = 0; p < 6; p++) {
+      for (int c = 0; c < 4; c++) {
+        planes[p][c] = _mm256_set1_ps(frustum.planes[p][c]);
+      }
+    }
+
+    for (; i + 8 <= count; i += 8) {
+      // two 4x4 transposes turn 8 AoS spheres into x, y, z, r lanes
+      __m128 a0 = _mm_loadu_ps(&spheres[i].x);
+      __m128 a1 = _mm_loadu_ps(&spheres[i + 1].x);
+      __m128 a2 = _mm_loadu_ps(&spheres[i + 2].x);
+      __m128 a3 = _mm_loadu_ps(&spheres[i + 3].x);
+      __m128 b0 = _mm_loadu_ps(&spheres[i + 4].x);
+      __m128 b1 = _mm_loadu_ps(&spheres[i + 5].x);
+      __m128 b2 = _mm_loadu_ps(&spheres[i + 6].x);
+      __m128 b3 = _mm_loadu_ps(&spheres[i + 7].x);
+      _MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+      _MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+
+      __m256 x = _mm256_insertf128_ps(_mm256_castps128_ps256(a0), b0, 1);
+      __m256 y = _mm256_insertf128_ps(_mm256_castps128_ps256(a1), b1, 1);
+      __m256 z = _mm256_insertf128_ps(_mm256_castps128_ps256(a2), b2, 1);
+      __m256 r = _mm256_insertf128_ps(_mm256_castps128_ps256(a3), b3, 1);
+      __m256 negativeRadius = _mm256_sub_ps(_mm256_setzero_ps(), r);
+
+      __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+      for (int p = 0; p < 6; p++) {
+        __m256 distance = _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(planes[p][0], x),
+                          _mm256_mul_ps(planes[p][1], y)),
+            _mm256_add_ps(_mm256_mul_ps(planes[p][2], z), planes[p][3]));
+        inside = _mm256_and_ps(
+            inside, _mm256_cmp_ps(distance, negativeRadius, _CMP_GE_OQ));
+      }
+
+      uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(inside));
+      visibleCount = compact(mask, 8, i, visible, visibleCount);
+    }
+  }
+#endif
+
+#if defined(SCENE_CULL_SSE)
+  {
+    __m128 planes[6][4];
+    for (int p = 0; p < 6; p++) {
+      for (int c = 0; c < 4; c++) {
+        planes[p][c] = _mm_set1_ps(frustum.planes[p][c]);
+      }
+    }
+
+    for (; i + 4 <= count; i += 4) {
+      __m128 x = _mm_loadu_ps(&spheres[i].x);
+      __m128 y = _mm_loadu_ps(&spheres[i + 1].x);
+      __m128 z = _mm_loadu_ps(&spheres[i + 2].x);
+      __m128 r = _mm_loadu_ps(&spheres[i + 3].x);
+      _MM_TRANSPOSE4_PS(x, y, z, r);
+      __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), r);
+
+      __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+      for (int p = 0; p < 6; p++) {
+        __m128 distance =
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(planes[p][0], x),
+                                  _mm_mul_ps(planes[p][1], y)),
+                       _mm_add_ps(_mm_mul_ps(planes[p][2], z), planes[p][3]));
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+      }
+
+      uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+      visibleCount = compact(mask, 4, i, visible, visibleCount);
+    }
+  }
+#endif
+
+  for (; i < count; i++) {
+    visible[visibleCount] = i;
+    visibleCount += sphereVisible(frustum, spheres[i]) ? 1 : 0;
+  }
+  return visibleCount;
+}
+
+} // namespace scene
@@ -0,0 +1,227 @@
+#include "scene/gpuScene.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace scene {
+
+namespace {
+
+constexpr uint32_t cullGroupSize = 64;
+// instances per job when filling the instance buffer
+constexpr uint32_t updateBatchSize = 4096;
+
+static_assert(sizeof(CullConstants) <= 128,
+              "cull push constants exceed the guaranteed minimum");
+static_assert(sizeof(GpuInstance) == 96, "GpuInstance must match the shader");
+static_assert(sizeof(GpuMesh) == 80, "GpuMesh must match the shader");
+
+} // namespace
+
+GpuScene::~GpuScene() { destroy(); }
+
+void GpuScene::create(memory::Allocator &allocator,
+                      rendering::Uploader &uploader,
+                      rendering::BindlessHeap &bindless,
+                      uint32_t framesInFlight, uint32_t maxInstances,
+                      uint32_t maxIndices, uint32_t maxMeshes) {
+  _allocator = &allocator;
+  _uploader = &uploader;
+  _bindless = &bindless;
+  _maxInstances = maxInstances;
+  _maxIndices = maxIndices;
+  _maxMeshes = maxMeshes;
+
+  _indices = _allocator->createBuffer(
+      sizeof(uint32_t) * maxIndices,
+      VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+      memory::MemoryUsage::GpuOnly);
+  _meshes = _allocator->createBuffer(sizeof(GpuMesh) * maxMeshes,
+                                     VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                     memory::MemoryUsage::CpuToGpu);
+  _meshesHandle = _bindless->addStorageBuffer(_meshes.buffer);
+
+  _frames.resize(framesInFlight);
+  for (Frame &frame : _frames) {
+    frame.instances = _allocator->createBuffer(
+        sizeof(GpuInstance) * maxInstances, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        memory::MemoryUsage::CpuToGpu);
+    frame.commands = _allocator->createBuffer(
+        sizeof(VkDrawIndexedIndirectCommand) * maxInstances,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+        memory::MemoryUsage::GpuOnly);
+    // reset with vkCmdFillBuffer at the start of every frame
+    frame.count = _allocator->createBuffer(
+        sizeof(uint32_t),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        memory::MemoryUsage::GpuOnly);
+
+    frame.instancesHandle = _bindless->addStorageBuffer(frame.instances.buffer);
+    frame.commandsHandle = _bindless->addStorageBuffer(frame.commands.buffer);
+    frame.countHandle = _bindless->addStorageBuffer(frame.count.buffer);
+  }
+
+  std::cout << "gpu scene: " << maxInstances << " instances, " << maxIndices
+            << " indices, " << maxMeshes << " meshes" << std::endl;
+}
+
+void GpuScene::destroy() {
+  if (_allocator == nullptr) {
+    return;
+  }
+
+  for (Frame &frame : _frames) {
+    _bindless->remove(rendering::BindlessBinding::StorageBuffers,
+                      frame.instancesHandle);
+    _bindless->remove(rendering::BindlessBinding::StorageBuffers,
+                      frame.commandsHandle);
+    _bindless->remove(rendering::BindlessBinding::StorageBuffers,
+                      frame.countHandle);
+    _allocator->destroyBuffer(frame.instances);
+    _allocator->destroyBuffer(frame.commands);
+    _allocator->destroyBuffer(frame.count);
+  }
+  _frames.clear();
+
+  _bindless->remove(rendering::BindlessBinding::StorageBuffers, _meshesHandle);
+  _allocator->destroyBuffer(_meshes);
+  _allocator->destroyBuffer(_indices);
+  _meshesHandle = rendering::BindlessHeap::invalidHandle;
+  _indexCount = 0;
+  _meshCount = 0;
+  _instanceCount = 0;
+  _allocator = nullptr;
+}
+
+uint32_t GpuScene::addMesh(const std::vector<uint32_t> &indices,
+                           const std::vector<MeshLod> &lods) {
+  if (lods.empty() || lods.size() > maxMeshLods) {
+    throw std::runtime_error("mesh needs between 1 and 4 lods!");
+  }
+  if (_meshCount == _maxMeshes ||
+      _indexCount + indices.size() > _maxIndices) {
+    throw std::runtime_error("gpu scene is out of mesh space!");
+  }
+
+  // lods index relative to the mesh, moved into the shared buffer here
+  GpuMesh mesh;
+  mesh.lodCount = static_cast<uint32_t>(lods.size());
+  for (uint32_t i = 0; i < mesh.lodCount; i++) {
+    mesh.lods[i] = lods[i];
+    mesh.lods[i].firstIndex += _indexCount;
+  }
+
+  _indicesTicket = _uploader->uploadBuffer(
+      _indices.buffer, sizeof(uint32_t) * _indexCount, indices.data(),
+      sizeof(uint32_t) * indices.size());
+  _indexCount += static_cast<uint32_t>(indices.size());
+
+  // frames in flight never draw a mesh id they have not seen, writing
+  // past the ones they read is safe
+  auto *meshes = static_cast<GpuMesh *>(_meshes.allocation.mapped);
+  meshes[_meshCount] = mesh;
+  return _meshCount++;
+}
+
+void GpuScene::update(uint32_t frameIndex, const RenderInstances &instances,
+                      jobs::JobSystem &jobs) {
+  _frameIndex = frameIndex;
+  if (instances.size() > _maxInstances) {
+    throw std::runtime_error("gpu scene is out of instances!");
+  }
+  _instanceCount = instances.size();
+
+  auto *out = static_cast<GpuInstance *>(
+      _frames[frameIndex].instances.allocation.mapped);
+
+  jobs::Counter counter;
+  jobs.parallelFor(
+      _instanceCount, updateBatchSize,
+      [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+          out[i].localToWorld = instances.localToWorld[i];
+          out[i].sphere = instances.spheres[i];
+          out[i].mesh = instances.meshes[i];
+        }
+      },
+      counter);
+  jobs.wait(counter);
+}
+
+GpuSceneBuffers GpuScene::addCulling(rendering::RenderGraph &graph,
+                                     const Frustum &frustum,
+                                     VkPipeline pipeline,
+                                     VkPipelineLayout layout,
+                                     float lodScale) {
+  const Frame &frame = _frames[_frameIndex];
+
+  // the host writes are made visible by the submission, and the last use
+  // of this slot's draws retired with its fence
+  GpuSceneBuffers buffers;
+  buffers.instances =
+      graph.importBuffer("instances", frame.instances.buffer, {}, {});
+  buffers.commands =
+      graph.importBuffer("draw commands", frame.commands.buffer, {}, {});
+  buffers.count = graph.importBuffer("draw count", frame.count.buffer, {}, {});
+
+  graph.addPass("clear draws")
+      .write(buffers.count, rendering::BufferUsage::TransferDst)
+      .execute([buffer = frame.count.buffer](VkCommandBuffer commandBuffer,
+                                             rendering::RenderGraph &) {
+        vkCmdFillBuffer(commandBuffer, buffer, 0, sizeof(uint32_t), 0);
+      });
+
+  CullConstants constants;
+  std::memcpy(constants.planes, frustum.planes, sizeof(constants.planes));
+  constants.instances = frame.instancesHandle;
+  constants.meshes = _meshesHandle;
+  constants.commands = frame.commandsHandle;
+  constants.count = frame.countHandle;
+  // draws referencing indices still in transit would read garbage
+  constants.instanceCount = ready() ? _instanceCount : 0;
+  constants.maxDraws = _maxInstances;
+  constants.lodScale = lodScale;
+
+  graph.addPass("cull")
+      .read(buffers.instances, rendering::BufferUsage::StorageReadCompute)
+      .write(buffers.commands, rendering::BufferUsage::StorageWriteCompute)
+      .write(buffers.count, rendering::BufferUsage::StorageWriteCompute)
+      .execute([this, pipeline, layout,
+                constants](VkCommandBuffer commandBuffer,
+                           rendering::RenderGraph &) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          pipeline);
+        _bindless->bind(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, layout);
+        vkCmdPushConstants(commandBuffer, layout, VK_SHADER_STAGE_COMPUTE_BIT,
+                           0, sizeof(constants), &constants);
+        uint32_t groups =
+            (constants.instanceCount + cullGroupSize - 1) / cullGroupSize;
+        if (groups > 0) {
+          vkCmdDispatch(commandBuffer, groups, 1, 1);
+        }
+      });
+
+  return buffers;
+}
+
+void GpuScene::draw(VkCommandBuffer commandBuffer,
+                    VkPipelineLayout layout) const {
+  const Frame &frame = _frames[_frameIndex];
+
+  _bindless->bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, layout);
+  vkCmdPushConstants(commandBuffer, layout,
+                     VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+                     0, sizeof(uint32_t), &frame.instancesHandle);
+  vkCmdBindIndexBuffer(commandBuffer, _indices.buffer, 0,
+                       VK_INDEX_TYPE_UINT32);
+  // the count the cull pass wrote decides how many of these are read
+  vkCmdDrawIndexedIndirectCount(commandBuffer, frame.commands.buffer, 0,
+                                frame.count.buffer, 0, _maxInstances,
+                                sizeof(VkDrawIndexedIndirectCommand));
+}
+
+} // namespace scene
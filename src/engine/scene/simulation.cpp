@@ -0,0 +1,213 @@
+#include "scene/simulation.hpp"
+#include "profiling/cpuProfiler.hpp"
+#include "scene/components.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace scene {
+
+namespace {
+
+// renderables per job when interpolating
+constexpr uint32_t interpolateBatchSize = 1024;
+
+// further behind than this and the missing time is skipped instead of
+// ticking back to back until it is made up
+constexpr uint32_t maxCatchUpTicks = 5;
+
+glm::vec4 lerp(const glm::vec4 &a, const glm::vec4 &b, float t) {
+  return a + (b - a) * t;
+}
+
+} // namespace
+
+void RenderInstances::resize(uint32_t count) {
+  localToWorld.resize(count);
+  spheres.resize(count);
+  meshes.resize(count);
+}
+
+Simulation::~Simulation() { stop(); }
+
+void Simulation::start(ecs::World &world, jobs::JobSystem &jobs,
+                       float tickRate, TickFunction tick) {
+  if (tickRate <= 0.0f) {
+    throw std::runtime_error("simulation tick rate must be positive!");
+  }
+
+  _world = &world;
+  _jobs = &jobs;
+  _tick = std::move(tick);
+  _deltaTime = 1.0f / tickRate;
+  _interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(1.0 / tickRate));
+  _stopping = false;
+  _thread = std::thread(&Simulation::run, this);
+
+  std::cout << "simulation ticking at " << tickRate << " Hz" << std::endl;
+}
+
+void Simulation::stop() {
+  if (!_thread.joinable()) {
+    return;
+  }
+  _stopping = true;
+  _thread.join();
+}
+
+void Simulation::run() {
+  PROFILE_THREAD("simulation");
+  // the render thread is the one thread outside the pool that runs jobs
+  jobs::JobSystem::setHelpWhileWaiting(false);
+
+  std::chrono::steady_clock::time_point due = std::chrono::steady_clock::now();
+  while (!_stopping) {
+    {
+      PROFILE_SCOPE("tick");
+      _tick(_deltaTime);
+    }
+
+    // anything neither published nor pinned by the renderer is free
+    uint32_t slot = none;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      for (uint32_t i = 0; i < snapshotCount && slot == none; i++) {
+        if (i != _latest && i != _previous && i != _readLatest &&
+            i != _readPrevious) {
+          slot = i;
+        }
+      }
+    }
+
+    // the tick moved the world from `due` to one interval later
+    RenderSnapshot &snapshot = _snapshots[slot];
+    capture(snapshot);
+    snapshot.tick = _tickCount.load();
+    snapshot.time = due + _interval;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _previous = _latest;
+      _latest = slot;
+    }
+    _tickCount++;
+
+    due += _interval;
+    std::chrono::steady_clock::time_point now =
+        std::chrono::steady_clock::now();
+    if (now - due > _interval * maxCatchUpTicks) {
+      auto behind = (now - due) / _interval;
+      _droppedTicks += static_cast<uint64_t>(behind);
+      due += _interval * behind;
+    }
+    // returns right away while catching up
+    std::this_thread::sleep_until(due);
+  }
+}
+
+void Simulation::capture(RenderSnapshot &snapshot) {
+  PROFILE_SCOPE("captureSnapshot");
+  std::vector<ecs::ChunkView> &chunks = _captureChunks;
+  _world->chunks<LocalToWorld, WorldBounds, Renderable>(chunks);
+
+  std::vector<uint32_t> &offsets = _captureOffsets;
+  offsets.resize(chunks.size());
+  uint32_t total = 0;
+  for (size_t i = 0; i < chunks.size(); i++) {
+    offsets[i] = total;
+    total += chunks[i].size();
+  }
+  snapshot.entities.resize(total);
+  snapshot.instances.resize(total);
+
+  jobs::Counter counter;
+  _jobs->parallelFor(
+      static_cast<uint32_t>(chunks.size()), 1,
+      [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+          const ecs::ChunkView &chunk = chunks[i];
+          const auto *localToWorld = chunk.get<LocalToWorld>();
+          const auto *bounds = chunk.get<WorldBounds>();
+          const auto *renderable = chunk.get<Renderable>();
+
+          std::copy(chunk.entities(), chunk.entities() + chunk.size(),
+                    snapshot.entities.begin() + offsets[i]);
+          for (uint32_t e = 0; e < chunk.size(); e++) {
+            uint32_t out = offsets[i] + e;
+            snapshot.instances.localToWorld[out] = localToWorld[e].matrix;
+            snapshot.instances.spheres[out] = bounds[e].sphere;
+            snapshot.instances.meshes[out] = renderable[e].mesh;
+          }
+        }
+      },
+      counter);
+  _jobs->wait(counter);
+}
+
+void Simulation::interpolate(jobs::JobSystem &jobs, RenderInstances &out) {
+  PROFILE_SCOPE("interpolate");
+  uint32_t latest;
+  uint32_t previous;
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    latest = _latest;
+    previous = _previous;
+    _readLatest = latest;
+    _readPrevious = previous;
+  }
+
+  if (latest == none) {
+    out.resize(0);
+    return;
+  }
+
+  const RenderSnapshot &to = _snapshots[latest];
+  const RenderSnapshot &from =
+      previous != none ? _snapshots[previous] : _snapshots[latest];
+
+  float alpha = 1.0f;
+  std::chrono::steady_clock::time_point renderTime =
+      std::chrono::steady_clock::now() - _interval;
+  if (to.time > from.time) {
+    alpha = std::chrono::duration<float>(renderTime - from.time).count() /
+            std::chrono::duration<float>(to.time - from.time).count();
+    alpha = std::clamp(alpha, 0.0f, 1.0f);
+  }
+
+  out.resize(to.instances.size());
+
+  jobs::Counter counter;
+  jobs.parallelFor(
+      out.size(), interpolateBatchSize,
+      [&](uint32_t begin, uint32_t end) {
+        uint32_t fromCount = from.instances.size();
+        for (uint32_t i = begin; i < end; i++) {
+          out.meshes[i] = to.instances.meshes[i];
+          // spawned or shuffled since the previous tick, nothing to blend
+          // from
+          if (i >= fromCount || from.entities[i] != to.entities[i]) {
+            out.localToWorld[i] = to.instances.localToWorld[i];
+            out.spheres[i] = to.instances.spheres[i];
+            continue;
+          }
+
+          // column wise, close enough for the rotation one tick covers
+          const glm::mat4 &a = from.instances.localToWorld[i];
+          const glm::mat4 &b = to.instances.localToWorld[i];
+          for (int c = 0; c < 4; c++) {
+            out.localToWorld[i][c] = lerp(a[c], b[c], alpha);
+          }
+          out.spheres[i] =
+              lerp(from.instances.spheres[i], to.instances.spheres[i], alpha);
+        }
+      },
+      counter);
+  jobs.wait(counter);
+
+  std::lock_guard<std::mutex> lock(_mutex);
+  _readLatest = none;
+  _readPrevious = none;
+}
+
+} // namespace scene
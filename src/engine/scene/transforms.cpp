@@ -0,0 +1,253 @@
+#include "scene/transforms.hpp"
+#include "profiling/cpuProfiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace scene {
+
+namespace {
+
+// chunk runs per job within one hierarchy level
+constexpr uint32_t hierarchyBatchSize = 4;
+
+glm::mat4 compose(const glm::vec3 &position, const glm::quat &orientation,
+                  const glm::vec3 &scale) {
+  // T * R * S without going through three full matrix products
+  glm::mat3 rotation = glm::mat3_cast(orientation);
+
+  glm::mat4 matrix(1.0f);
+  matrix[0] = glm::vec4(rotation[0] * scale.x, 0.0f);
+  matrix[1] = glm::vec4(rotation[1] * scale.y, 0.0f);
+  matrix[2] = glm::vec4(rotation[2] * scale.z, 0.0f);
+  matrix[3] = glm::vec4(position, 1.0f);
+  return matrix;
+}
+
+} // namespace
+
+glm::mat4 composeTransform(const Transform &transform) {
+  return compose(transform.position, transform.rotation, transform.scale);
+}
+
+void updateSpin(ecs::World &world, jobs::JobSystem &jobs, float deltaTime) {
+  world.parallelEach<Transform, const Spin>(
+      jobs, [deltaTime](Transform &transform, const Spin &spin) {
+        transform.rotation = glm::normalize(
+            glm::angleAxis(spin.speed * deltaTime, spin.axis) *
+            transform.rotation);
+      });
+}
+
+void updateWorldBounds(ecs::World &world, jobs::JobSystem &jobs) {
+  world.parallelEach<const LocalToWorld, const Bounds, WorldBounds>(
+      jobs, [](const LocalToWorld &localToWorld, const Bounds &bounds,
+               WorldBounds &worldBounds) {
+        const glm::mat4 &matrix = localToWorld.matrix;
+        glm::vec4 center = matrix * glm::vec4(glm::vec3(bounds.sphere), 1.0f);
+
+        // the largest axis scale keeps the sphere conservative
+        float scale = std::sqrt(
+            std::max({glm::dot(glm::vec3(matrix[0]), glm::vec3(matrix[0])),
+                      glm::dot(glm::vec3(matrix[1]), glm::vec3(matrix[1])),
+                      glm::dot(glm::vec3(matrix[2]), glm::vec3(matrix[2]))}));
+        worldBounds.sphere =
+            glm::vec4(glm::vec3(center), bounds.sphere.w * scale);
+      });
+}
+
+void TransformHierarchy::update(ecs::World &world, jobs::JobSystem &jobs) {
+  PROFILE_SCOPE("transformHierarchy");
+  if (world.structureVersion() != _builtVersion) {
+    rebuild(world);
+    _builtVersion = world.structureVersion();
+  }
+
+  world.parallelEach<const Transform, LocalToWorld>(
+      jobs,
+      [](const Transform &transform, LocalToWorld &localToWorld) {
+        localToWorld.matrix = composeTransform(transform);
+      },
+      ecs::signatureOf<Parent>());
+
+  if (_levels.empty()) {
+    return;
+  }
+
+  // the roots' finished matrices are what the first level multiplies by
+  for (const ChunkRun &run : _roots.runs) {
+    const LocalToWorld *localToWorld = run.view.get<LocalToWorld>();
+    for (uint32_t i = run.begin; i < run.end; i++) {
+      _roots.world[i] = localToWorld[_roots.rows[i]].matrix;
+    }
+  }
+
+  const std::vector<glm::mat4> *parentWorld = &_roots.world;
+  for (Level &level : _levels) {
+    jobs::Counter counter;
+    jobs.parallelFor(
+        static_cast<uint32_t>(level.runs.size()), hierarchyBatchSize,
+        [&](uint32_t begin, uint32_t end) {
+          for (uint32_t r = begin; r < end; r++) {
+            const ChunkRun &run = level.runs[r];
+            const Transform *transforms = run.view.get<Transform>();
+            for (uint32_t i = run.begin; i < run.end; i++) {
+              const Transform &transform = transforms[level.rows[i]];
+              level.positions[i] = transform.position;
+              level.rotations[i] = transform.rotation;
+              level.scales[i] = transform.scale;
+            }
+
+            for (uint32_t i = run.begin; i < run.end; i++) {
+              glm::mat4 local = compose(level.positions[i],
+                                        level.rotations[i], level.scales[i]);
+              uint32_t parent = level.parents[i];
+              level.world[i] = parent == noParent
+                                   ? local
+                                   : (*parentWorld)[parent] * local;
+            }
+
+            LocalToWorld *localToWorld = run.view.get<LocalToWorld>();
+            for (uint32_t i = run.begin; i < run.end; i++) {
+              localToWorld[level.rows[i]].matrix = level.world[i];
+            }
+          }
+        },
+        counter);
+    jobs.wait(counter);
+    parentWorld = &level.world;
+  }
+}
+
+void TransformHierarchy::rebuild(ecs::World &world) {
+  _roots = Level();
+  _levels.clear();
+
+  // entity index -> depth, roots are 0
+  std::unordered_map<uint32_t, uint32_t> depths;
+  std::vector<ecs::Entity> chain;
+
+  auto depthOf = [&](ecs::Entity entity) {
+    chain.clear();
+    ecs::Entity current = entity;
+    uint32_t depth = 0;
+
+    while (true) {
+      auto it = depths.find(current.index);
+      if (it != depths.end()) {
+        depth = it->second;
+        break;
+      }
+
+      const Parent *parent = world.get<Parent>(current);
+      if (parent == nullptr) {
+        break;
+      }
+      chain.push_back(current);
+      if (chain.size() > world.size()) {
+        throw std::runtime_error("transform hierarchy has a cycle!");
+      }
+      // a dead parent leaves its children where their Transform puts them
+      if (!world.has<LocalToWorld>(parent->entity)) {
+        break;
+      }
+      current = parent->entity;
+    }
+
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+      depths[it->index] = ++depth;
+    }
+    return depths[entity.index];
+  };
+
+  struct Child {
+    uint32_t view;
+    uint32_t row;
+    ecs::Entity entity;
+    ecs::Entity parent;
+  };
+
+  // chunk positions stay put until the structure changes again
+  std::vector<ecs::ChunkView> views = world.chunks<Transform, LocalToWorld>();
+  std::vector<std::vector<Child>> children;
+  std::unordered_set<uint32_t> parentRoots;
+
+  for (uint32_t v = 0; v < views.size(); v++) {
+    const Parent *parents = views[v].get<Parent>();
+    if (parents == nullptr) {
+      continue;
+    }
+    const ecs::Entity *entities = views[v].entities();
+
+    for (uint32_t i = 0; i < views[v].size(); i++) {
+      uint32_t depth = depthOf(entities[i]);
+      if (children.size() < depth) {
+        children.resize(depth);
+      }
+
+      Child child{v, i, entities[i], ecs::Entity()};
+      if (world.has<LocalToWorld>(parents[i].entity)) {
+        child.parent = parents[i].entity;
+        if (depth == 1) {
+          parentRoots.insert(child.parent.index);
+        }
+      }
+      children[depth - 1].push_back(child);
+    }
+  }
+
+  // entries arrive sorted by chunk, so every chunk becomes one run
+  auto append = [&](Level &level, uint32_t &runView, uint32_t view,
+                    uint32_t row) {
+    auto index = static_cast<uint32_t>(level.rows.size());
+    if (level.runs.empty() || runView != view) {
+      level.runs.push_back({views[view], index, index});
+      runView = view;
+    }
+    level.rows.push_back(row);
+    level.runs.back().end = index + 1;
+    return index;
+  };
+
+  // entity index -> position in its level, or among the roots
+  std::unordered_map<uint32_t, uint32_t> positions;
+  uint32_t runView = 0;
+  for (uint32_t v = 0; v < views.size(); v++) {
+    if (views[v].get<Parent>() != nullptr) {
+      continue;
+    }
+    const ecs::Entity *entities = views[v].entities();
+    for (uint32_t i = 0; i < views[v].size(); i++) {
+      if (parentRoots.count(entities[i].index) != 0) {
+        positions[entities[i].index] = append(_roots, runView, v, i);
+      }
+    }
+  }
+  _roots.world.resize(_roots.rows.size());
+
+  _levels.resize(children.size());
+  for (uint32_t depth = 0; depth < children.size(); depth++) {
+    Level &level = _levels[depth];
+    std::unordered_map<uint32_t, uint32_t> levelPositions;
+
+    for (const Child &child : children[depth]) {
+      uint32_t index = append(level, runView, child.view, child.row);
+      level.parents.push_back(child.parent.valid()
+                                  ? positions.at(child.parent.index)
+                                  : noParent);
+      levelPositions[child.entity.index] = index;
+    }
+
+    size_t count = level.rows.size();
+    level.positions.resize(count);
+    level.rotations.resize(count);
+    level.scales.resize(count);
+    level.world.resize(count);
+    positions = std::move(levelPositions);
+  }
+}
+
+} // namespace scene
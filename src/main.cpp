@@ -1,12 +1,80 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <stdexcept>
+#include <string>
 
+#include "bench/benchmark.hpp"
 #include "engine.hpp"
 
-int main() {
-  engine::Engine engine;
+int main(int argc, char **argv) {
+  engine::EngineConfig config;
+  bench::BenchOptions benchOptions;
   try {
+    // --gpu wins over the environment
+    if (const char *gpu = std::getenv("ENGINE_GPU")) {
+      config.gpu = gpu;
+    }
+    for (int i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "--headless") == 0) {
+        config.headless = true;
+      } else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+        config.maxFrames = std::stoull(argv[++i]);
+      } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+        config.capturePath = argv[++i];
+      } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+        config.workerThreads = std::stoul(argv[++i]);
+      } else if (strcmp(argv[i], "--tick-rate") == 0 && i + 1 < argc) {
+        config.tickRate = std::stof(argv[++i]);
+      } else if (strcmp(argv[i], "--draws") == 0 && i + 1 < argc) {
+        config.drawCount = std::stoul(argv[++i]);
+      } else if (strcmp(argv[i], "--assets") == 0 && i + 1 < argc) {
+        config.assetPath = argv[++i];
+      } else if (strcmp(argv[i], "--gpu") == 0 && i + 1 < argc) {
+        config.gpu = argv[++i];
+      } else if (strcmp(argv[i], "--bindless") == 0) {
+        config.bindless = true;
+      } else if (strcmp(argv[i], "--gpu-driven") == 0) {
+        config.gpuDriven = true;
+      } else if (strcmp(argv[i], "--pacing") == 0 && i + 1 < argc) {
+        std::string mode = argv[++i];
+        if (mode == "low-latency") {
+          config.pacing = rendering::PacingMode::LowLatency;
+        } else if (mode == "steady") {
+          config.pacing = rendering::PacingMode::Steady;
+        } else if (mode == "power-saving") {
+          config.pacing = rendering::PacingMode::PowerSaving;
+        } else {
+          throw std::runtime_error("unknown pacing mode " + mode +
+                                   ", expected low-latency, steady or "
+                                   "power-saving!");
+        }
+      } else if (strcmp(argv[i], "--fps-limit") == 0 && i + 1 < argc) {
+        config.frameRateLimit = std::stof(argv[++i]);
+      } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+        config.profileInterval = std::stoul(argv[++i]);
+      } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+        config.tracePath = argv[++i];
+      } else if (strcmp(argv[i], "--hot-reload") == 0) {
+        config.hotReload = true;
+      } else if (strcmp(argv[i], "--bench") == 0 && i + 1 < argc) {
+        benchOptions.outputPath = argv[++i];
+      } else if (strcmp(argv[i], "--bench-baseline") == 0 && i + 1 < argc) {
+        benchOptions.baselinePath = argv[++i];
+      } else if (strcmp(argv[i], "--bench-scenario") == 0 && i + 1 < argc) {
+        benchOptions.scenario = argv[++i];
+      } else if (strcmp(argv[i], "--bench-tolerance") == 0 && i + 1 < argc) {
+        benchOptions.tolerance = std::stod(argv[++i]);
+      }
+    }
+
+    if (!benchOptions.outputPath.empty()) {
+      benchOptions.base = config;
+      return bench::runBenchmarks(benchOptions);
+    }
+    engine::Engine engine(config);
     engine.run();
   } catch (const std::exception &e) {
     std::cerr << e.what() << std::endl;